@@ -0,0 +1,310 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <time.h>
+
+#include "common.h"
+#include "alignment_config.h"
+#include "plane_segmentation.h"
+#include "plane_merging.h"
+#include "mesh_segmentation.h"
+#include "registration.h"
+#include "preprocessing_cache.h"
+#include "profiler.h"
+
+using namespace std;
+
+/// Headless alignment of a source cloud/mesh on a target cloud/mesh. No viewer is ever created,
+/// thus this executable can be run on machines without display.
+
+struct StageTiming
+{
+    string name;
+    double seconds;
+};
+
+struct AlignInput
+{
+    bool isMesh = false;
+    string filename;
+
+    PlaneSegmentation cloud_segmentation;
+    MeshSegmentation mesh_segmentation;
+    vector<SegmentedPointsContainer::SegmentedPlane> planes;
+};
+
+static vector<StageTiming> timings;
+
+static double elapsedSince(struct timespec &start)
+{
+    struct timespec finish;
+    clock_gettime(CLOCK_MONOTONIC, &finish);
+    double elapsed = (finish.tv_sec - start.tv_sec);
+    elapsed += (finish.tv_nsec - start.tv_nsec) / 1000000000.0;
+    return elapsed;
+}
+
+static void addTiming(string name, struct timespec &start)
+{
+    timings.push_back({name, elapsedSince(start)});
+    clock_gettime(CLOCK_MONOTONIC, &start);
+}
+
+/**
+ * @brief Run resampling, preprocessing, curvature filtering, plane segmentation and plane merging on a cloud,
+ * or plane segmentation and merging on a mesh.
+ * @return false if the object could not be loaded.
+ */
+static bool segmentObject(AlignInput &input, bool isSource, bool resample, const AlignmentConfig &config, int nb_seeds)
+{
+    string prefix = isSource ? "source_" : "target_";
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    if(input.isMesh)
+    {
+        input.mesh_segmentation.setConfig(config);
+        if(!input.mesh_segmentation.loadMesh(input.filename)) return false;
+        addTiming(prefix + "load", start);
+
+        input.mesh_segmentation.segmentPlanes();
+        addTiming(prefix + "segmentation", start);
+
+        input.mesh_segmentation.mergePlanes();
+        addTiming(prefix + "merging", start);
+
+        input.planes = input.mesh_segmentation.getSegmentedPlanes();
+        return true;
+    }
+
+    PlaneSegmentation &seg = input.cloud_segmentation;
+
+    // A cloud already preprocessed by createTestSet is not resampled again,
+    // since the voxel grid would average the computed normals and curvatures.
+    // Raw clouds are resampled while they are read, the timing of the load includes the resampling.
+    seg.setConfig(config);
+    int r_init = resample ? seg.initResampled(input.filename, isSource) : seg.init(input.filename, isSource);
+    if(r_init == EXIT_FAILURE) return false;
+    addTiming(prefix + "load", start);
+
+    if(!seg.isReady())
+    {
+        seg.preprocessCloud();
+        addTiming(prefix + "preprocessing", start);
+    }
+
+    seg.filterOutCurvature(config.max_curvature);
+    addTiming(prefix + "curvature_filter", start);
+
+    seg.setNbParallelSeeds(nb_seeds);
+    seg.start_pause();
+    seg.runMainLoop();
+    addTiming(prefix + "segmentation", start);
+
+    vector<SegmentedPointsContainer::SegmentedPlane> segmented_planes = seg.getSegmentedPlanes();
+
+    PlaneMerging merger;
+    merger.setConfig(config);
+    merger.init(nullptr, isSource);
+    merger.start_merge(segmented_planes, seg.getPointCloud());
+    input.planes = merger.getSegmentedPlanes();
+    addTiming(prefix + "merging", start);
+
+    return true;
+}
+
+static string jsonEscape(string s)
+{
+    stringstream ss;
+    for(char c: s)
+    {
+        if(c == '"' || c == '\\') ss << '\\';
+        ss << c;
+    }
+    return ss.str();
+}
+
+static void writeText(ostream &out, mat4 &M, AlignInput &source, AlignInput &target)
+{
+    out << "Source planes: " << source.planes.size() << endl;
+    out << "Target planes: " << target.planes.size() << endl;
+    out << "Transform:" << endl << M << endl;
+    out << "Timings (s):" << endl;
+
+    double total = 0;
+    for(StageTiming &t: timings)
+    {
+        out << "  " << t.name << ": " << t.seconds << endl;
+        total += t.seconds;
+    }
+    out << "  total: " << total << endl;
+}
+
+static void writeJSON(ostream &out, mat4 &M, AlignInput &source, AlignInput &target)
+{
+    out.precision(9);
+    out << "{" << endl;
+    out << "  \"source\": \"" << jsonEscape(source.filename) << "\"," << endl;
+    out << "  \"target\": \"" << jsonEscape(target.filename) << "\"," << endl;
+    out << "  \"nb_planes_source\": " << source.planes.size() << "," << endl;
+    out << "  \"nb_planes_target\": " << target.planes.size() << "," << endl;
+
+    out << "  \"transform\": [";
+    for(int i = 0; i < M.rows(); ++i)
+    {
+        out << (i == 0 ? "[" : ", [");
+        for(int j = 0; j < M.cols(); ++j)
+        {
+            out << (j == 0 ? "" : ", ") << M(i, j);
+        }
+        out << "]";
+    }
+    out << "]," << endl;
+
+    double total = 0;
+    out << "  \"timings\": {";
+    for(size_t i = 0; i < timings.size(); ++i)
+    {
+        out << (i == 0 ? "" : ", ") << "\"" << timings[i].name << "\": " << timings[i].seconds;
+        total += timings[i].seconds;
+    }
+    out << (timings.empty() ? "" : ", ") << "\"total\": " << total << "}" << endl;
+    out << "}" << endl;
+}
+
+int main(int argc, char *argv[])
+{
+    bool json = false;
+    bool resample = true;
+    AlignmentConfig config;
+    int nb_seeds = 1;
+    string profile_file, trace_file;
+    vector<string> args;
+
+    for(int i = 1; i < argc; ++i)
+    {
+        string arg = argv[i];
+
+        if(arg == "--json")
+        {
+            json = true;
+        }
+        else if(arg == "--no-resample")
+        {
+            resample = false;
+        }
+        else if(arg == "--leaf-size" && i + 1 < argc)
+        {
+            config.leaf_size = atof(argv[++i]);
+        }
+        else if(arg == "--config" && i + 1 < argc)
+        {
+            // Parameters are applied in the order of the arguments, --set may then override the file
+            if(!config.load(argv[++i])) exit(EXIT_FAILURE);
+        }
+        else if(arg == "--set" && i + 1 < argc)
+        {
+            if(!config.setArgument(argv[++i])) exit(EXIT_FAILURE);
+        }
+        else if(arg == "--cache" && i + 1 < argc)
+        {
+            // Normals, curvatures and k of clouds already preprocessed with the same parameters are read back
+            if(!PreprocessingCache::get().setDirectory(argv[++i])) exit(EXIT_FAILURE);
+        }
+        else if(arg == "--parallel-seeds" && i + 1 < argc)
+        {
+            // 0 grows as many seeds as there are threads
+            nb_seeds = atoi(argv[++i]);
+            if(nb_seeds == 0) nb_seeds = omp_get_max_threads();
+        }
+        else if(arg == "--log-level" && i + 1 < argc)
+        {
+            int level = Logging::parseLevel(argv[++i]);
+            if(level == -1)
+            {
+                cout << "Unknown log level " << argv[i] << endl;
+                exit(EXIT_FAILURE);
+            }
+            Logging::setLevel(level);
+        }
+        else if(arg == "--profile" && i + 1 < argc)
+        {
+            profile_file = argv[++i];
+        }
+        else if(arg == "--trace" && i + 1 < argc)
+        {
+            trace_file = argv[++i];
+        }
+        else
+        {
+            args.push_back(arg);
+        }
+    }
+
+    if(args.size() != 4 || !config.isValid())
+    {
+        cout << "Usage: align [--json] [--no-resample] [--leaf-size L] [--config file] [--set name=value] [--cache directory] [--parallel-seeds N] [--log-level level] [--profile file.json] [--trace file.json] [c/m] [source_file] [c/m] [target_file]" << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    AlignInput source, target;
+    source.isMesh = args[0] == "m";
+    source.filename = args[1];
+    target.isMesh = args[2] == "m";
+    target.filename = args[3];
+
+    // Timers and counters are only recorded if their results are written
+    Profiler::get().setEnabled(!profile_file.empty() || !trace_file.empty());
+
+    // Every log of the pipeline goes to stderr, stdout only receives the results.
+    streambuf *stdout_buf = cout.rdbuf(cerr.rdbuf());
+
+    if(!segmentObject(source, true, resample, config, nb_seeds) || !segmentObject(target, false, resample, config, nb_seeds))
+    {
+        cout.rdbuf(stdout_buf);
+        cerr << "Error while loading input files" << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    Registration registration;
+    registration.setConfig(config);
+    registration.setClouds(source.planes, target.planes, target.isMesh, source.isMesh,
+                           source.isMesh ? nullptr : source.cloud_segmentation.getPointCloud(),
+                           target.isMesh ? nullptr : target.cloud_segmentation.getPointCloud());
+    addTiming("plane_surfaces", start);
+
+    mat4 firstTransform = registration.findAlignment();
+    registration.applyTransform(firstTransform);
+    addTiming("find_alignment", start);
+
+    mat4 realignTransform = registration.refineAlignment();
+    registration.applyTransform(realignTransform);
+    addTiming("refine_alignment", start);
+
+    mat4 icpTransform = registration.finalICP();
+    registration.applyTransform(icpTransform);
+    addTiming("final_icp", start);
+
+    mat4 finalTransform = icpTransform * realignTransform * firstTransform;
+
+    cout.rdbuf(stdout_buf);
+
+    if(json)
+    {
+        writeJSON(cout, finalTransform, source, target);
+    }
+    else
+    {
+        writeText(cout, finalTransform, source, target);
+    }
+
+    if(!profile_file.empty()) Profiler::get().save(profile_file, false);
+    if(!trace_file.empty()) Profiler::get().save(trace_file, true);
+
+    return EXIT_SUCCESS;
+}
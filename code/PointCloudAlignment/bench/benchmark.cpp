@@ -0,0 +1,607 @@
+#include "benchmark.h"
+
+#include <algorithm>
+#include <cmath>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <numeric>
+#include <regex>
+#include <sstream>
+
+#include <omp.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+
+/// Iterations are never calibrated beyond this number.
+static const size_t MAX_ITERATIONS = 1000000000;
+
+/// Events of PerfCounters: generic hardware events, mapped by the kernel to the counters of the processor.
+static const struct
+{
+    const char *name;
+    uint32_t type;
+    uint64_t config;
+} PERF_EVENTS[] = {
+    {"CYCLES", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {"INSTRUCTIONS", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {"CACHE-REFERENCES", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES},
+    {"CACHE-MISSES", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {"L1D-LOAD-MISSES", PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16},
+    {"LLC-LOAD-MISSES", PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16},
+    {"DTLB-LOAD-MISSES", PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16}
+};
+
+vector<string> PerfCounters::getEventNames()
+{
+    vector<string> event_names;
+    for(const auto &event: PERF_EVENTS) event_names.push_back(event.name);
+
+    return event_names;
+}
+
+bool PerfCounters::open(const vector<string> &names, string &message)
+{
+    close();
+
+    for(const string &name: names)
+    {
+        auto event = find_if(begin(PERF_EVENTS), end(PERF_EVENTS), [&name](const auto &e) { return name == e.name; });
+        if(event == end(PERF_EVENTS))
+        {
+            message = "unknown counter " + name;
+            close();
+            return false;
+        }
+
+        // User space only, which perf_event_paranoid up to 2 allows to unprivileged users
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = event->type;
+        attr.config = event->config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+
+        int fd = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+        if(fd < 0)
+        {
+            message = "could not open " + name + ": " + strerror(errno);
+            close();
+            return false;
+        }
+        fds.push_back(fd);
+    }
+
+    this->names = names;
+    return true;
+}
+
+void PerfCounters::close()
+{
+    for(int fd: fds) ::close(fd);
+
+    fds.clear();
+    names.clear();
+}
+
+void PerfCounters::reset()
+{
+    for(int fd: fds) ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+}
+
+void PerfCounters::start()
+{
+    for(int fd: fds) ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+}
+
+void PerfCounters::stop()
+{
+    for(int fd: fds) ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+}
+
+vector<double> PerfCounters::read() const
+{
+    vector<double> values;
+    for(int fd: fds)
+    {
+        uint64_t value = 0;
+        if(::read(fd, &value, sizeof(value)) != sizeof(value)) value = 0;
+        values.push_back(static_cast<double>(value));
+    }
+
+    return values;
+}
+
+static double secondsBetween(const struct timespec &start, const struct timespec &finish)
+{
+    return (finish.tv_sec - start.tv_sec) + (finish.tv_nsec - start.tv_nsec) / 1000000000.0;
+}
+
+void BenchmarkState::startTimers()
+{
+    clock_gettime(CLOCK_MONOTONIC, &real_start);
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu_start);
+
+    if(p_counters) p_counters->start();
+}
+
+void BenchmarkState::stopTimers()
+{
+    if(p_counters) p_counters->stop();
+
+    struct timespec real_finish, cpu_finish;
+    clock_gettime(CLOCK_MONOTONIC, &real_finish);
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu_finish);
+
+    real_time += secondsBetween(real_start, real_finish);
+    cpu_time += secondsBetween(cpu_start, cpu_finish);
+}
+
+bool BenchmarkState::keepRunning()
+{
+    if(!error.empty() || is_finished) return false;
+
+    if(iterations == 0) startTimers();
+
+    if(iterations < max_iterations)
+    {
+        iterations++;
+        return true;
+    }
+
+    if(!is_paused) stopTimers();
+    is_finished = true;
+
+    return false;
+}
+
+void BenchmarkState::pauseTiming()
+{
+    if(is_paused) return;
+
+    stopTimers();
+    is_paused = true;
+}
+
+void BenchmarkState::resumeTiming()
+{
+    if(!is_paused) return;
+
+    startTimers();
+    is_paused = false;
+}
+
+void BenchmarkState::skipWithError(string message)
+{
+    error = message.empty() ? "skipped" : message;
+}
+
+BenchmarkRegistry &BenchmarkRegistry::get()
+{
+    static BenchmarkRegistry registry;
+    return registry;
+}
+
+Benchmark &BenchmarkRegistry::add(string name, function<void(BenchmarkState&)> run)
+{
+    benchmarks.emplace_back(name, run);
+    return benchmarks.back();
+}
+
+void BenchmarkRunner::printUsage(ostream &out)
+{
+    out << "  --benchmark_filter=regex       run only the benchmarks whose name matches, -regex to exclude them" << endl;
+    out << "  --benchmark_min_time=seconds   minimum time of the calibrated loop of each benchmark (0.5 by default)" << endl;
+    out << "  --benchmark_repetitions=n      run each benchmark n times and report the mean, median and stddev" << endl;
+    out << "  --benchmark_format=console|json  format written on stdout" << endl;
+    out << "  --benchmark_out=file           also write the results in a JSON file" << endl;
+    out << "  --benchmark_list_tests         only list the benchmarks matching the filter" << endl;
+    out << "  --benchmark_perf_counters=a,b  also report these hardware counters per iteration, among:";
+    for(const string &name: PerfCounters::getEventNames()) out << " " << name;
+    out << endl;
+}
+
+bool BenchmarkRunner::parseFlags(int &argc, char **argv)
+{
+    int nb_kept = 1;
+
+    for(int i = 1; i < argc; ++i)
+    {
+        string arg = argv[i];
+        if(arg.compare(0, 12, "--benchmark_") != 0)
+        {
+            argv[nb_kept++] = argv[i];
+            continue;
+        }
+
+        size_t equal = arg.find('=');
+        string name = arg.substr(0, equal);
+        string value = equal == string::npos ? "" : arg.substr(equal + 1);
+
+        try
+        {
+            if(name == "--benchmark_filter")
+            {
+                filter = value;
+            }
+            else if(name == "--benchmark_min_time")
+            {
+                // Google Benchmark accepts a unit suffix
+                if(!value.empty() && value.back() == 's') value.pop_back();
+                min_time = stod(value);
+            }
+            else if(name == "--benchmark_repetitions")
+            {
+                repetitions = std::max(1, stoi(value));
+            }
+            else if(name == "--benchmark_format" && (value == "console" || value == "json"))
+            {
+                json_format = value == "json";
+            }
+            else if(name == "--benchmark_out" && !value.empty())
+            {
+                out_filename = value;
+            }
+            else if(name == "--benchmark_out_format" && value == "json")
+            {
+                // The only format of the output file
+            }
+            else if(name == "--benchmark_perf_counters")
+            {
+                counter_names.clear();
+                stringstream names(value);
+                string counter;
+                while(getline(names, counter, ','))
+                {
+                    if(!counter.empty()) counter_names.push_back(counter);
+                }
+            }
+            else if(name == "--benchmark_list_tests")
+            {
+                list_only = value.empty() || value == "true";
+            }
+            else
+            {
+                cerr << "Invalid flag " << arg << endl;
+                return false;
+            }
+        }
+        catch(const logic_error &)
+        {
+            cerr << "Invalid value of " << arg << endl;
+            return false;
+        }
+    }
+
+    argc = nb_kept;
+    return true;
+}
+
+BenchmarkRunner::Run BenchmarkRunner::measure(Benchmark &benchmark, size_t iterations, double &elapsed)
+{
+    int previous_threads = omp_get_max_threads();
+    if(benchmark.threads > 0) omp_set_num_threads(benchmark.threads);
+
+    Run run;
+    run.name = benchmark.name;
+    run.run_name = benchmark.name;
+    run.threads = omp_get_max_threads();
+    run.unit = benchmark.unit;
+
+    counters.reset();
+    BenchmarkState state(iterations, counters.isOpen() ? &counters : nullptr);
+    benchmark.run(state);
+
+    omp_set_num_threads(previous_threads);
+
+    elapsed = state.getRealTime();
+    run.iterations = state.getIterations();
+    run.label = state.getLabel();
+    run.error = state.getError();
+
+    if(state.hasError() || run.iterations == 0) return run;
+
+    double multiplier = benchmark.unit == Benchmark::MILLISECOND ? 1e3 : benchmark.unit == Benchmark::MICROSECOND ? 1e6 : 1e9;
+    run.real_time = state.getRealTime() * multiplier / run.iterations;
+    run.cpu_time = state.getCpuTime() * multiplier / run.iterations;
+    run.items_per_second = state.getRealTime() > 0 ? state.getItemsProcessed() / state.getRealTime() : 0;
+
+    for(double value: counters.read())
+    {
+        run.counters.push_back(value / run.iterations);
+    }
+
+    return run;
+}
+
+vector<BenchmarkRunner::Run> BenchmarkRunner::runBenchmark(Benchmark &benchmark)
+{
+    size_t iterations = benchmark.iterations > 0 ? benchmark.iterations : 1;
+    double elapsed = 0;
+    Run run = measure(benchmark, iterations, elapsed);
+
+    // As Google Benchmark: aim 40% past the minimum time, growing at most tenfold at once, until the minimum is reached
+    while(benchmark.iterations == 0 && run.error.empty() && elapsed < min_time && iterations < MAX_ITERATIONS)
+    {
+        double multiplier = elapsed > min_time / 10 ? min_time * 1.4 / elapsed : 10;
+        iterations = std::max(iterations + 1, std::min(MAX_ITERATIONS, static_cast<size_t>(iterations * multiplier)));
+        run = measure(benchmark, iterations, elapsed);
+    }
+
+    // The calibrated run is the first repetition
+    vector<Run> runs = {run};
+    for(int r = 1; r < repetitions && run.error.empty(); ++r)
+    {
+        runs.push_back(measure(benchmark, iterations, elapsed));
+        runs.back().repetition_index = r;
+    }
+
+    if(runs.size() > 1) addAggregates(runs);
+
+    return runs;
+}
+
+void BenchmarkRunner::addAggregates(vector<Run> &runs)
+{
+    size_t n = runs.size();
+    Run mean = runs.front(), median = runs.front(), stddev = runs.front();
+
+    auto aggregate = [&runs, n](function<double(const Run&)> value, double &out_mean, double &out_median, double &out_stddev)
+    {
+        vector<double> values;
+        for(const Run &run: runs) values.push_back(value(run));
+
+        out_mean = accumulate(values.begin(), values.end(), 0.0) / n;
+
+        sort(values.begin(), values.end());
+        out_median = n % 2 ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2;
+
+        double squares = 0;
+        for(double v: values) squares += (v - out_mean) * (v - out_mean);
+        out_stddev = std::sqrt(squares / (n - 1));
+    };
+
+    aggregate([](const Run &r){ return r.real_time; }, mean.real_time, median.real_time, stddev.real_time);
+    aggregate([](const Run &r){ return r.cpu_time; }, mean.cpu_time, median.cpu_time, stddev.cpu_time);
+    aggregate([](const Run &r){ return r.items_per_second; }, mean.items_per_second, median.items_per_second, stddev.items_per_second);
+
+    for(size_t c = 0; c < mean.counters.size(); ++c)
+    {
+        aggregate([c](const Run &r){ return r.counters[c]; }, mean.counters[c], median.counters[c], stddev.counters[c]);
+    }
+
+    for(pair<Run*, string> a: {make_pair(&mean, string("mean")), make_pair(&median, string("median")), make_pair(&stddev, string("stddev"))})
+    {
+        a.first->name = a.first->run_name + "_" + a.second;
+        a.first->aggregate_name = a.second;
+        runs.push_back(*a.first);
+    }
+}
+
+static const char *unitName(Benchmark::TimeUnit unit)
+{
+    return unit == Benchmark::MILLISECOND ? "ms" : unit == Benchmark::MICROSECOND ? "us" : "ns";
+}
+
+static string formatTime(double value)
+{
+    stringstream ss;
+    ss << fixed << setprecision(value < 10 ? 2 : value < 100 ? 1 : 0) << value;
+    return ss.str();
+}
+
+/// Count with a k, M or G suffix, as Google Benchmark writes its counters.
+static string formatCount(double value)
+{
+    const char *suffixes[] = {"", "k", "M", "G"};
+    int s = 0;
+    for(; s < 3 && std::abs(value) >= 1000; ++s) value /= 1000;
+
+    stringstream ss;
+    ss << setprecision(4) << value << suffixes[s];
+    return ss.str();
+}
+
+static string escapeJSON(string s)
+{
+    string escaped;
+    for(char c: s)
+    {
+        if(c == '"' || c == '\\') escaped += '\\';
+        escaped += c;
+    }
+    return escaped;
+}
+
+static size_t name_width = 40;
+
+void BenchmarkRunner::writeConsoleHeader(ostream &out)
+{
+    out << left << setw(name_width) << "Benchmark" << right << setw(15) << "Time" << setw(15) << "CPU" << setw(13) << "Iterations" << "  Counters" << endl;
+    out << string(name_width + 53, '-') << endl;
+}
+
+void BenchmarkRunner::writeConsoleRun(ostream &out, const Run &run)
+{
+    out << left << setw(name_width) << run.name << right;
+
+    if(!run.error.empty())
+    {
+        out << "  ERROR OCCURRED: '" << run.error << "'" << endl;
+        return;
+    }
+
+    out << setw(12) << formatTime(run.real_time) << " " << unitName(run.unit)
+        << setw(12) << formatTime(run.cpu_time) << " " << unitName(run.unit)
+        << setw(13) << (run.aggregate_name.empty() ? to_string(run.iterations) : "");
+
+    if(run.items_per_second > 0)
+    {
+        out << "  items_per_second=" << setprecision(4) << run.items_per_second / 1e6 << "M/s";
+    }
+    for(size_t c = 0; c < run.counters.size(); ++c)
+    {
+        out << "  " << counters.getNames()[c] << "=" << formatCount(run.counters[c]);
+    }
+    if(!run.label.empty()) out << "  " << run.label;
+
+    out << endl;
+}
+
+void BenchmarkRunner::writeJSON(ostream &out, string executable, const vector<Run> &runs)
+{
+    char host_name[256] = "";
+    gethostname(host_name, sizeof(host_name) - 1);
+
+    time_t now = time(nullptr);
+    char date[64];
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S%z", localtime(&now));
+
+    out << "{" << endl;
+    out << "  \"context\": {" << endl;
+    out << "    \"date\": \"" << date << "\"," << endl;
+    out << "    \"host_name\": \"" << escapeJSON(host_name) << "\"," << endl;
+    out << "    \"executable\": \"" << escapeJSON(executable) << "\"," << endl;
+    out << "    \"num_cpus\": " << omp_get_num_procs() << "," << endl;
+#ifdef NDEBUG
+    out << "    \"library_build_type\": \"release\"";
+#else
+    out << "    \"library_build_type\": \"debug\"";
+#endif
+    for(const auto &entry: context)
+    {
+        out << "," << endl << "    \"" << escapeJSON(entry.first) << "\": " << entry.second;
+    }
+    out << endl << "  }," << endl;
+
+    out << "  \"benchmarks\": [";
+    out << setprecision(numeric_limits<double>::max_digits10);
+
+    for(size_t i = 0; i < runs.size(); ++i)
+    {
+        const Run &run = runs[i];
+        out << (i == 0 ? "" : ",") << endl << "    {" << endl;
+        out << "      \"name\": \"" << escapeJSON(run.name) << "\"," << endl;
+        out << "      \"run_name\": \"" << escapeJSON(run.run_name) << "\"," << endl;
+        out << "      \"run_type\": \"" << (run.aggregate_name.empty() ? "iteration" : "aggregate") << "\"," << endl;
+        out << "      \"repetitions\": " << repetitions << "," << endl;
+
+        if(run.aggregate_name.empty())
+        {
+            out << "      \"repetition_index\": " << run.repetition_index << "," << endl;
+        }
+        else
+        {
+            out << "      \"aggregate_name\": \"" << run.aggregate_name << "\"," << endl;
+        }
+
+        out << "      \"threads\": " << run.threads << "," << endl;
+
+        if(!run.error.empty())
+        {
+            out << "      \"error_occurred\": true," << endl;
+            out << "      \"error_message\": \"" << escapeJSON(run.error) << "\"" << endl << "    }";
+            continue;
+        }
+
+        out << "      \"iterations\": " << run.iterations << "," << endl;
+        out << "      \"real_time\": " << run.real_time << "," << endl;
+        out << "      \"cpu_time\": " << run.cpu_time << "," << endl;
+        out << "      \"time_unit\": \"" << unitName(run.unit) << "\"";
+
+        if(run.items_per_second > 0)
+        {
+            out << "," << endl << "      \"items_per_second\": " << run.items_per_second;
+        }
+        for(size_t c = 0; c < run.counters.size(); ++c)
+        {
+            out << "," << endl << "      \"" << counters.getNames()[c] << "\": " << run.counters[c];
+        }
+        if(!run.label.empty())
+        {
+            out << "," << endl << "      \"label\": \"" << escapeJSON(run.label) << "\"";
+        }
+
+        out << endl << "    }";
+    }
+
+    out << endl << "  ]" << endl << "}" << endl;
+}
+
+int BenchmarkRunner::run(string executable)
+{
+    // A leading '-' excludes the benchmarks matching the rest of the filter
+    bool exclude = !filter.empty() && filter[0] == '-';
+    regex pattern;
+    try
+    {
+        pattern = regex(exclude ? filter.substr(1) : filter);
+    }
+    catch(const regex_error &)
+    {
+        cerr << "Invalid filter " << filter << endl;
+        return EXIT_FAILURE;
+    }
+
+    vector<Benchmark*> selected;
+    for(Benchmark &benchmark: BenchmarkRegistry::get().getBenchmarks())
+    {
+        if(regex_search(benchmark.name, pattern) != exclude) selected.push_back(&benchmark);
+    }
+
+    if(list_only)
+    {
+        for(Benchmark *p_benchmark: selected) cout << p_benchmark->name << endl;
+        return EXIT_SUCCESS;
+    }
+
+    if(selected.empty())
+    {
+        cerr << "No benchmark matches " << filter << endl;
+        return EXIT_FAILURE;
+    }
+
+    if(!counter_names.empty())
+    {
+        // As Google Benchmark, the benchmarks still run without the counters
+        string message;
+        if(!counters.open(counter_names, message)) cerr << "Performance counters not available: " << message << endl;
+    }
+
+    name_width = 10;
+    for(Benchmark *p_benchmark: selected) name_width = std::max(name_width, p_benchmark->name.size() + 8);
+
+    if(!json_format) writeConsoleHeader(cout);
+
+    vector<Run> runs;
+    for(Benchmark *p_benchmark: selected)
+    {
+        for(const Run &run: runBenchmark(*p_benchmark))
+        {
+            if(!json_format) writeConsoleRun(cout, run);
+            runs.push_back(run);
+        }
+    }
+
+    if(json_format) writeJSON(cout, executable, runs);
+
+    if(!out_filename.empty())
+    {
+        ofstream out(out_filename, ios::out | ios::trunc);
+        if(!out.is_open())
+        {
+            cerr << "Could not write results in " << out_filename << endl;
+            return EXIT_FAILURE;
+        }
+        writeJSON(out, executable, runs);
+    }
+
+    return EXIT_SUCCESS;
+}
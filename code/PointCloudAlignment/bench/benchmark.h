@@ -0,0 +1,198 @@
+#pragma once
+
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <time.h>
+
+using namespace std;
+
+/**
+ * @brief Hardware counters (cache misses, cycles...) of the calling thread, read through perf_event_open on Linux.
+ * Threads of the OpenMP pool are not counted: the counters are only meaningful for single-threaded benchmarks.
+ */
+class PerfCounters
+{
+public:
+    PerfCounters() {}
+    PerfCounters(const PerfCounters &) = delete;
+    PerfCounters &operator=(const PerfCounters &) = delete;
+    ~PerfCounters() { close(); }
+
+    /// Names of the events that can be opened, as given to --benchmark_perf_counters.
+    static vector<string> getEventNames();
+
+    /// Open the events, returns false with a message if one of them is unknown or not allowed (see perf_event_paranoid).
+    bool open(const vector<string> &names, string &message);
+    void close();
+
+    bool isOpen() const { return !fds.empty(); }
+    const vector<string> &getNames() const { return names; }
+
+    void reset();
+    void start();
+    void stop();
+    /// Count of every event since the last reset, in the order of the names.
+    vector<double> read() const;
+
+private:
+    vector<string> names;
+    vector<int> fds;
+};
+
+/**
+ * @brief Minimal harness in the style of Google Benchmark, so that pca_bench does not need another dependency.
+ *
+ * A benchmark is a function running its loop while keepRunning() is true. The harness first calibrates the number
+ * of iterations until the loop lasts at least the minimum time, then reports the time per iteration. The flags
+ * (--benchmark_filter, --benchmark_min_time, --benchmark_repetitions, --benchmark_format, --benchmark_out) and the
+ * JSON output follow Google Benchmark, so that its compare.py script can be used to track regressions between builds.
+ * --benchmark_perf_counters adds hardware counters to the reports, per iteration.
+ */
+class BenchmarkState
+{
+public:
+    BenchmarkState(size_t max_iterations, PerfCounters *p_counters = nullptr): max_iterations(max_iterations), p_counters(p_counters) {}
+
+    /// True as long as the loop must go on. Timing starts at the first call and stops at the last one.
+    bool keepRunning();
+
+    /// Exclude the code run between pauseTiming and resumeTiming, e.g. resetting the input of the next iteration.
+    void pauseTiming();
+    void resumeTiming();
+
+    /// Stop the benchmark, it is reported with the message instead of timings. Must be called before the loop.
+    void skipWithError(string message);
+
+    /// Number of items (points, planes...) processed by every iteration together, reported as items_per_second.
+    void setItemsProcessed(size_t items) { this->items = items; }
+    void setLabel(string label) { this->label = label; }
+
+    size_t getIterations() const { return iterations; }
+    double getRealTime() const { return real_time; }
+    double getCpuTime() const { return cpu_time; }
+    size_t getItemsProcessed() const { return items; }
+    string getLabel() const { return label; }
+    bool hasError() const { return !error.empty(); }
+    string getError() const { return error; }
+
+private:
+    size_t max_iterations;
+    /// Counted along with the timers, null if no counter is enabled.
+    PerfCounters *p_counters;
+    size_t iterations = 0;
+    bool is_finished = false;
+    bool is_paused = false;
+    struct timespec real_start;
+    struct timespec cpu_start;
+    double real_time = 0;
+    double cpu_time = 0;
+    size_t items = 0;
+    string label;
+    string error;
+
+    void startTimers();
+    void stopTimers();
+};
+
+/// Keep the compiler from optimizing value, and the computation of value, away.
+template<typename T>
+inline void doNotOptimize(const T &value)
+{
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+class Benchmark
+{
+public:
+    enum TimeUnit { NANOSECOND, MICROSECOND, MILLISECOND };
+
+    Benchmark(string name, function<void(BenchmarkState&)> run): name(name), run(run) {}
+
+    Benchmark &setUnit(TimeUnit unit) { this->unit = unit; return *this; }
+    /// Run exactly this number of iterations instead of calibrating it, for benchmarks of whole stages.
+    Benchmark &setIterations(size_t iterations) { this->iterations = iterations; return *this; }
+    /// Number of OpenMP threads set while the benchmark runs, 0 to keep the current one.
+    Benchmark &setThreads(int threads) { this->threads = threads; return *this; }
+
+    string getName() const { return name; }
+
+private:
+    friend class BenchmarkRunner;
+
+    string name;
+    function<void(BenchmarkState&)> run;
+    TimeUnit unit = NANOSECOND;
+    size_t iterations = 0;
+    int threads = 0;
+};
+
+/// Registered benchmarks, in their registration order.
+class BenchmarkRegistry
+{
+public:
+    static BenchmarkRegistry &get();
+
+    Benchmark &add(string name, function<void(BenchmarkState&)> run);
+    vector<Benchmark> &getBenchmarks() { return benchmarks; }
+
+private:
+    vector<Benchmark> benchmarks;
+};
+
+class BenchmarkRunner
+{
+public:
+    /**
+     * @brief Read the --benchmark_* flags and remove them from argv, the other arguments are left for the caller.
+     * @return false if a flag is invalid.
+     */
+    bool parseFlags(int &argc, char **argv);
+
+    /// Extra key/value pairs written in the context of the reports, the value being a JSON value.
+    void addContext(string key, string json_value) { context.push_back({key, json_value}); }
+
+    /// Run the benchmarks matching the filter and write the reports. Returns EXIT_SUCCESS or EXIT_FAILURE.
+    int run(string executable);
+
+    static void printUsage(ostream &out);
+
+private:
+    typedef struct _Run
+    {
+        string name;
+        string run_name;
+        string aggregate_name;
+        int repetition_index = 0;
+        int threads = 1;
+        size_t iterations = 0;
+        double real_time = 0;
+        double cpu_time = 0;
+        double items_per_second = 0;
+        /// Value of every hardware counter, per iteration.
+        vector<double> counters;
+        string label;
+        string error;
+        Benchmark::TimeUnit unit = Benchmark::NANOSECOND;
+    } Run;
+
+    string filter = ".";
+    double min_time = 0.5;
+    int repetitions = 1;
+    bool list_only = false;
+    bool json_format = false;
+    string out_filename;
+    vector<string> counter_names;
+    PerfCounters counters;
+    vector<pair<string, string>> context;
+
+    vector<Run> runBenchmark(Benchmark &benchmark);
+    Run measure(Benchmark &benchmark, size_t iterations, double &elapsed);
+    void addAggregates(vector<Run> &runs);
+
+    void writeConsoleHeader(ostream &out);
+    void writeConsoleRun(ostream &out, const Run &run);
+    void writeJSON(ostream &out, string executable, const vector<Run> &runs);
+};
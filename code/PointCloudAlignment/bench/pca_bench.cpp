@@ -0,0 +1,965 @@
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <omp.h>
+
+#include "benchmark.h"
+#include "common.h"
+#include "alignment_config.h"
+#include "normal_computation.h"
+#include "normal_orientation.h"
+#include "plane_segmentation.h"
+#include "plane_merging.h"
+#include "pfh_evaluation.h"
+#include "registration.h"
+#include "synthetic_city.h"
+#include "tombstone_kdtree.h"
+
+using namespace std;
+
+/// Microbenchmarks of the kernels of the pipeline, on procedural roofs generated from a fixed seed so that
+/// the results of two builds can be compared. ./pca_bench --help lists the options.
+
+struct BenchOptions
+{
+    size_t scene_points = 50000;
+    size_t tile_points = 1000000;
+    unsigned seed = 42;
+    float noise = 0.02f;
+    int max_threads = omp_get_num_procs();
+};
+
+static BenchOptions options;
+
+/// Number of inputs (neighborhoods, matrices...) the kernels cycle through.
+static const size_t NB_SAMPLES = 256;
+
+/**
+ * @brief Buildings with gabled or flat roofs and their walls on a ground plane, about nb_points in total, sampled from
+ * a SyntheticCity without trees. The same seed always gives the same cloud.
+ */
+static PointNormalKCloud::Ptr makeRoofs(size_t nb_points, unsigned seed, float noise)
+{
+    SyntheticCity::Parameters parameters;
+    parameters.seed = seed;
+    parameters.noise = noise;
+    parameters.trees = 0;
+
+    SyntheticCity city;
+    city.setParameters(parameters);
+    city.generate(nb_points);
+
+    return city.sampleCloud(seed);
+}
+
+/// Preprocessed roofs and, unless only the preprocessing is needed, their segmented and merged planes.
+typedef struct _RoofScene
+{
+    /// Preprocessed points, before segmentation, and their neighbor graph.
+    PointNormalKCloud::Ptr p_cloud;
+    NeighborGraph::Ptr p_graph;
+    /// Cloud of the segmentation, the planes indices refer to it.
+    PointNormalKCloud::Ptr p_segmented_cloud;
+    vector<SegmentedPointsContainer::SegmentedPlane> planes;
+    vector<float> surfaces;
+} RoofScene;
+
+/// Point and indices of its nearest neighbors, sorted by increasing distance.
+typedef struct _Neighborhood
+{
+    int point;
+    boost::shared_ptr<vector<int>> p_indices;
+    vector<float> sqr_distances;
+} Neighborhood;
+
+class KernelBenchmarks
+{
+public:
+    static void registerAll();
+
+private:
+    /// Order of the points of a scene: as sampled block by block, shuffled, or sorted by PlaneSegmentation::reorderCloud.
+    enum PointOrder { SAMPLED, SHUFFLED, MORTON };
+
+    static AlignmentConfig config;
+
+    static RoofScene buildScene(size_t nb_points, bool segment, PointOrder order = SAMPLED);
+    static RoofScene &getScene();
+    static RoofScene &getTile();
+    /// Preprocessed points of the scene in the other orders, for the cache locality benchmarks.
+    static RoofScene &getShuffledScene();
+    static RoofScene &getMortonScene();
+    static PointNormalKCloud::Ptr shufflePoints(PointNormalKCloud::Ptr p_cloud);
+    /// Scene points before any preprocessing, as dense as an aerial scan.
+    static PointNormalKCloud::Ptr getRawCloud();
+    /// Segmentation ready to run on a copy of the scene cloud, searching neighbors with the given NeighborSearch backend.
+    static unique_ptr<PlaneSegmentation> newSegmentation(RoofScene &scene, int nb_seeds, int backend = NeighborSearch::KDTREE);
+    static vector<Neighborhood> sampleNeighborhoods(PointNormalKCloud::Ptr p_cloud, int k, size_t nb_samples);
+    static vector<int> getThreadCounts();
+
+    static void estimatePlane(BenchmarkState &state, int k, bool soa, RoofScene &(*getInput)() = getScene);
+    static void estimateKForPoint(BenchmarkState &state);
+    static void computeNormalCloud(BenchmarkState &state, int backend);
+    /// Whole preprocessing of the shuffled raw scene, sorting it first along a Morton curve or not.
+    static void preprocessCloud(BenchmarkState &state, bool morton_order);
+    /// Orientation of the normals of the scene or of the tile over their neighbor graph.
+    static void orientNormals(BenchmarkState &state, RoofScene &(*getInput)());
+    static void buildSearch(BenchmarkState &state, int backend);
+    static void nearestKSearch(BenchmarkState &state, int backend, int k);
+    static void getNeighborsOf(BenchmarkState &state, int frontier_size, bool use_graph, int backend = NeighborSearch::KDTREE,
+                               RoofScene &(*getInput)() = getScene);
+    static void getMeanOfMinDistances(BenchmarkState &state, int backend);
+    static void getPlaneTolerance(BenchmarkState &state);
+    static void filterPointsInPlane(BenchmarkState &state, bool batch);
+    static void removePoints(BenchmarkState &state, size_t batch_size, bool tombstones);
+    static void farestPointInDir(BenchmarkState &state);
+    static void computeAPFHSignature(BenchmarkState &state);
+    static void getMinTargetAPFH(BenchmarkState &state);
+    static void getMinTargetPFH(BenchmarkState &state);
+    static void computeDelaunaySurface(BenchmarkState &state);
+    static void computeR(BenchmarkState &state);
+    /// Segmentation of the scene or of the tile, with the given log level during the region growing, -1 to keep the current one.
+    static void segmentation(BenchmarkState &state, RoofScene &(*getInput)(), int nb_seeds, int log_level);
+};
+
+AlignmentConfig KernelBenchmarks::config;
+
+RoofScene KernelBenchmarks::buildScene(size_t nb_points, bool segment, PointOrder order)
+{
+    RoofScene scene;
+
+    PointNormalKCloud::Ptr p_roofs = makeRoofs(nb_points, options.seed, options.noise);
+    if(order == SHUFFLED) p_roofs = shufflePoints(p_roofs);
+
+    AlignmentConfig scene_config = config;
+    scene_config.morton_order = order == MORTON;
+
+    PlaneSegmentation segmentation;
+    segmentation.setConfig(scene_config);
+    segmentation.init(p_roofs, true);
+    segmentation.preprocessCloud();
+
+    // The segmentation modifies its cloud
+    scene.p_cloud = PointNormalKCloud::Ptr(new PointNormalKCloud(*segmentation.getPointCloud()));
+    scene.p_graph = segmentation.getNeighborGraph();
+
+    if(!segment) return scene;
+
+    segmentation.filterOutCurvature(config.max_curvature);
+    segmentation.start_pause();
+    segmentation.runMainLoop();
+
+    vector<SegmentedPointsContainer::SegmentedPlane> planes = segmentation.getSegmentedPlanes();
+    PlaneMerging merging;
+    merging.setConfig(config);
+    merging.init(nullptr, true);
+    merging.start_merge(planes, segmentation.getPointCloud());
+
+    scene.p_segmented_cloud = segmentation.getPointCloud();
+    scene.planes = merging.getSegmentedPlanes();
+
+    Registration registration;
+    scene.surfaces = registration.computeDelaunaySurfaces(scene.p_segmented_cloud, scene.planes);
+
+    return scene;
+}
+
+RoofScene &KernelBenchmarks::getScene()
+{
+    static RoofScene scene = buildScene(options.scene_points, true);
+    return scene;
+}
+
+RoofScene &KernelBenchmarks::getTile()
+{
+    static RoofScene tile = buildScene(options.tile_points, false);
+    return tile;
+}
+
+RoofScene &KernelBenchmarks::getShuffledScene()
+{
+    static RoofScene scene = buildScene(options.scene_points, false, SHUFFLED);
+    return scene;
+}
+
+RoofScene &KernelBenchmarks::getMortonScene()
+{
+    static RoofScene scene = buildScene(options.scene_points, false, MORTON);
+    return scene;
+}
+
+PointNormalKCloud::Ptr KernelBenchmarks::shufflePoints(PointNormalKCloud::Ptr p_cloud)
+{
+    PointNormalKCloud::Ptr p_shuffled(new PointNormalKCloud(*p_cloud));
+    std::shuffle(p_shuffled->points.begin(), p_shuffled->points.end(), mt19937(options.seed));
+
+    return p_shuffled;
+}
+
+PointNormalKCloud::Ptr KernelBenchmarks::getRawCloud()
+{
+    static PointNormalKCloud::Ptr p_cloud = makeRoofs(options.scene_points, options.seed, options.noise);
+    return p_cloud;
+}
+
+unique_ptr<PlaneSegmentation> KernelBenchmarks::newSegmentation(RoofScene &scene, int nb_seeds, int backend)
+{
+    AlignmentConfig segmentation_config = config;
+    segmentation_config.neighbor_search = backend;
+
+    unique_ptr<PlaneSegmentation> p_segmentation(new PlaneSegmentation);
+    p_segmentation->setConfig(segmentation_config);
+    p_segmentation->init(PointNormalKCloud::Ptr(new PointNormalKCloud(*scene.p_cloud)), true);
+    p_segmentation->setNeighborGraph(scene.p_graph);
+    p_segmentation->setNbParallelSeeds(nb_seeds);
+    p_segmentation->filterOutCurvature(config.max_curvature);
+    p_segmentation->start_pause();
+
+    return p_segmentation;
+}
+
+vector<Neighborhood> KernelBenchmarks::sampleNeighborhoods(PointNormalKCloud::Ptr p_cloud, int k, size_t nb_samples)
+{
+    KdTreeFlannK kdtree;
+    kdtree.setInputCloud(p_cloud);
+
+    mt19937 rng(options.seed);
+    uniform_int_distribution<int> point(0, static_cast<int>(p_cloud->size()) - 1);
+
+    vector<Neighborhood> neighborhoods(nb_samples);
+    for(Neighborhood &neighborhood: neighborhoods)
+    {
+        neighborhood.point = point(rng);
+        neighborhood.p_indices = boost::shared_ptr<vector<int>>(new vector<int>);
+        kdtree.nearestKSearch(p_cloud->points[neighborhood.point], k, *neighborhood.p_indices, neighborhood.sqr_distances);
+    }
+
+    return neighborhoods;
+}
+
+vector<int> KernelBenchmarks::getThreadCounts()
+{
+    vector<int> counts;
+    for(int t = 1; t < options.max_threads; t *= 2)
+    {
+        counts.push_back(t);
+    }
+    counts.push_back(options.max_threads);
+
+    return counts;
+}
+
+void KernelBenchmarks::estimatePlane(BenchmarkState &state, int k, bool soa, RoofScene &(*getInput)())
+{
+    RoofScene &scene = getInput();
+    vector<Neighborhood> neighborhoods = sampleNeighborhoods(scene.p_cloud, k, NB_SAMPLES);
+    PointCloudSoA cloud_soa(*scene.p_cloud);
+
+    Plane plane;
+    size_t i = 0;
+
+    while(state.keepRunning())
+    {
+        if(soa)
+        {
+            Plane::estimatePlane(cloud_soa, *neighborhoods[i].p_indices, plane);
+        }
+        else
+        {
+            Plane::estimatePlane(scene.p_cloud, neighborhoods[i].p_indices, plane);
+        }
+        doNotOptimize(plane);
+
+        i = (i + 1) % neighborhoods.size();
+    }
+
+    state.setItemsProcessed(state.getIterations() * k);
+}
+
+void KernelBenchmarks::estimateKForPoint(BenchmarkState &state)
+{
+    RoofScene &scene = getScene();
+    NormalComputation normals;
+    normals.setConfig(config);
+
+    int max_k = config.max_k_original;
+    vector<Neighborhood> neighborhoods = sampleNeighborhoods(scene.p_cloud, max_k, NB_SAMPLES);
+
+    NeighborhoodMoments moments;
+    float curvature;
+    size_t i = 0;
+
+    while(state.keepRunning())
+    {
+        // The moments are computed once per point, they are part of the estimation
+        Neighborhood &n = neighborhoods[i];
+        const PointNormalK &p = scene.p_cloud->points[n.point];
+        moments.compute(*scene.p_cloud, *n.p_indices, n.sqr_distances, vec3(p.x, p.y, p.z));
+        int k = normals.estimateKForPoint(n.point, scene.p_cloud, moments, n.sqr_distances, max_k, curvature);
+        doNotOptimize(k);
+        doNotOptimize(curvature);
+
+        i = (i + 1) % neighborhoods.size();
+    }
+
+    state.setItemsProcessed(state.getIterations());
+}
+
+void KernelBenchmarks::computeNormalCloud(BenchmarkState &state, int backend)
+{
+    NormalComputation normals;
+    normals.setConfig(config);
+
+    PointNormalKCloud::Ptr p_cloud(new PointNormalKCloud(*getRawCloud()));
+    NeighborSearch::Ptr p_search = NeighborSearch::create(backend);
+    p_search->setInputCloud(p_cloud);
+
+    // The normals are written over at every iteration, the neighbors do not change
+    while(state.keepRunning())
+    {
+        normals.computeNormalCloud(p_cloud, p_search, false);
+    }
+    doNotOptimize(p_cloud->points[0].normal_x);
+
+    state.setItemsProcessed(state.getIterations() * p_cloud->size());
+}
+
+void KernelBenchmarks::preprocessCloud(BenchmarkState &state, bool morton_order)
+{
+    static PointNormalKCloud::Ptr p_shuffled = shufflePoints(getRawCloud());
+
+    AlignmentConfig preprocessing_config = config;
+    preprocessing_config.morton_order = morton_order;
+
+    while(state.keepRunning())
+    {
+        state.pauseTiming();
+        PlaneSegmentation segmentation;
+        segmentation.setConfig(preprocessing_config);
+        segmentation.init(PointNormalKCloud::Ptr(new PointNormalKCloud(*p_shuffled)), true);
+        state.resumeTiming();
+
+        segmentation.preprocessCloud();
+    }
+
+    state.setItemsProcessed(state.getIterations() * p_shuffled->size());
+}
+
+void KernelBenchmarks::orientNormals(BenchmarkState &state, RoofScene &(*getInput)())
+{
+    RoofScene &input = getInput();
+    PointNormalKCloud cloud(*input.p_cloud);
+    NormalOrientation orientation;
+
+    // The normals are already oriented, orienting them again does the same work and leaves them as they are
+    while(state.keepRunning())
+    {
+        orientation.orient(cloud, *input.p_graph);
+    }
+    doNotOptimize(cloud.points[0].normal_x);
+
+    state.setItemsProcessed(state.getIterations() * cloud.size());
+}
+
+void KernelBenchmarks::buildSearch(BenchmarkState &state, int backend)
+{
+    PointNormalKCloud::Ptr p_cloud = getRawCloud();
+    NeighborSearch::Ptr p_search = NeighborSearch::create(backend);
+
+    while(state.keepRunning())
+    {
+        p_search->setInputCloud(p_cloud);
+    }
+
+    state.setItemsProcessed(state.getIterations() * p_cloud->size());
+}
+
+void KernelBenchmarks::nearestKSearch(BenchmarkState &state, int backend, int k)
+{
+    PointNormalKCloud::Ptr p_cloud = getRawCloud();
+    NeighborSearch::Ptr p_search = NeighborSearch::create(backend);
+    p_search->setInputCloud(p_cloud);
+
+    vector<int> indices;
+    vector<float> sqr_distances;
+    size_t i = 0;
+
+    // Every point is queried in turn, as the normal computation does
+    while(state.keepRunning())
+    {
+        p_search->nearestKSearch(p_cloud->points[i], k, indices, sqr_distances);
+        doNotOptimize(indices.data());
+
+        i = (i + 1) % p_cloud->size();
+    }
+
+    state.setItemsProcessed(state.getIterations());
+}
+
+void KernelBenchmarks::getNeighborsOf(BenchmarkState &state, int frontier_size, bool use_graph, int backend, RoofScene &(*getInput)())
+{
+    RoofScene &scene = getInput();
+    unique_ptr<PlaneSegmentation> p_segmentation = newSegmentation(scene, 1, backend);
+    if(!use_graph) p_segmentation->p_graph.reset();
+    p_segmentation->buildPointCloudSoA();
+
+    // A region growing frontier is a compact set of points
+    vector<Neighborhood> frontiers = sampleNeighborhoods(scene.p_cloud, frontier_size, 16);
+
+    PlaneSegmentation::FrontierStamps stamps;
+    vector<int> candidates;
+    size_t i = 0, nb_candidates = 0;
+
+    while(state.keepRunning())
+    {
+        p_segmentation->getNeighborsOf(frontiers[i].p_indices, stamps, candidates);
+        nb_candidates += candidates.size();
+
+        i = (i + 1) % frontiers.size();
+    }
+
+    state.setItemsProcessed(state.getIterations() * frontier_size);
+    state.setLabel(to_string(nb_candidates / std::max<size_t>(1, state.getIterations())) + " candidates");
+}
+
+void KernelBenchmarks::getMeanOfMinDistances(BenchmarkState &state, int backend)
+{
+    RoofScene &scene = getScene();
+    unique_ptr<PlaneSegmentation> p_segmentation = newSegmentation(scene, 1, backend);
+
+    vector<int> indices(scene.p_cloud->size());
+    iota(indices.begin(), indices.end(), 0);
+
+    while(state.keepRunning())
+    {
+        float mean = p_segmentation->getMeanOfMinDistances(indices);
+        doNotOptimize(mean);
+    }
+
+    state.setItemsProcessed(state.getIterations() * indices.size());
+}
+
+void KernelBenchmarks::getPlaneTolerance(BenchmarkState &state)
+{
+    RoofScene &scene = getScene();
+
+    boost::shared_ptr<vector<int>> p_indices(new vector<int>(scene.p_cloud->size()));
+    iota(p_indices->begin(), p_indices->end(), 0);
+    Plane ground(0, 0, 1, 0);
+
+    while(state.keepRunning())
+    {
+        float tolerance = ground.getPlaneTolerance(scene.p_cloud, p_indices);
+        doNotOptimize(tolerance);
+    }
+
+    state.setItemsProcessed(state.getIterations() * p_indices->size());
+}
+
+void KernelBenchmarks::filterPointsInPlane(BenchmarkState &state, bool batch)
+{
+    RoofScene &scene = getScene();
+    if(scene.planes.empty())
+    {
+        state.skipWithError("no plane was segmented in the scene");
+        return;
+    }
+
+    // Every point of the scene is a candidate of the largest plane, in random order
+    PointCloudSoA cloud_soa(*scene.p_segmented_cloud);
+    auto largest = max_element(scene.planes.begin(), scene.planes.end(), [](const SegmentedPointsContainer::SegmentedPlane &p1, const SegmentedPointsContainer::SegmentedPlane &p2) {
+        return p1.indices_list.size() < p2.indices_list.size();
+    });
+    Plane plane = largest->plane;
+
+    vector<int> candidates(cloud_soa.size());
+    iota(candidates.begin(), candidates.end(), 0);
+    shuffle(candidates.begin(), candidates.end(), mt19937(options.seed));
+
+    float epsilon = 0.1f;
+    float cos_max_angle = std::cos(config.max_normal_angle);
+    vector<int> accepted;
+    accepted.reserve(candidates.size());
+
+    while(state.keepRunning())
+    {
+        accepted.clear();
+
+        if(batch)
+        {
+            plane.filterPointsInPlane(cloud_soa, candidates, epsilon, cos_max_angle, accepted);
+        }
+        else
+        {
+            for(int i: candidates)
+            {
+                if(plane.pointInPlane(cloud_soa, i, epsilon) && plane.normalInPlane(cloud_soa, i, config.max_normal_angle))
+                {
+                    accepted.push_back(i);
+                }
+            }
+        }
+        doNotOptimize(accepted.data());
+    }
+
+    state.setItemsProcessed(state.getIterations() * candidates.size());
+    state.setLabel(to_string(accepted.size()) + " accepted");
+}
+
+void KernelBenchmarks::removePoints(BenchmarkState &state, size_t batch_size, bool tombstones)
+{
+    RoofScene &scene = getScene();
+    size_t nb_points = scene.p_cloud->size();
+
+    // Points are removed by batches in random order, as the region growing excludes them
+    vector<int> order(nb_points);
+    iota(order.begin(), order.end(), 0);
+    shuffle(order.begin(), order.end(), mt19937(options.seed));
+
+    vector<vector<int>> batches;
+    for(size_t b = 0; b + batch_size <= nb_points; b += batch_size)
+    {
+        batches.emplace_back(order.begin() + b, order.begin() + b + batch_size);
+        sort(batches.back().begin(), batches.back().end());
+    }
+
+    TombstoneKdTree tombstone_kdtree;
+    KdTreeFlannK kdtree;
+    boost::shared_ptr<vector<int>> p_indices(new vector<int>);
+    size_t next = batches.size();
+
+    while(state.keepRunning())
+    {
+        if(next == batches.size())
+        {
+            state.pauseTiming();
+            if(tombstones)
+            {
+                tombstone_kdtree.setInputCloud(scene.p_cloud);
+            }
+            else
+            {
+                p_indices->resize(nb_points);
+                iota(p_indices->begin(), p_indices->end(), 0);
+            }
+            next = 0;
+            state.resumeTiming();
+        }
+
+        vector<int> &batch = batches[next++];
+
+        if(tombstones)
+        {
+            tombstone_kdtree.remove(batch);
+        }
+        else
+        {
+            // Removal by a full rebuild, as the search tree was updated before it had tombstones
+            boost::shared_ptr<vector<int>> p_remaining(new vector<int>);
+            set_difference(p_indices->begin(), p_indices->end(), batch.begin(), batch.end(), back_inserter(*p_remaining));
+            p_indices = p_remaining;
+
+            if(!p_indices->empty()) kdtree.setInputCloud(scene.p_cloud, p_indices);
+        }
+    }
+
+    state.setItemsProcessed(state.getIterations() * batch_size);
+}
+
+void KernelBenchmarks::farestPointInDir(BenchmarkState &state)
+{
+    RoofScene &scene = getScene();
+    if(scene.planes.size() < 2)
+    {
+        state.skipWithError("less than 2 planes were segmented in the scene");
+        return;
+    }
+
+    PlaneMerging merging;
+    merging.setConfig(config);
+    merging.p_point_soa = PointCloudSoA::Ptr(new PointCloudSoA(*scene.p_segmented_cloud));
+
+    size_t i = 0, nb_points = 0;
+
+    while(state.keepRunning())
+    {
+        // Direction of the center of the next plane, as for the overlap tests of the merging
+        SegmentedPointsContainer::SegmentedPlane &plane = scene.planes[i];
+        vec3 dir = scene.planes[(i + 1) % scene.planes.size()].plane.getCenter() - plane.plane.getCenter();
+
+        float r = merging.farestPointInDir(plane, dir);
+        doNotOptimize(r);
+        nb_points += plane.indices_list.size();
+
+        i = (i + 1) % scene.planes.size();
+    }
+
+    state.setItemsProcessed(nb_points);
+}
+
+void KernelBenchmarks::computeAPFHSignature(BenchmarkState &state)
+{
+    RoofScene &scene = getScene();
+    if(scene.planes.size() < 2)
+    {
+        state.skipWithError("less than 2 planes were segmented in the scene");
+        return;
+    }
+
+    while(state.keepRunning())
+    {
+        APFHCloud signatures = PFHEvaluation::computeAPFHSignature(scene.planes, scene.surfaces);
+        doNotOptimize(signatures.points.data());
+    }
+
+    state.setItemsProcessed(state.getIterations() * scene.planes.size());
+    state.setLabel(to_string(scene.planes.size()) + " planes");
+}
+
+void KernelBenchmarks::getMinTargetAPFH(BenchmarkState &state)
+{
+    RoofScene &scene = getScene();
+    if(scene.planes.size() < 2)
+    {
+        state.skipWithError("less than 2 planes were segmented in the scene");
+        return;
+    }
+
+    // The scene is matched against itself, every target plane is within the surface interval
+    APFHCloud signatures = PFHEvaluation::computeAPFHSignature(scene.planes, scene.surfaces);
+    float error;
+    size_t i = 0;
+
+    while(state.keepRunning())
+    {
+        int j = PFHEvaluation::getMinTarget(i, scene.surfaces[i], scene.surfaces, signatures, signatures, error, numeric_limits<float>::infinity());
+        doNotOptimize(j);
+
+        i = (i + 1) % scene.planes.size();
+    }
+
+    state.setItemsProcessed(state.getIterations() * scene.planes.size());
+}
+
+void KernelBenchmarks::getMinTargetPFH(BenchmarkState &state)
+{
+    RoofScene &scene = getScene();
+    if(scene.planes.size() < 2)
+    {
+        state.skipWithError("less than 2 planes were segmented in the scene");
+        return;
+    }
+
+    PFHCloud signatures = PFHEvaluation::computePFHSignatures(scene.planes, config.center_knn);
+    float error;
+    size_t i = 0;
+
+    while(state.keepRunning())
+    {
+        size_t j = PFHEvaluation::getMinTarget(i, signatures, signatures, error);
+        doNotOptimize(j);
+
+        i = (i + 1) % signatures.size();
+    }
+
+    state.setItemsProcessed(state.getIterations() * signatures.size());
+}
+
+void KernelBenchmarks::computeDelaunaySurface(BenchmarkState &state)
+{
+    RoofScene &scene = getScene();
+    if(scene.planes.empty())
+    {
+        state.skipWithError("no plane was segmented in the scene");
+        return;
+    }
+
+    Registration registration;
+    registration.setConfig(config);
+    size_t i = 0, nb_points = 0;
+
+    while(state.keepRunning())
+    {
+        float surface = registration.computeDelaunaySurface(scene.p_segmented_cloud, scene.planes[i]);
+        doNotOptimize(surface);
+        nb_points += scene.planes[i].indices_list.size();
+
+        i = (i + 1) % scene.planes.size();
+    }
+
+    state.setItemsProcessed(nb_points);
+}
+
+void KernelBenchmarks::computeR(BenchmarkState &state)
+{
+    Registration registration;
+    registration.setConfig(config);
+
+    // Correlation matrices of random normals, half of them give a reflection to correct
+    mt19937 rng(options.seed);
+    normal_distribution<float> normal(0, 1);
+    vector<mat3, Eigen::aligned_allocator<mat3>> matrices(NB_SAMPLES);
+    for(mat3 &H: matrices)
+    {
+        for(int c = 0; c < 9; ++c)
+        {
+            H(c / 3, c % 3) = normal(rng);
+        }
+    }
+
+    size_t i = 0;
+
+    while(state.keepRunning())
+    {
+        mat3 R = registration.computeR(matrices[i]);
+        doNotOptimize(R);
+
+        i = (i + 1) % matrices.size();
+    }
+
+    state.setItemsProcessed(state.getIterations());
+}
+
+void KernelBenchmarks::segmentation(BenchmarkState &state, RoofScene &(*getInput)(), int nb_seeds, int log_level)
+{
+    if(log_level >= 0 && log_level < PCA_MIN_LOG_LEVEL)
+    {
+        state.skipWithError("messages of this level are not compiled, configure with -DPCA_MIN_LOG_LEVEL=TRACE");
+        return;
+    }
+
+    RoofScene &input = getInput();
+
+    // Messages are written to /dev/null rather than among the results, their formatting and writing is still timed
+    ofstream null_output("/dev/null");
+    streambuf *p_stdout = cout.rdbuf();
+    int previous_level = Logging::getLevel();
+    size_t nb_planes = 0;
+
+    while(state.keepRunning())
+    {
+        state.pauseTiming();
+        unique_ptr<PlaneSegmentation> p_segmentation = newSegmentation(input, nb_seeds);
+        if(log_level >= 0)
+        {
+            cout.rdbuf(null_output.rdbuf());
+            Logging::setLevel(log_level);
+        }
+        state.resumeTiming();
+
+        p_segmentation->runMainLoop();
+
+        state.pauseTiming();
+        Logging::setLevel(previous_level);
+        cout.rdbuf(p_stdout);
+        nb_planes = p_segmentation->getSegmentedPlanes().size();
+        p_segmentation.reset();
+        state.resumeTiming();
+    }
+
+    state.setItemsProcessed(state.getIterations() * input.p_cloud->size());
+    state.setLabel(to_string(nb_planes) + " planes");
+}
+
+void KernelBenchmarks::registerAll()
+{
+    BenchmarkRegistry &registry = BenchmarkRegistry::get();
+
+    for(int k: {15, 50, 200})
+    {
+        registry.add("Plane::estimatePlane/cloud/k:" + to_string(k), [k](BenchmarkState &state) { estimatePlane(state, k, false); });
+        registry.add("Plane::estimatePlane/soa/k:" + to_string(k), [k](BenchmarkState &state) { estimatePlane(state, k, true); });
+    }
+
+    registry.add("NormalComputation::estimateKForPoint", estimateKForPoint);
+
+    for(int frontier_size: {64, 1024, 16384})
+    {
+        registry.add("PlaneSegmentation::getNeighborsOf/graph/frontier:" + to_string(frontier_size),
+                     [frontier_size](BenchmarkState &state) { getNeighborsOf(state, frontier_size, true); });
+        registry.add("PlaneSegmentation::getNeighborsOf/kdtree/frontier:" + to_string(frontier_size),
+                     [frontier_size](BenchmarkState &state) { getNeighborsOf(state, frontier_size, false); });
+        registry.add("PlaneSegmentation::getNeighborsOf/grid/frontier:" + to_string(frontier_size),
+                     [frontier_size](BenchmarkState &state) { getNeighborsOf(state, frontier_size, false, NeighborSearch::GRID); });
+    }
+
+    // Neighbor search backends on the raw scene, over the range of k of the normal computation
+    for(auto backend: {make_pair(string("kdtree"), NeighborSearch::KDTREE), make_pair(string("grid"), NeighborSearch::GRID)})
+    {
+        int id = backend.second;
+        registry.add("NeighborSearch::setInputCloud/" + backend.first, [id](BenchmarkState &state) { buildSearch(state, id); }).setUnit(Benchmark::MICROSECOND);
+
+        for(int k: {7, 15, 30, 50})
+        {
+            registry.add("NeighborSearch::nearestKSearch/" + backend.first + "/k:" + to_string(k),
+                         [id, k](BenchmarkState &state) { nearestKSearch(state, id, k); });
+        }
+    }
+
+    // Cache locality of the kernels reading neighborhoods, on the points as sampled, shuffled and sorted along a Morton curve.
+    // Single-threaded, so that the hardware counters (--benchmark_perf_counters=CACHE-MISSES,L1D-LOAD-MISSES) see every access
+    for(auto order: {make_pair(string("sampled"), getScene), make_pair(string("shuffled"), getShuffledScene), make_pair(string("morton"), getMortonScene)})
+    {
+        RoofScene &(*getInput)() = order.second;
+        registry.add("Plane::estimatePlane/order:" + order.first + "/k:50",
+                     [getInput](BenchmarkState &state) { estimatePlane(state, 50, false, getInput); }).setThreads(1);
+        registry.add("PlaneSegmentation::getNeighborsOf/order:" + order.first + "/frontier:1024",
+                     [getInput](BenchmarkState &state) { getNeighborsOf(state, 1024, true, NeighborSearch::KDTREE, getInput); }).setThreads(1);
+        registry.add("PlaneSegmentation::runMainLoop/order:" + order.first,
+                     [getInput](BenchmarkState &state) { segmentation(state, getInput, 1, -1); }).setThreads(1).setUnit(Benchmark::MILLISECOND);
+    }
+
+    registry.add("PlaneSegmentation::preprocessCloud/order:shuffled",
+                 [](BenchmarkState &state) { preprocessCloud(state, false); }).setThreads(1).setUnit(Benchmark::MILLISECOND);
+    registry.add("PlaneSegmentation::preprocessCloud/order:morton",
+                 [](BenchmarkState &state) { preprocessCloud(state, true); }).setThreads(1).setUnit(Benchmark::MILLISECOND);
+
+    registry.add("PlaneMerging::farestPointInDir", farestPointInDir);
+    registry.add("PFHEvaluation::computeAPFHSignature", computeAPFHSignature).setUnit(Benchmark::MICROSECOND);
+    registry.add("PFHEvaluation::getMinTarget/apfh", getMinTargetAPFH);
+    registry.add("PFHEvaluation::getMinTarget/pfh", getMinTargetPFH);
+    registry.add("Registration::computeDelaunaySurface", computeDelaunaySurface).setUnit(Benchmark::MICROSECOND);
+    registry.add("Registration::computeR", computeR);
+
+    // Candidate filter of the region growing: batch against one point at a time
+    registry.add("Plane::filterPointsInPlane/batch", [](BenchmarkState &state) { filterPointsInPlane(state, true); }).setUnit(Benchmark::MICROSECOND);
+    registry.add("Plane::filterPointsInPlane/scalar", [](BenchmarkState &state) { filterPointsInPlane(state, false); }).setUnit(Benchmark::MICROSECOND);
+
+    // Removal of points from the search tree: tombstones against a full rebuild
+    for(size_t batch_size: {16, 256, 4096})
+    {
+        registry.add("TombstoneKdTree::remove/batch:" + to_string(batch_size),
+                     [batch_size](BenchmarkState &state) { removePoints(state, batch_size, true); }).setUnit(Benchmark::MICROSECOND);
+        registry.add("KdTreeFLANN::setInputCloud/batch:" + to_string(batch_size),
+                     [batch_size](BenchmarkState &state) { removePoints(state, batch_size, false); }).setUnit(Benchmark::MICROSECOND);
+    }
+
+    // Scaling of the parallel kernels and of the segmentation with the number of threads
+    for(int threads: getThreadCounts())
+    {
+        string suffix = "/threads:" + to_string(threads);
+        registry.add("NormalComputation::computeNormalCloud/kdtree" + suffix,
+                     [](BenchmarkState &state) { computeNormalCloud(state, NeighborSearch::KDTREE); }).setThreads(threads).setUnit(Benchmark::MILLISECOND);
+        registry.add("NormalComputation::computeNormalCloud/grid" + suffix,
+                     [](BenchmarkState &state) { computeNormalCloud(state, NeighborSearch::GRID); }).setThreads(threads).setUnit(Benchmark::MILLISECOND);
+        registry.add("NormalOrientation::orient" + suffix,
+                     [](BenchmarkState &state) { orientNormals(state, getScene); }).setThreads(threads).setUnit(Benchmark::MILLISECOND);
+        registry.add("NormalOrientation::orient/tile" + suffix,
+                     [](BenchmarkState &state) { orientNormals(state, getTile); }).setThreads(threads).setUnit(Benchmark::MILLISECOND);
+        registry.add("PlaneSegmentation::getMeanOfMinDistances" + suffix,
+                     [](BenchmarkState &state) { getMeanOfMinDistances(state, NeighborSearch::KDTREE); }).setThreads(threads).setUnit(Benchmark::MICROSECOND);
+        registry.add("PlaneSegmentation::getMeanOfMinDistances/grid" + suffix,
+                     [](BenchmarkState &state) { getMeanOfMinDistances(state, NeighborSearch::GRID); }).setThreads(threads).setUnit(Benchmark::MICROSECOND);
+        registry.add("PlaneSegmentation::getNeighborsOf/kdtree/frontier:16384" + suffix,
+                     [](BenchmarkState &state) { getNeighborsOf(state, 16384, false); }).setThreads(threads).setUnit(Benchmark::MICROSECOND);
+        registry.add("Plane::getPlaneTolerance" + suffix, getPlaneTolerance).setThreads(threads).setUnit(Benchmark::MICROSECOND);
+        registry.add("PlaneSegmentation::runMainLoop/seeds:1" + suffix,
+                     [](BenchmarkState &state) { segmentation(state, getScene, 1, -1); }).setThreads(threads).setUnit(Benchmark::MILLISECOND);
+        registry.add("PlaneSegmentation::runMainLoop/seeds:8" + suffix,
+                     [](BenchmarkState &state) { segmentation(state, getScene, 8, -1); }).setThreads(threads).setUnit(Benchmark::MILLISECOND);
+    }
+
+    // Cost of the log messages on a large tile, a single iteration each
+    registry.add("PlaneSegmentation::runMainLoop/tile/log:info",
+                 [](BenchmarkState &state) { segmentation(state, getTile, 1, PCA_LOG_INFO); }).setIterations(1).setUnit(Benchmark::MILLISECOND);
+    registry.add("PlaneSegmentation::runMainLoop/tile/log:trace",
+                 [](BenchmarkState &state) { segmentation(state, getTile, 1, PCA_LOG_TRACE); }).setIterations(1).setUnit(Benchmark::MILLISECOND);
+}
+
+static void printUsage()
+{
+    cout << "Usage: ./pca_bench [--scene-points N] [--tile-points N] [--seed S] [--noise sigma] [--max-threads T] [--benchmark_...]" << endl;
+    cout << "  --scene-points N  points of the roofs the kernels run on (" << options.scene_points << " by default)" << endl;
+    cout << "  --tile-points N   points of the tile segmented with INFO and TRACE messages (" << options.tile_points << " by default)" << endl;
+    cout << "  --seed S          seed of the procedural roofs and of the samples (" << options.seed << " by default)" << endl;
+    cout << "  --noise sigma     standard deviation of the noise along z, in meters (" << options.noise << " by default)" << endl;
+    cout << "  --max-threads T   largest number of threads of the scaling benchmarks (number of cores by default)" << endl;
+    BenchmarkRunner::printUsage(cout);
+}
+
+int main(int argc, char **argv)
+{
+    BenchmarkRunner runner;
+    if(!runner.parseFlags(argc, argv))
+    {
+        printUsage();
+        return EXIT_FAILURE;
+    }
+
+    for(int i = 1; i < argc; ++i)
+    {
+        string arg = argv[i];
+
+        if(arg == "--help" || arg == "-h")
+        {
+            printUsage();
+            return EXIT_SUCCESS;
+        }
+
+        if(i + 1 >= argc)
+        {
+            cerr << "Unknown or incomplete option " << arg << endl;
+            printUsage();
+            return EXIT_FAILURE;
+        }
+
+        stringstream value(argv[++i]);
+        bool valid = true;
+
+        if(arg == "--scene-points")
+        {
+            valid = static_cast<bool>(value >> options.scene_points) && options.scene_points > 0;
+        }
+        else if(arg == "--tile-points")
+        {
+            valid = static_cast<bool>(value >> options.tile_points) && options.tile_points > 0;
+        }
+        else if(arg == "--seed")
+        {
+            valid = static_cast<bool>(value >> options.seed);
+        }
+        else if(arg == "--noise")
+        {
+            valid = static_cast<bool>(value >> options.noise) && options.noise >= 0;
+        }
+        else if(arg == "--max-threads")
+        {
+            valid = static_cast<bool>(value >> options.max_threads) && options.max_threads > 0;
+        }
+        else
+        {
+            valid = false;
+        }
+
+        if(!valid)
+        {
+            cerr << "Invalid option " << arg << " " << argv[i] << endl;
+            printUsage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Only warnings and errors of the kernels are written among the results
+    Logging::setLevel(PCA_LOG_WARNING);
+
+    KernelBenchmarks::registerAll();
+
+    const char *log_levels[] = {"TRACE", "DEBUG", "INFO", "WARNING", "ERROR"};
+    runner.addContext("pca_min_log_level", string("\"") + log_levels[PCA_MIN_LOG_LEVEL] + "\"");
+#ifdef PCA_NO_PROFILING
+    runner.addContext("pca_profiling", "false");
+#else
+    runner.addContext("pca_profiling", "true");
+#endif
+    runner.addContext("scene_points", to_string(options.scene_points));
+    runner.addContext("tile_points", to_string(options.tile_points));
+    runner.addContext("seed", to_string(options.seed));
+    runner.addContext("noise", to_string(options.noise));
+
+    return runner.run(argv[0]);
+}
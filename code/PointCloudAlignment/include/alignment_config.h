@@ -0,0 +1,101 @@
+#pragma once
+
+#include <fstream>
+
+#include "common.h"
+
+/**
+ * @brief Tuning parameters of the segmentation, merging and registration, read at runtime instead of being fixed at
+ * compile time. Every parameter defaults to the macro of the same name in variables.h, documented there.
+ *
+ * A configuration file holds one "name = value" per line, names being the macro names in lower case (e.g.
+ * "max_normal_angle = 0.261799"), and # starting a comment. Angles are in radians. Parameters that are not given keep
+ * their default value. The classes using a configuration precompute what their hot paths need (cosines, squares) when it is set.
+ */
+struct AlignmentConfig
+{
+    /// Step of the pipeline that a parameter affects, as bit flags.
+    enum Stage
+    {
+        PREPROCESSING = 1,
+        CLOUD_SEGMENTATION = 2,
+        TILING = 4,
+        CLOUD_MERGING = 8,
+        MESH_SEGMENTATION = 16,
+        REGISTRATION = 32
+    };
+
+    // Preprocessing
+    float leaf_size = LEAF_SIZE;
+    int max_k_original = MAX_K_ORIGINAL;
+    int max_k_resampled = MAX_K_RESAMPLED;
+    int min_k = MIN_K;
+    int neighbor_search = NEIGHBOR_SEARCH;
+    int morton_order = MORTON_ORDER;
+    float max_curvature = MAX_CURVATURE;
+
+    // Plane segmentation of clouds
+    float max_normal_angle = MAX_NORMAL_ANGLE;
+    float plane_treshold = PLANE_TRESHOLD;
+    int phase1_iterations = PHASE1_ITERATIONS;
+    int min_stable_size = MIN_STABLE_SIZE;
+    int min_plane_size = MIN_PLANE_SIZE;
+    int max_iterations = MAX_ITERATIONS;
+    float min_seed_distance = MIN_SEED_DISTANCE;
+
+    // Tiled segmentation
+    float tile_size = TILE_SIZE;
+    float tile_halo = TILE_HALO;
+    float tile_stitch_band = TILE_STITCH_BAND;
+
+    // Plane merging of clouds
+    int knn = KNN;
+    float normal_error = NORMAL_ERROR;
+    float distance_error = DISTANCE_ERROR;
+    float overlap_angle = OVERLAP_ANGLE;
+
+    // Plane segmentation of meshes
+    int knn_mesh = KNN_MESH;
+    float mesh_normal_error = MESH_NORMAL_ERROR;
+    float v_error = V_ERROR;
+    float min_surface = MIN_SURFACE;
+
+    // Registration
+    float std_dev_mult = STD_DEV_MULT;
+    int center_knn = CENTER_KNN;
+    float surface_interval = SURFACE_INTERVAL;
+
+    /// Read the parameters given in a configuration file. Returns false if it can't be read or holds an invalid line.
+    bool load(string filename);
+    /// Set one parameter from its text value. Returns false if the name is unknown or the value is not a number.
+    bool set(string name, string value);
+    /// Set one parameter from a "name=value" argument, as given on the command line.
+    bool setArgument(string argument);
+    /// Check the parameters are consistent (positive sizes, k bounds in order...), printing the first problem found.
+    bool isValid() const;
+
+    /// Text value of a parameter, empty if the name is unknown.
+    string get(string name) const;
+    /// Stage affected by a parameter, 0 if the name is unknown.
+    static int getStage(string name);
+    /**
+     * @brief Values of the parameters affecting any of the given stages (or-ed Stage flags), in a string: two configurations
+     * give the same key if and only if these stages run with the same parameters, their results can then be reused.
+     */
+    string getKey(int stages) const;
+
+    /// Write every parameter in the format read by load.
+    void write(ostream &out) const;
+    bool save(string filename) const;
+
+private:
+    typedef struct _Parameter
+    {
+        const char *name;
+        Stage stage;
+        float AlignmentConfig::*p_float;
+        int AlignmentConfig::*p_int;
+    } Parameter;
+
+    static const vector<Parameter> &getParameters();
+};
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <fstream>
+
+#include "common.h"
+
+/**
+ * @brief Reads the point coordinates of a PLY or PCD file chunk by chunk, without ever loading the whole cloud in memory.
+ * Supported formats are ascii and binary_little_endian PLY, and ascii and binary PCD.
+ * Only the x, y and z fields are read, every other field is skipped.
+ */
+class CloudStreamReader
+{
+public:
+    /// Parse the header of the file. Returns false if the file can't be read or its format is not supported.
+    bool open(string filename);
+    void close();
+
+    /// Go back to the first point of the file.
+    bool rewind();
+
+    /**
+     * @brief Read the next points of the file, at most max_points of them.
+     * @return The number of points read, 0 once the end of the file is reached.
+     */
+    size_t read(vector<vec3> &points, size_t max_points);
+
+    size_t getNbPoints() const { return nb_points; }
+    /// True if the opened file declares a field of this name, e.g. "k" for preprocessed clouds.
+    bool hasField(string name) const;
+
+private:
+    typedef struct _Field
+    {
+        string name;
+        /// 'F' for floating point, 'I' for signed and 'U' for unsigned integers, as in PCD headers.
+        char type;
+        size_t size;
+        size_t count;
+    } Field;
+
+    ifstream file;
+    string filename;
+    bool is_binary = false;
+    size_t nb_points = 0;
+    size_t nb_read = 0;
+    streampos data_start;
+
+    vector<Field> fields;
+    /// Size in bytes of a point in binary files.
+    size_t record_size = 0;
+    /// Byte offset (binary) or column (ascii) of the x, y and z fields.
+    size_t offsets[3];
+    size_t columns[3];
+    size_t nb_columns = 0;
+    Field xyz_fields[3];
+
+    bool parsePLYHeader();
+    bool parsePCDHeader();
+    bool findCoordinates();
+    static bool parsePLYType(string type, Field &field);
+    static double decode(const char *data, const Field &field);
+};
@@ -6,6 +6,7 @@
 #include <Eigen/QR>
 
 #include "variables.h"
+#include "logging.h"
 #include "point_normal_k.h"
 
 using namespace std;
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+
+using namespace std;
+
+#define PCA_LOG_TRACE 0
+#define PCA_LOG_DEBUG 1
+#define PCA_LOG_INFO 2
+#define PCA_LOG_WARNING 3
+#define PCA_LOG_ERROR 4
+
+/// Messages below this level are not compiled at all, cmake -DPCA_MIN_LOG_LEVEL=TRACE keeps every message.
+#ifndef PCA_MIN_LOG_LEVEL
+#define PCA_MIN_LOG_LEVEL PCA_LOG_DEBUG
+#endif
+
+/**
+ * @brief Leveled logging of the pipeline. TRACE is used for every region growing iteration, DEBUG for every plane,
+ * INFO for every stage, WARNING and ERROR for inputs that are ignored or can't be processed.
+ *
+ * A message is written if its level is at least the runtime level (INFO by default). Messages below PCA_MIN_LOG_LEVEL
+ * are removed by the compiler, their arguments are never evaluated. Each message is formatted in its own buffer and
+ * written to cout at once, so that lines of concurrent threads are not interleaved. Only warnings and errors flush.
+ */
+class Logging
+{
+public:
+    static void setLevel(int level) { Logging::level.store(level, memory_order_relaxed); }
+    static int getLevel() { return level.load(memory_order_relaxed); }
+    static bool isEnabled(int level) { return level >= getLevel(); }
+
+    /// Level of its name (trace, debug, info, warning or error), -1 if the name is unknown.
+    static int parseLevel(string name);
+
+    /// One message, written when destroyed.
+    class Line
+    {
+    public:
+        Line(int level): level(level) {}
+        ~Line();
+
+        ostringstream &stream() { return ss; }
+
+    private:
+        int level;
+        ostringstream ss;
+    };
+
+private:
+    static atomic<int> level;
+    static mutex output_mutex;
+};
+
+/// Stream a message of the given level (TRACE, DEBUG, INFO, WARNING or ERROR), without endl: LOG(DEBUG) << "Plane " << id;
+#define LOG(level) \
+    if(PCA_LOG_##level < PCA_MIN_LOG_LEVEL || !Logging::isEnabled(PCA_LOG_##level)) {} \
+    else Logging::Line(PCA_LOG_##level).stream()
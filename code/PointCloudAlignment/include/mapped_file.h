@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+
+#include <boost/shared_ptr.hpp>
+
+using namespace std;
+
+/**
+ * @brief Read only file mapped in memory, unmapped when destroyed. Pages are privately writable:
+ * writes are seen by this process only and never reach the file.
+ */
+class MappedFile
+{
+public:
+    typedef boost::shared_ptr<MappedFile> Ptr;
+
+    MappedFile() {}
+    MappedFile(const MappedFile&) = delete;
+    MappedFile &operator=(const MappedFile&) = delete;
+    ~MappedFile() { close(); }
+
+    bool open(string filename);
+    void close();
+
+    char *getData() { return data; }
+    size_t getSize() const { return size; }
+
+private:
+    char *data = nullptr;
+    size_t size = 0;
+};
@@ -8,7 +8,11 @@
 #include <pcl/io/vtk_lib_io.h>
 
 #include "common.h"
+#include "alignment_config.h"
 #include "segmented_points_container.h"
+#include "neighbor_search.h"
+#include "normal_orientation.h"
+#include "profiler.h"
 
 class MeshSegmentation {
 public:
@@ -25,7 +29,11 @@ public:
 
     void updateColors(SegmentedPointsContainer::SegmentedPlane p, ivec3 color);
 
+    /// Parameters of the merging of the faces, the default configuration if not set.
+    void setConfig(const AlignmentConfig &config) { this->config = config; }
+
 private:
+    AlignmentConfig config;
     pcl::PolygonMeshPtr p_mesh;
     pcl::PointCloud<pcl::PointXYZRGB>::Ptr p_cloud;
     pcl::PointCloud<pcl::PointXYZ>::Ptr p_centroid_cloud;
@@ -34,6 +42,8 @@ private:
     boost::shared_ptr<vector<int>> p_available_indices;
     bool isSegmented = false;
 
+    /// Faces are wound either way, their normals are oriented over the k nearest neighbors graph of their centroids.
+    void orientPlanes();
     void mergeRecursive();
     bool planesAreMergeable(SegmentedPointsContainer::SegmentedPlane &p1, SegmentedPointsContainer::SegmentedPlane &p2);
     bool haveCommonVertex(SegmentedPointsContainer::SegmentedPlane &p1, SegmentedPointsContainer::SegmentedPlane &p2);
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <fstream>
+
+#include "common.h"
+#include "mapped_file.h"
+
+/**
+ * @brief k nearest neighbors of every point of a cloud, in compressed sparse row layout: the neighbors of point i are
+ * stored from offsets[i] to offsets[i + 1], optionally along with their squared distances.
+ *
+ * It is filled by NormalComputation with the k estimated for each point, sorted by increasing distance, then made
+ * symmetric. It is read by the region growing instead of querying the search tree again. Since it only holds indices, it stays valid when the cloud is rigidly transformed
+ * and can be saved next to the preprocessed cloud file (see getSidecarPath).
+ */
+class NeighborGraph
+{
+public:
+    typedef boost::shared_ptr<NeighborGraph> Ptr;
+
+    NeighborGraph(bool keep_distances = false): keep_distances(keep_distances) {}
+
+    /// Allocate one row of k neighbors per point of the cloud, k being the one of the point (bounded by the cloud size).
+    void allocate(const PointNormalKCloud &cloud);
+    /// Fill the row of point i, indices must contain as many neighbors as allocated for it.
+    void setRow(size_t i, const vector<int> &indices, const vector<float> &sqr_distances);
+    /**
+     * @brief Append to every row the points having it among their neighbors, after its own neighbors.
+     * A point that is not among the k nearest neighbors of any of its own neighbors can then still be reached.
+     */
+    void makeSymmetric();
+
+    /// Renumber the points after the cloud was reordered: point i of the new cloud is the point order[i] of the old one.
+    void permute(const vector<int> &order);
+    void clear();
+
+    size_t size() const { return offsets.empty() ? 0 : offsets.size() - 1; }
+    size_t getNbEdges() const { return neighbors.size(); }
+    bool hasDistances() const { return !sqr_distances.empty(); }
+
+    const int *rowBegin(size_t i) const { return neighbors.data() + offsets[i]; }
+    const int *rowEnd(size_t i) const { return neighbors.data() + offsets[i + 1]; }
+    const float *distancesBegin(size_t i) const { return sqr_distances.data() + offsets[i]; }
+
+    /// Binary file: header (magic, version, flags, number of points and of edges) followed by the arrays.
+    bool save(string filename) const;
+    /// Returns false, leaving the graph empty, if the file is missing or not a valid neighbor graph.
+    bool load(string filename);
+
+    /// Write the graph as in a file saved by save.
+    void write(ostream &out) const;
+    /// Read a graph from the content of a file saved by save, e.g. mapped in memory. The arrays are copied.
+    bool read(const char *data, size_t size, string name);
+
+    /// Path of the graph saved along with the given cloud file.
+    static string getSidecarPath(string cloud_file) { return cloud_file + ".knn"; }
+
+private:
+    static constexpr char MAGIC[8] = {'P', 'C', 'A', 'K', 'N', 'N', '\0', '\0'};
+    static constexpr uint32_t VERSION = 1;
+    static constexpr uint32_t HAS_DISTANCES = 1;
+
+    bool keep_distances;
+    vector<uint64_t> offsets;
+    vector<int> neighbors;
+    vector<float> sqr_distances;
+};
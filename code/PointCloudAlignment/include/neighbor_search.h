@@ -0,0 +1,84 @@
+#pragma once
+
+#include <limits>
+#include <numeric>
+
+#include "common.h"
+#include "profiler.h"
+
+/**
+ * @brief k nearest neighbors search over the points of a cloud. The backend, FLANN kdtree or XY grid, is chosen at
+ * runtime by AlignmentConfig::neighbor_search. Searches can safely be run from several threads.
+ */
+class NeighborSearch
+{
+public:
+    typedef boost::shared_ptr<NeighborSearch> Ptr;
+
+    enum Backend { KDTREE = 0, GRID = 1 };
+
+    virtual ~NeighborSearch() {}
+
+    /// New search of the given backend, the kdtree if it is unknown.
+    static Ptr create(int backend);
+
+    /// Index the given points of the cloud, every point if indices is null.
+    virtual void setInputCloud(PointNormalKCloud::Ptr cloud, boost::shared_ptr<vector<int>> indices = nullptr) = 0;
+
+    /**
+     * @brief Search the k nearest indexed points of p, sorted by increasing distance.
+     * @return The number of neighbors found, less than k only if fewer points are indexed.
+     */
+    virtual int nearestKSearch(const PointNormalK &p, int k, vector<int> &k_indices, vector<float> &k_sqr_distances) const = 0;
+};
+
+class KdTreeSearch : public NeighborSearch
+{
+public:
+    KdTreeSearch(): p_kdtree(new KdTreeFlannK) {}
+
+    void setInputCloud(PointNormalKCloud::Ptr cloud, boost::shared_ptr<vector<int>> indices = nullptr);
+    int nearestKSearch(const PointNormalK &p, int k, vector<int> &k_indices, vector<float> &k_sqr_distances) const;
+
+private:
+    KdTreeFlannK::Ptr p_kdtree;
+};
+
+/**
+ * @brief Uniform grid over XY, tuned for aerial scans: they are 2.5D, each column of the grid only holds the few
+ * points of a roof or of the ground. The cell size is chosen so that a cell holds points_per_cell points on average,
+ * the points are sorted by cell and stored next to each other.
+ *
+ * A search scans the rings of cells around the one of p, nearest first, and stops as soon as the next ring can't hold
+ * any point closer than the k-th found. Clouds with many points along z (walls, facades, vegetation) make it slower
+ * than the kdtree, never wrong.
+ */
+class GridSearch : public NeighborSearch
+{
+public:
+    GridSearch(float points_per_cell = 4): points_per_cell(points_per_cell) {}
+
+    void setInputCloud(PointNormalKCloud::Ptr cloud, boost::shared_ptr<vector<int>> indices = nullptr);
+    int nearestKSearch(const PointNormalK &p, int k, vector<int> &k_indices, vector<float> &k_sqr_distances) const;
+
+    float getCellSize() const { return cell_size; }
+
+private:
+    typedef struct _GridPoint
+    {
+        float x, y, z;
+        int index;
+    } GridPoint;
+
+    float points_per_cell;
+    float cell_size = 1;
+    vec2 origin;
+    int nb_cols = 0;
+    int nb_rows = 0;
+    /// Points of cell c are points[cell_starts[c]] to points[cell_starts[c + 1] - 1], cells are stored row by row.
+    vector<uint32_t> cell_starts;
+    vector<GridPoint> points;
+
+    int getCol(float x) const;
+    int getRow(float y) const;
+};
@@ -5,13 +5,35 @@
 #include <pcl/features/normal_3d_omp.h>
 
 #include "common.h"
+#include "alignment_config.h"
 #include "plane.h"
+#include "neighbor_graph.h"
+#include "neighbor_search.h"
+#include "normal_orientation.h"
+#include "profiler.h"
 
 class NormalComputation {
 public:
-    void computeNormalCloud(PointNormalKCloud::Ptr cloud_in, KdTreeFlannK::Ptr kdTree_in, bool isResampled);
+    /// Bounds on k, the default configuration if not set.
+    void setConfig(const AlignmentConfig &config) { this->config = config; }
+
+    /**
+     * @brief Compute the k, normal and curvature of every point, then orient the normals consistently over the k nearest
+     * neighbors graph (see NormalOrientation). If p_graph is given, it is filled with that graph, so that the segmentation
+     * does not have to search the neighbors again.
+     */
+    void computeNormalCloud(PointNormalKCloud::Ptr cloud_in, NeighborSearch::Ptr p_search, bool isResampled, NeighborGraph::Ptr p_graph = nullptr);
 
 private:
-    int estimateKForPoint(int p_id, PointNormalKCloud::Ptr cloud_in, KdTreeFlannK::Ptr kdTree, bool isResampled, float &curv);
-    float computeCurvature(PointNormalKCloud::Ptr cloud, boost::shared_ptr<vector<int>> indices, vector<float> sqrd_distances, PointNormalK p);
+    /// The private kernels are timed by pca_bench.
+    friend class KernelBenchmarks;
+
+    AlignmentConfig config;
+
+    /**
+     * @brief Every k tried is a prefix of the max_k nearest neighbors of the point, which are searched only once. The
+     * planes and mean distances of the prefixes are read from the moments of the neighbors, computed once as well.
+     */
+    int estimateKForPoint(int p_id, PointNormalKCloud::Ptr cloud_in, const NeighborhoodMoments &moments, vector<float> &nn_sqrd_distances, int max_k, float &curv);
+    float computeCurvature(const NeighborhoodMoments &moments, size_t k, PointNormalK p);
 };
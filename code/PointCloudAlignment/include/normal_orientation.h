@@ -0,0 +1,48 @@
+#pragma once
+
+#include <omp.h>
+
+#include "common.h"
+#include "neighbor_graph.h"
+#include "profiler.h"
+
+/**
+ * @brief Consistent orientation of the normals of a cloud, propagated over its k nearest neighbors graph.
+ *
+ * Neighbors on a smooth surface have normals pointing the same way. As in Hoppe et al., the orientation is propagated along
+ * a minimum spanning tree of the graph weighted by 1 - |ni.nj|, so that it only crosses sharp edges where no smoother path
+ * exists. The tree is built as by Kruskal: the edges are bucket sorted by weight in parallel, then join the components of a
+ * union-find that keeps, for every point, whether its normal is flipped relative to the root of its component. Each connected
+ * component is finally oriented so that its normals point toward the reference direction on average.
+ *
+ * The normals of the points of a plane then agree in sign, comparing them to the normal of the plane needs a single test.
+ */
+class NormalOrientation
+{
+public:
+    /// Direction the connected components are oriented towards, (1, 1, 1) by default.
+    void setReference(vec3 reference) { this->reference = reference.normalized(); }
+
+    /// Flip the normals of the cloud so that they agree over the graph, which must be symmetric and of the size of the cloud.
+    void orient(PointNormalKCloud &cloud, const NeighborGraph &graph) const;
+
+private:
+    /// The private kernels are timed by pca_bench.
+    friend class KernelBenchmarks;
+
+    typedef struct _Edge
+    {
+        int i;
+        int j;
+        /// True if the normals of i and j point opposite ways.
+        bool is_opposite;
+    } Edge;
+
+    /// Edges are sorted in this many buckets of weight, the edges of a bucket keep the order of their points.
+    static const int NB_BUCKETS = 1024;
+
+    vec3 reference = vec3(1, 1, 1).normalized();
+
+    /// Edges of the graph, each once, by increasing weight.
+    void sortEdges(const PointNormalKCloud &cloud, const NeighborGraph &graph, vector<Edge> &edges) const;
+};
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <fstream>
+
+#include <Eigen/StdVector>
+
+#include "common.h"
+#include "alignment_config.h"
+#include "test_set.h"
+
+/**
+ * @brief Grid of parameter values to align the testing sets with, one configuration per combination of values.
+ *
+ * A grid file holds one "name = value, value, ..." per line, names being the ones of AlignmentConfig, and # starting
+ * a comment. Parameters that are not given keep the value of the base configuration. The test sets being already
+ * preprocessed, only the segmentation, merging and registration parameters have an effect.
+ */
+class ParameterSweep
+{
+public:
+    /// Read a grid file. Returns false if it can't be read, or holds an unknown parameter or an invalid value.
+    bool load(string filename);
+    /// Add a parameter to the grid, with the values it takes. Returns false if the name or one of the values is invalid.
+    bool addParameter(string name, const vector<string> &values);
+
+    size_t getNbConfigs() const;
+    /// Every combination of the values of the grid applied on the base configuration, the first parameter varying the slowest.
+    vector<AlignmentConfig> getConfigs(const AlignmentConfig &base) const;
+
+    /**
+     * @brief Write one row per run: its configuration, alignment errors and the time of each stage. The table is written
+     * in JSON if the file name ends with .json, in CSV otherwise.
+     */
+    bool writeTable(string filename, const vector<AlignmentConfig> &configs, const vector<SweepRun, Eigen::aligned_allocator<SweepRun>> &runs) const;
+
+private:
+    vector<pair<string, vector<string>>> parameters;
+
+    void writeCSV(ostream &out, const vector<AlignmentConfig> &configs, const vector<SweepRun, Eigen::aligned_allocator<SweepRun>> &runs) const;
+    void writeJSON(ostream &out, const vector<AlignmentConfig> &configs, const vector<SweepRun, Eigen::aligned_allocator<SweepRun>> &runs) const;
+};
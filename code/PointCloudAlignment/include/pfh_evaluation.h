@@ -6,6 +6,7 @@
 
 #include "common.h"
 #include "segmented_points_container.h"
+#include "profiler.h"
 
 typedef pcl::PointCloud<pcl::PointNormal> PointNormalCloud;
 typedef pcl::PointNormal PointNormal;
@@ -18,9 +19,10 @@ public:
     PFHEvaluation(){}
     ~PFHEvaluation(){}
 
-    static bool isValidPlane(PointNormalKCloud::Ptr points, vector<int> &indices_in);
+    /// The points are on a plane if the 62nd bin of their PFH histogram exceeds plane_treshold.
+    static bool isValidPlane(PointNormalKCloud::Ptr points, vector<int> &indices_in, float plane_treshold = PLANE_TRESHOLD);
 
-    static PFHCloud computePFHSignatures(vector<SegmentedPointsContainer::SegmentedPlane> &l_planes);
+    static PFHCloud computePFHSignatures(vector<SegmentedPointsContainer::SegmentedPlane> &l_planes, int center_knn = CENTER_KNN);
 
     static void computeFPFHSignature(PointNormalCloud::Ptr p_cloud,
                                      pcl::search::KdTree<PointNormal>::Ptr p_kdTree,
@@ -33,8 +35,10 @@ public:
 
     static size_t getMinTarget(size_t i, PFHCloud source_signs, PFHCloud target_signs, float &out_error);
 
+    /// Target plane of least feature error among the ones whose surface differs from s_surf by less than surface_interval, -1 if none.
     template<int N>
-    static int getMinTarget(size_t i, float s_surf, vector<float> &t_surfs, FeatureCloud<N> &source_signs, FeatureCloud<N> &target_signs, float &out_error);
+    static int getMinTarget(size_t i, float s_surf, vector<float> &t_surfs, FeatureCloud<N> &source_signs, FeatureCloud<N> &target_signs, float &out_error,
+                            float surface_interval = SURFACE_INTERVAL);
 
     template<int N>
     static float computeFeatureError(size_t s_id, size_t t_id, FeatureCloud<N> &source_signs, FeatureCloud<N> &target_signs);
@@ -56,7 +60,8 @@ private:
 // IMPLEMENTATIONS OF TEMPLATE FUNCTIONS
 
 template<int N>
-int PFHEvaluation::getMinTarget(size_t i, float s_surf, vector<float> &t_surfs, FeatureCloud<N> &source_signs, FeatureCloud<N> &target_signs, float &out_error)
+int PFHEvaluation::getMinTarget(size_t i, float s_surf, vector<float> &t_surfs, FeatureCloud<N> &source_signs, FeatureCloud<N> &target_signs, float &out_error,
+                                float surface_interval)
 {
     int j = -1;
     float min_error = numeric_limits<float>::infinity();
@@ -65,7 +70,7 @@ int PFHEvaluation::getMinTarget(size_t i, float s_surf, vector<float> &t_surfs,
     vector<size_t> target_indices;
     for(size_t t_id = 0; t_id < t_surfs.size(); ++t_id)
     {
-        if(abs(s_surf - t_surfs[t_id]) < SURFACE_INTERVAL)
+        if(abs(s_surf - t_surfs[t_id]) < surface_interval)
         {
             target_indices.push_back(t_id);
         }
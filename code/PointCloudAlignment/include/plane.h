@@ -8,6 +8,7 @@
 #include <pcl/ModelCoefficients.h>
 
 #include "common.h"
+#include "point_cloud_soa.h"
 
 class Plane;
 
@@ -26,6 +27,8 @@ public:
     vec3 getNormal();
     vec3 getNormalizedN();
     void setNormal(vec3 n);
+    /// Flip the plane if its normal points away from direction. Normals are oriented, they are compared to it without flipping.
+    void orientAlong(vec3 direction);
     pcl::ModelCoefficients getModelCoefficients();
     float getPlaneTolerance(PointNormalKCloud::Ptr cloud, boost::shared_ptr<vector<int>> indices);
 
@@ -35,8 +38,21 @@ public:
 
     bool pointInPlane(PointNormalK p, float epsilon);
     bool normalInPlane(PointNormalK p, float max_angle);
+    bool pointInPlane(const PointCloudSoA &cloud, int index, float epsilon);
+    bool normalInPlane(const PointCloudSoA &cloud, int index, float max_angle);
 
+    /**
+     * @brief Batch version of pointInPlane: append to accepted the indices of the points closer than epsilon to the plane,
+     * in the order of indices. The plane normal is normalized once, and the points are tested in blocks by a vectorizable loop.
+     */
+    void filterPointsInPlane(const PointCloudSoA &cloud, const vector<int> &indices, float epsilon, vector<int> &accepted);
+    /// Same as above, also requiring normalInPlane for the max angle of cosine cos_max_angle, no acos is computed.
+    void filterPointsInPlane(const PointCloudSoA &cloud, const vector<int> &indices, float epsilon, float cos_max_angle, vector<int> &accepted);
+
+    /// Least squares plane through the given points, centered on their centroid. Does not allocate.
     static void estimatePlane(PointNormalKCloud::Ptr cloud_in, boost::shared_ptr<vector<int> > indices_in, Plane &plane);
+    /// Same as above, reading the points from the SoA copy of the cloud.
+    static void estimatePlane(const PointCloudSoA &cloud, const vector<int> &indices, Plane &plane);
 
 private:
     float a, b, c, d;
@@ -44,3 +60,64 @@ private:
     vec3 n;
 };
 
+/**
+ * @brief Running sums over the points of a growing plane: count, sum of p and of p.p^T, and the sums of the distances
+ * of the points to the plane they were accepted with. Points are only ever added, refitting the plane is O(1)
+ * and updating its tolerance is O(new points).
+ *
+ * Coordinates are accumulated in double relative to an origin chosen close to the points (the region growing seed),
+ * so that the one pass covariance does not lose precision on georeferenced coordinates.
+ */
+class PlaneMoments
+{
+public:
+    PlaneMoments() { reset(vec3(0, 0, 0)); }
+
+    void reset(vec3 origin);
+    void addPoints(const PointCloudSoA &cloud, const vector<int> &indices);
+    /// Add the distances of the points to the plane to the tolerance sums.
+    void addDistances(const PointCloudSoA &cloud, const vector<int> &indices, Plane &plane);
+
+    /// Least squares plane through every added point, same result as Plane::estimatePlane.
+    void fitPlane(Plane &plane) const;
+    /// Mean plus three standard deviations of the added distances, as Plane::getPlaneTolerance.
+    float getTolerance() const;
+
+    size_t getNbPoints() const { return nb_points; }
+
+private:
+    vec3d origin;
+    size_t nb_points;
+    vec3d sum;
+    Eigen::Matrix3d sum_squares;
+    size_t nb_distances;
+    double sum_distances;
+    double sum_squared_distances;
+};
+
+/**
+ * @brief Prefix sums of the moments of the neighbors of a point, in their order of distance. The plane through the
+ * first k neighbors and their mean distance to the point are then O(1) to get for any k, without refitting.
+ *
+ * Coordinates are accumulated in double relative to the point, as in PlaneMoments.
+ */
+class NeighborhoodMoments
+{
+public:
+    /// Accumulate the neighbors given by their indices and squared distances to origin. Buffers are reused between calls.
+    void compute(const PointNormalKCloud &cloud, const vector<int> &indices, const vector<float> &sqrd_distances, vec3 origin);
+
+    /// Least squares plane through the first k neighbors, same result as Plane::estimatePlane on them.
+    void fitPlane(size_t k, Plane &plane) const;
+    /// Mean distance of the first k neighbors to the origin.
+    float getMeanDistance(size_t k) const { return static_cast<float>(sum_distances[k] / static_cast<double>(k)); }
+
+    size_t getNbPoints() const { return sums.size() - 1; }
+
+private:
+    vec3d origin;
+    /// Element i is the sum over the first i neighbors, the first one is 0.
+    vector<vec3d> sums;
+    vector<Eigen::Matrix3d> sum_squares;
+    vector<double> sum_distances;
+};
@@ -1,7 +1,9 @@
 #pragma once
 
 #include "common.h"
+#include "alignment_config.h"
 #include "segmented_points_container.h"
+#include "profiler.h"
 
 class PlaneMerging {
 public:
@@ -9,6 +11,12 @@ public:
     void start_merge(vector<SegmentedPointsContainer::SegmentedPlane> &p_list, PointNormalKCloud::Ptr p_cloud);
     void filter_small_planes(vector<SegmentedPointsContainer::SegmentedPlane> &p_list, int min_size);
 
+    /// Parameters of the merging, the default configuration if not set.
+    void setConfig(const AlignmentConfig &config);
+
+    /// Normal criterion of the merging: the normals, whatever their orientation, differ by at most the angle of cosine cos_max_angle.
+    static bool haveSimilarNormals(Plane &p1, Plane &p2, float cos_max_angle);
+
     vector<SegmentedPointsContainer::SegmentedPlane> getSegmentedPlanes();
     bool isCloudMerged();
 
@@ -17,6 +25,14 @@ public:
     void printVectorsInFile(string filename);
 
 private:
+    /// The private kernels are timed by pca_bench.
+    friend class KernelBenchmarks;
+
+    AlignmentConfig config;
+    /// Angles of config compared through their cosines.
+    float cos_normal_error = std::cos(NORMAL_ERROR);
+    float cos_overlap_angle = std::cos(OVERLAP_ANGLE);
+
     vector<SegmentedPointsContainer::SegmentedPlane> plane_list;
 
     /**
@@ -28,6 +44,8 @@ private:
     boost::shared_ptr<vector<int>> p_plane_indices;
     pcl::KdTreeFLANN<pcl::PointXYZ>::Ptr p_kdtree;
     PointNormalKCloud::Ptr p_point_cloud;
+    /// Coordinates of p_point_cloud read by the overlap tests.
+    PointCloudSoA::Ptr p_point_soa;
     vector<int> merged_planes_indices;
     bool isMerged = false;
     bool isSource = true;
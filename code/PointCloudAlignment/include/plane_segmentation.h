@@ -1,25 +1,42 @@
 #pragma once
 
+#include <atomic>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <queue>
 
 #include <pcl/io/ply_io.h>
 #include <pcl/io/pcd_io.h>
 #include <pcl/features/pfh.h>
 #include <pcl/filters/filter_indices.h>
-#include <pcl/filters/voxel_grid.h>
 
 #include <omp.h>
 
 #include "common.h"
 #include "normal_computation.h"
+#include "alignment_config.h"
+#include "neighbor_graph.h"
+#include "preprocessed_cloud_file.h"
+#include "preprocessing_cache.h"
 #include "segmented_points_container.h"
 #include "pfh_evaluation.h"
+#include "tombstone_kdtree.h"
+#include "point_cloud_soa.h"
+#include "voxel_grid_resampler.h"
+#include "profiler.h"
 
 
 class PlaneSegmentation {
 public:
     int init(PointNormalKCloud::Ptr p_object, bool isSource);
     int init(string cloud_file, bool isSource = true);
+    /**
+     * @brief Load a cloud resampled on a voxel grid of the resampling leaf size. Raw PLY and PCD files are streamed through
+     * the grid, the whole cloud is never loaded. Preprocessed clouds are loaded as by init and are not resampled.
+     */
+    int initResampled(string cloud_file, bool isSource = true);
 
     void resetSegmentation() { this->isSegmented = false; }
     void preprocessCloud();
@@ -35,6 +52,13 @@ public:
 
     void runMainLoop();
 
+    /**
+     * @brief Set the number of seeds grown concurrently by runMainLoop. Seeds are chosen at least min_seed_distance
+     * apart, the points contested by several planes go to the one that claimed them first, then to the seed of lowest curvature.
+     * The result does not depend on the number of threads. 1 (default) is the serial region growing.
+     */
+    void setNbParallelSeeds(int nb_seeds);
+
     void runOneStep();
 
     void stop();
@@ -42,16 +66,45 @@ public:
     void filterOutCurvature(float max_curvature);
 
     void resampleCloud();
+    /// Leaf size of the voxel grid used by resampleCloud and initResampled, leaf_size of the configuration by default.
+    void setResampleLeafSize(float leaf_size) { this->config.leaf_size = leaf_size; }
+
+    /**
+     * @brief Sort the points along a Morton (Z-order) curve, points close in space are then close in memory and the
+     * normal computation and region growing read mostly cache-local points. Called by preprocessCloud, after resampleCloud,
+     * if morton_order is set. Must be called before any point is excluded.
+     */
+    void reorderCloud();
+    bool isReordered() const { return !original_indices.empty(); }
+    /// Index, in the cloud given to init or resampled, of every point of the reordered cloud. Empty if it was not reordered.
+    const vector<int> &getOriginalIndices() const { return this->original_indices; }
+    /// Points of the cloud, with their plane ids, in the order of the cloud given to init or resampled.
+    PointNormalKCloud::Ptr getPointCloudInOriginalOrder();
+
+    /// Parameters of the preprocessing and region growing, the default configuration if not set.
+    void setConfig(const AlignmentConfig &config);
+    const AlignmentConfig &getConfig() const { return this->config; }
 
     PointNormalKCloud::Ptr getPointCloud() { return this->p_cloud; }
-    KdTreeFlannK::Ptr getKdTree() { return this->p_kdtree; }
+    TombstoneKdTree::Ptr getKdTree() { return this->p_kdtree; }
     PointNormalKCloud::Ptr getAvailablePointCloud();
     PointNormalKCloud::Ptr getExcludedPointCloud();
     vector<SegmentedPointsContainer::SegmentedPlane> getSegmentedPlanes() { return p_segmented_points_container->getPlanes(); }
 
-    void setPointCloud(PointNormalKCloud::Ptr p_new_cloud) { this->p_cloud = p_new_cloud; }
+    void setPointCloud(PointNormalKCloud::Ptr p_new_cloud) { this->p_cloud = p_new_cloud; this->is_soa_built = false; this->p_graph.reset(); this->original_indices.clear(); }
+
+    /**
+     * @brief k nearest neighbors graph of the cloud, built by preprocessCloud or loaded by init from the sidecar file
+     * of the cloud. The region growing reads it instead of searching the kdtree. Null if not available.
+     */
+    NeighborGraph::Ptr getNeighborGraph() { return this->p_graph; }
+    /// Use a graph built for the same cloud, e.g. kept from its preprocessing. Ignored if its size does not match the cloud.
+    void setNeighborGraph(NeighborGraph::Ptr p_graph);
 
 private:
+    /// The private kernels are timed by pca_bench.
+    friend class KernelBenchmarks;
+
     /**
      * @brief The algo_RunProperties struct encapsulates
      * all variables kept during the region growing phase.
@@ -64,6 +117,10 @@ private:
         boost::shared_ptr<vector<int>> p_nghbrs_indices;
         boost::shared_ptr<vector<int>> p_new_points_indices;
         Plane plane;
+        /// Sums over p_nghbrs_indices, the plane and epsilon are refreshed from them at every step.
+        PlaneMoments moments;
+        /// Rank of the run among the planes grown concurrently, 0 for the serial region growing.
+        int rank;
         int iteration;
         int plane_nb;
         size_t prev_size;
@@ -72,13 +129,38 @@ private:
 
         _RunProperties(): p_index(0), p_nghbrs_indices(new vector<int>(0)),
                             p_new_points_indices(new vector<int>(0)),
-                            iteration(0), plane_nb(0), prev_size(0),
+                            rank(0), iteration(0), plane_nb(0), prev_size(0),
                             max_search_distance(0), epsilon(0) {}
 
         void setupNextPlane(int index, PointNormalK &p, ivec3 color, int plane_id);
-        void addToNeighborhood(vector<int> &new_points);
+        void addToNeighborhood(vector<int> &new_points, const AlignmentConfig &config);
     } RunProperties;
 
+    /**
+     * @brief Deduplication of the candidates gathered around a region growing frontier, without sorting them.
+     * During a gathering, every point keeps the smallest position in the frontier of the points that reached it,
+     * stamped with a base that grows at every gathering so that the stamps never have to be cleared.
+     */
+    class FrontierStamps
+    {
+    public:
+        /// Start a new gathering over a cloud of nb_points, from a frontier of the given size.
+        void begin(size_t nb_points, size_t frontier_size);
+        /// Record that the frontier point at the given position reached the point. Thread safe.
+        void visit(int index, uint32_t position);
+        /// Once every visit is done, true if position is the first one of the frontier that reached the point.
+        bool isFirstVisit(int index, uint32_t position) const { return p_stamps[index].load(memory_order_relaxed) == base + position; }
+
+    private:
+        unique_ptr<atomic<uint32_t>[]> p_stamps;
+        size_t size = 0;
+        uint32_t base = 0;
+        uint32_t next_base = 1;
+    };
+
+    /// Outcome of one region growing step.
+    enum GrowthStatus { GROWING, INVALID_PLANE, SHRINKED, FINISHED };
+
     bool isSource = true;
     bool is_plane_initialized = false;
     bool isResampled = false;
@@ -87,6 +169,11 @@ private:
     bool isSegmented = false;
     bool dont_quit = true;
 
+    AlignmentConfig config;
+    /// Thresholds of config as compared by the region growing.
+    float cos_max_normal_angle = std::cos(MAX_NORMAL_ANGLE);
+    float sqr_min_seed_distance = MIN_SEED_DISTANCE * MIN_SEED_DISTANCE;
+
     float safety_distance;
     float curv_bound;
 
@@ -98,27 +185,83 @@ private:
     function<void(void)> update_normal_cloud_callable;
 
     PointNormalKCloud::Ptr p_cloud;
-    KdTreeFlannK::Ptr p_kdtree;
+    /// Copy of p_cloud read by the region growing loops, built when the segmentation starts.
+    PointCloudSoA::Ptr p_soa;
+    bool is_soa_built = false;
+    /// Search structure containing only the points available for segmentation.
+    TombstoneKdTree::Ptr p_kdtree;
+    /// k nearest neighbors of every point of p_cloud, dead or alive. Null if the cloud was preprocessed elsewhere.
+    NeighborGraph::Ptr p_graph;
 
-    boost::shared_ptr<vector<int>> p_indices;
     boost::shared_ptr<vector<int>> p_excluded_indices;
+    /// Permutation applied by reorderCloud, see getOriginalIndices.
+    vector<int> original_indices;
+
+    /**
+     * @brief Min-heap of (curvature, point index) pairs used to select the region growing start location.
+     * It is built once after preprocessing, points removed from the search are lazily popped when they reach the top.
+     */
+    typedef pair<float, int> SeedCandidate;
+    priority_queue<SeedCandidate, vector<SeedCandidate>, greater<SeedCandidate>> seed_queue;
+    bool is_seed_queue_built = false;
+
+    int nb_parallel_seeds = 1;
+
+    /**
+     * @brief Per point claims of the planes grown concurrently, UNCLAIMED outside of parallel region growing.
+     * A claim is the key step * nb_runs + rank (see getClaimKey), the smallest key owns the point.
+     */
+    static constexpr int64_t UNCLAIMED = numeric_limits<int64_t>::max();
+    unique_ptr<atomic<int64_t>[]> p_point_claims;
+    size_t point_claims_size = 0;
+    /// Candidates deduplication of each run, by rank.
+    vector<FrontierStamps> frontier_stamps;
 
     void callDisplayCallback(PointNormalKCloud::Ptr p_cloud, ivec3 c, vector<int> indices, bool isSource);
 
-    float getMeanOfMinDistances();
+    float getMeanOfMinDistances(vector<int> &indices);
     int getRegionGrowingStartLocation();
-    void getNeighborsOf(boost::shared_ptr<vector<int>> indices_in, float search_d, vector<int> &indices_out);
+    /// Select up to nb_seeds seeds, far from each other, for parallel region growing. Returns false if no seed is left.
+    bool getParallelStartLocations(int nb_seeds, vector<int> &seeds);
+    void buildSeedQueue();
+    void buildPointCloudSoA();
+    /// Available neighbors of the given points, without duplicates, in the order in which the points reach them.
+    void getNeighborsOf(boost::shared_ptr<vector<int>> indices_in, FrontierStamps &stamps, vector<int> &indices_out);
 
     void segmentPlane();
-    bool initRegionGrowth();
+    bool initRegionGrowth(RunProperties &run);
     void performRegionGrowth();
     bool regionGrowthOneStep();
     void performOneStep();
-    bool planeHasShrinked();
-    void reorient_normals(PointNormalKCloud::Ptr cloud_in, vector<int> indices, vec3 pn);
+    bool isSegmentationComplete();
+
+    /// Validity checks and plane refit at the beginning of a step. Does not modify the search tree.
+    GrowthStatus prepareRegionGrowthStep(RunProperties &run);
+    /// Candidates around the neighborhood that fit the current plane. Does not modify the search tree.
+    void findPointsInPlane(RunProperties &run, vector<int> &points_in_plane);
+    /// Add the points to the neighborhood and check for the end of the growth.
+    GrowthStatus growNeighborhood(RunProperties &run, vector<int> &points_in_plane);
+    /// Apply the exclusions, registration and display updates of a step. Returns true if the region keeps growing.
+    bool commitRegionGrowthStep(RunProperties &run, GrowthStatus status);
+    void registerPlane(RunProperties &run);
+
+    void runParallelMainLoop();
+    /// Grow one plane per seed in lockstep until every one of them is registered or discarded.
+    void segmentPlanesInParallel(const vector<int> &seeds);
+    int64_t getClaimKey(int step, int rank, int nb_runs);
+    /// Drop the points already owned by another run and claim the others with the given key.
+    void claimPoints(vector<int> &indices, int64_t key, int nb_runs);
+    /// Once every run claimed its points, keep only the ones owned by the run of the key. Points newly owned are added to new_claims.
+    void keepOwnedPoints(vector<int> &indices, int64_t key, int nb_runs, vector<int> &new_claims);
+    void releaseClaims(vector<int> &indices);
+    /// Release the claims of the points that are no longer in the neighborhood of their run.
+    void releaseDroppedClaims(vector<int> &claimed, const vector<int> &neighborhood);
+
+    bool planeHasShrinked(RunProperties &run);
     void exclude_points(vector<int> indices);
     void exclude_from_search(vector<int> &indices);
     void color_points(vector<int> indices, ivec3 color);
     void color_point(int index, ivec3 color);
     void fillSegmentedPointsContainer();
+    boost::shared_ptr<vector<int>> getAvailableIndices();
 };
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdlib>
+#include <memory>
+
+#include "common.h"
+
+/**
+ * @brief Structure of arrays copy of a PointNormalKCloud, keeping only the fields read by the segmentation and merging loops.
+ * A point takes 33 bytes instead of the 64 bytes of PointNormalK, and a loop only brings in cache the arrays it reads.
+ * Every array starts on a 64 bytes boundary of a single buffer.
+ *
+ * The cloud is converted once before segmentation, plane ids are written back once it is finished.
+ * The search trees, I/O and display keep working on the PointNormalKCloud.
+ */
+class PointCloudSoA
+{
+public:
+    typedef boost::shared_ptr<PointCloudSoA> Ptr;
+
+    PointCloudSoA(): buffer(nullptr, &free) {}
+    explicit PointCloudSoA(const PointNormalKCloud &cloud): buffer(nullptr, &free) { fromCloud(cloud); }
+
+    /// Replace the content by the points of the cloud.
+    void fromCloud(const PointNormalKCloud &cloud);
+    /// Write the normals, curvatures, k and plane ids back in the cloud, which must contain the same points.
+    void toCloud(PointNormalKCloud &cloud) const;
+    void copyPlaneIdsTo(PointNormalKCloud &cloud) const;
+
+    /**
+     * @brief Use arrays laid out as getData() of a cloud of the given size, e.g. memory mapped from a file, without copying them.
+     * data must be 64 bytes aligned and getDataSize(nb_points) long, owner keeps it alive as long as this object uses it.
+     */
+    void attach(char *data, size_t nb_points, boost::shared_ptr<void> owner);
+
+    /// Every array, one after the other.
+    const char *getData() const { return x == nullptr ? nullptr : reinterpret_cast<const char*>(x); }
+    static size_t getDataSize(size_t nb_points);
+
+    size_t size() const { return nb_points; }
+
+    vec3 getPoint(int i) const { return vec3(x[i], y[i], z[i]); }
+    vec3 getNormal(int i) const { return vec3(nx[i], ny[i], nz[i]); }
+    vec3 computeCenter(const vector<int> &indices) const;
+
+    float *x = nullptr;
+    float *y = nullptr;
+    float *z = nullptr;
+    float *nx = nullptr;
+    float *ny = nullptr;
+    float *nz = nullptr;
+    float *curvature = nullptr;
+    /// k is bounded by MAX_K_ORIGINAL, which AlignmentConfig::isValid keeps within MAX_K. Read by the neighbor searches of the region growing.
+    uint8_t *k = nullptr;
+    int32_t *plane_id = nullptr;
+
+    /// Largest k stored, larger ones are clamped to it.
+    static constexpr int MAX_K = 255;
+
+private:
+    static constexpr size_t ALIGNMENT = 64;
+
+    size_t nb_points = 0;
+    unique_ptr<char, decltype(&free)> buffer;
+    /// Owner of the attached arrays, if they are not in buffer.
+    boost::shared_ptr<void> p_owner;
+
+    void allocate(size_t size);
+    void setArrays(char *data, size_t size);
+};
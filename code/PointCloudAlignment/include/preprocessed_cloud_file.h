@@ -0,0 +1,64 @@
+#pragma once
+
+#include <fstream>
+
+#include "common.h"
+#include "mapped_file.h"
+#include "neighbor_graph.h"
+#include "point_cloud_soa.h"
+
+/**
+ * @brief Binary file of a preprocessed cloud, opened by mapping it in memory instead of parsing it.
+ *
+ * After a 64 bytes header (magic, version, flags, number of points, offset and size of each section), it contains
+ * the arrays of the PointCloudSoA of the cloud as they are laid out in memory, the rgba of every point and optionally
+ * the neighbor graph as written by NeighborGraph::write. Every section starts on a 64 bytes boundary, the segmentation
+ * works directly on the mapped arrays. Numbers are stored in the byte order of the machine.
+ */
+class PreprocessedCloudFile
+{
+public:
+    /// Extension given to these files.
+    static constexpr const char *EXTENSION = ".pcb";
+
+    static bool save(string filename, const PointNormalKCloud &cloud, NeighborGraph::Ptr p_graph = nullptr);
+    /// True if the file starts with the magic of this format, whatever its extension.
+    static bool isPreprocessedCloudFile(string filename);
+
+    /// Map the file in memory. Returns false if it can't be read, or is not a valid file of this version.
+    bool open(string filename);
+
+    size_t getNbPoints() const { return p_header == nullptr ? 0 : p_header->nb_points; }
+
+    /// Arrays of the points directly in the mapped file, which stays mapped as long as they are used. Writes are private to this process.
+    PointCloudSoA::Ptr getSoA();
+    /// Copy of the points in a new cloud.
+    PointNormalKCloud::Ptr getCloud();
+    /// Copy of the neighbor graph, null if the file does not contain one.
+    NeighborGraph::Ptr getNeighborGraph();
+
+private:
+    static constexpr char MAGIC[8] = {'P', 'C', 'A', 'C', 'L', 'O', 'U', 'D'};
+    /// 2: normals are oriented by NormalOrientation instead of toward (1, 1, 1), files of version 1 must be preprocessed again.
+    static constexpr uint32_t VERSION = 2;
+    static constexpr uint32_t HAS_GRAPH = 1;
+    static constexpr size_t ALIGNMENT = 64;
+
+    typedef struct _Header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t flags;
+        uint64_t nb_points;
+        uint64_t soa_offset;
+        uint64_t rgba_offset;
+        uint64_t graph_offset;
+        uint64_t graph_size;
+        uint64_t reserved;
+    } Header;
+
+    MappedFile::Ptr p_file;
+    const Header *p_header = nullptr;
+
+    static void pad(ofstream &out);
+};
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <boost/filesystem.hpp>
+
+#include "common.h"
+#include "alignment_config.h"
+#include "neighbor_graph.h"
+#include "preprocessed_cloud_file.h"
+
+/**
+ * @brief On-disk cache of the preprocessing (normals, curvatures, k and neighbor graph) of the clouds, so that running
+ * the pipeline again on the same clouds or tiles with other segmentation or registration parameters skips it.
+ *
+ * Entries are addressed by their content: the key hashes the coordinates of the points, in their order, along with the
+ * leaf size, the bounds on k and the neighbor search backend. Each entry is a preprocessed cloud file (see PreprocessedCloudFile) named after its key.
+ * Entries are written under a temporary name then renamed, concurrent runs can share a directory. Nothing is ever
+ * removed from it.
+ *
+ * The cache is shared by the whole process and disabled until a directory is set, by the --cache option of the tools.
+ */
+class PreprocessingCache
+{
+public:
+    static PreprocessingCache &get();
+
+    /// Directory of the entries, created if it does not exist. Empty disables the cache. Returns false if it can't be created.
+    bool setDirectory(string directory);
+    bool isEnabled() const { return !directory.empty(); }
+
+    /// Key of the preprocessing of the cloud with the given configuration, the bounds on k depending on the cloud being resampled.
+    static string getKey(const PointNormalKCloud &cloud, const AlignmentConfig &config, bool is_resampled);
+
+    /**
+     * @brief Copy the normals, curvatures and k of the entry of the key to the cloud, and read its neighbor graph.
+     * @return false, leaving the cloud as it is, if there is no such entry or its points are not the ones of the cloud.
+     */
+    bool load(string key, PointNormalKCloud &cloud, NeighborGraph::Ptr &p_graph) const;
+    bool save(string key, const PointNormalKCloud &cloud, NeighborGraph::Ptr p_graph) const;
+
+private:
+    PreprocessingCache() {}
+
+    /// Hashed in the keys, increased whenever the preprocessing computes different results: older entries are then never read.
+    static const uint64_t VERSION = 2;
+
+    boost::filesystem::path directory;
+
+    boost::filesystem::path getPath(string key) const { return directory / (key + PreprocessedCloudFile::EXTENSION); }
+};
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "common.h"
+
+/**
+ * @brief Registry of scoped timers and counters, to see where the time goes in each stage of the pipeline.
+ *
+ * Nothing is recorded until setEnabled(true): a disabled timer or counter only reads a flag. Building with
+ * -DPCA_PROFILING=OFF defines PCA_NO_PROFILING, which compiles PROFILE_SCOPE, PROFILE_COUNT and PROFILE_CONTEXT out.
+ * Each thread records in its own buffer, buffers are only gathered when the registry is written.
+ *
+ * A context (e.g. the index of a tile) is attached to everything recorded while it is set, so that the totals can be
+ * given for each context. There is a single context at a time, it is meant for units of work processed one by one.
+ */
+class Profiler
+{
+public:
+    static const int64_t NO_CONTEXT = -1;
+
+    static Profiler &get();
+
+    void setEnabled(bool enabled) { this->enabled.store(enabled, memory_order_relaxed); }
+    bool isEnabled() const { return enabled.load(memory_order_relaxed); }
+    /// Discard everything recorded so far. Must not be called while other threads are recording.
+    void clear();
+
+    void setContext(int64_t context) { this->context.store(context, memory_order_relaxed); }
+    int64_t getContext() const { return context.load(memory_order_relaxed); }
+
+    /// Nanoseconds elapsed since the registry was created.
+    int64_t now() const;
+
+    /// Record a scope of the calling thread, start being given by now().
+    void addScope(const char *name, int64_t start, int64_t duration, int64_t context);
+    void addCount(const char *name, int64_t value);
+
+    /// Number of calls, total, min and max durations of every timer, and total of every counter, overall and per context.
+    void writeJSON(ostream &out) const;
+    /// Every scope as a complete event of the Chrome trace event format, to be opened in chrome://tracing or Perfetto.
+    void writeChromeTrace(ostream &out) const;
+    bool save(string filename, bool chrome_trace) const;
+
+private:
+    Profiler();
+
+    typedef struct _Scope
+    {
+        const char *name;
+        int64_t start;
+        int64_t duration;
+        int64_t context;
+    } Scope;
+
+    struct CounterKeyHash
+    {
+        size_t operator()(const pair<const char*, int64_t> &key) const { return hash<const void*>()(key.first) ^ hash<int64_t>()(key.second); }
+    };
+
+    /// Records of one thread. Names are string literals, counters are only merged by name when the registry is written.
+    typedef struct _ThreadBuffer
+    {
+        int thread_id;
+        vector<Scope> scopes;
+        unordered_map<pair<const char*, int64_t>, int64_t, CounterKeyHash> counters;
+    } ThreadBuffer;
+
+    typedef struct _Timer
+    {
+        size_t calls = 0;
+        int64_t total = 0;
+        int64_t min = numeric_limits<int64_t>::max();
+        int64_t max = 0;
+    } Timer;
+
+    typedef struct _Totals
+    {
+        map<string, Timer> timers;
+        map<string, int64_t> counters;
+    } Totals;
+
+    atomic<bool> enabled;
+    atomic<int64_t> context;
+    chrono::steady_clock::time_point origin;
+
+    mutable mutex buffers_mutex;
+    vector<unique_ptr<ThreadBuffer>> buffers;
+
+    ThreadBuffer &getThreadBuffer();
+    static void writeTotals(ostream &out, const Totals &totals, string indent);
+};
+
+/// Record the time spent from its construction to its destruction, if the registry is enabled.
+class ProfileScope
+{
+public:
+    ProfileScope(const char *name): name(name), start(Profiler::get().isEnabled() ? Profiler::get().now() : -1), context(Profiler::get().getContext()) {}
+    ~ProfileScope()
+    {
+        if(start >= 0) Profiler::get().addScope(name, start, Profiler::get().now() - start, context);
+    }
+
+private:
+    const char *name;
+    int64_t start;
+    int64_t context;
+};
+
+/// Set the context of the registry until its destruction, restoring the previous one.
+class ProfileContext
+{
+public:
+    ProfileContext(int64_t context): previous(Profiler::get().getContext()) { Profiler::get().setContext(context); }
+    ~ProfileContext() { Profiler::get().setContext(previous); }
+
+private:
+    int64_t previous;
+};
+
+#ifdef PCA_NO_PROFILING
+#define PROFILE_SCOPE(name)
+#define PROFILE_COUNT(name, value)
+#define PROFILE_CONTEXT(context)
+#else
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+/// Time the rest of the enclosing block under name, a string literal.
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profile_scope_, __LINE__)(name)
+/// Add value to the counter name, a string literal.
+#define PROFILE_COUNT(name, value) do { if(Profiler::get().isEnabled()) Profiler::get().addCount(name, value); } while(0)
+/// Attach the rest of the enclosing block to a context.
+#define PROFILE_CONTEXT(context) ProfileContext PROFILE_CONCAT(profile_context_, __LINE__)(context)
+#endif
@@ -10,8 +10,10 @@
 #include <pcl/registration/icp.h>
 
 #include "common.h"
+#include "alignment_config.h"
 #include "segmented_points_container.h"
 #include "pfh_evaluation.h"
+#include "profiler.h"
 
 typedef tuple<size_t, size_t, float> PlaneTuples;
 
@@ -21,6 +23,8 @@ public:
                    PointNormalKCloud::Ptr p_source_cloud = nullptr, PointNormalKCloud::Ptr p_target_cloud = nullptr);
 
     void setCallback(function<void(SegmentedPointsContainer::SegmentedPlane, SegmentedPointsContainer::SegmentedPlane, ivec3)> callable) { this->display_update_callable = callable; }
+    /// Parameters of the plane association and realignment, the default configuration if not set.
+    void setConfig(const AlignmentConfig &config) { this->config = config; }
 
     mat4 findAlignment();
 
@@ -44,6 +48,10 @@ public:
     vector<float> computeDistanceErrors();
 
 private:
+    /// The private kernels are timed by pca_bench.
+    friend class KernelBenchmarks;
+
+    AlignmentConfig config;
     bool targetIsMesh = false;
     bool sourceIsMesh = false;
     Eigen::MatrixXf M;
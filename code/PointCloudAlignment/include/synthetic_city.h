@@ -0,0 +1,107 @@
+#pragma once
+
+#include <fstream>
+#include <random>
+
+#include <pcl/io/vtk_lib_io.h>
+
+#include "common.h"
+
+/**
+ * @brief Procedural city: square blocks laid out row by row, each holding a building with a flat or gabled roof
+ * and a few trees, on a flat ground. The layout only depends on the seed.
+ *
+ * The same city can be sampled as a cloud any number of times, the sampling seed only changing the points drawn on
+ * its surfaces and their noise, and tessellated as a mesh. Clouds and meshes of the same scene can thus be aligned.
+ * The number of points of a sampling is known beforehand, so that saveCloud writes them block by block: a city of
+ * tens of millions of points never has to fit in memory.
+ */
+class SyntheticCity
+{
+public:
+    typedef struct _Parameters
+    {
+        /// Side of the city, in meters, rounded to a whole number of blocks.
+        float size = 200;
+        /// Points per square meter of ground and roofs.
+        float density = 10;
+        /// Density of the walls relative to the roofs, aerial scans only graze them.
+        float wall_ratio = 0.25f;
+        /// Standard deviation of the gaussian noise added to every coordinate, in meters.
+        float noise = 0.02f;
+        /// Trees per hectare. Their crowns are points scattered in a ball, as vegetation returns are.
+        float trees = 40;
+        /// Ratio of the buildings having a gabled roof, the others are flat.
+        float gabled_ratio = 0.6f;
+        /// Bounds on the height of the eaves, in meters.
+        float min_height = 4;
+        float max_height = 20;
+        unsigned seed = 42;
+    } Parameters;
+
+    /// Side of a block, in meters.
+    static constexpr float BLOCK_SIZE = 20;
+
+    void setParameters(const Parameters &parameters) { this->parameters = parameters; }
+    const Parameters &getParameters() const { return parameters; }
+
+    /// Lay out the blocks of a city of the size of the parameters.
+    void generate();
+    /// Lay out as many blocks as needed for a sampling to have about nb_points points. The size is updated accordingly.
+    void generate(size_t nb_points);
+
+    size_t getNbBlocks() const { return blocks.size(); }
+    /// Exact number of points of every sampling of the city.
+    size_t getNbPoints() const;
+
+    PointNormalKCloud::Ptr sampleCloud(unsigned sampling_seed) const;
+    /// Sample the city in a binary PLY file of x, y and z, block by block. Returns false if the file can't be written.
+    bool saveCloud(string filename, unsigned sampling_seed) const;
+
+    /// Triangles of the ground, roofs and walls. The vertices are PointXYZRGB, as MeshObject loads them. Trees are left out.
+    pcl::PolygonMesh::Ptr getMesh() const;
+    bool saveMesh(string filename) const;
+
+private:
+    /// Planar patch: the points origin + s * u + t * v for s and t in [0, 1], with s + t <= 1 for triangles.
+    typedef struct _Surface
+    {
+        vec3 origin;
+        vec3 u;
+        vec3 v;
+        bool is_triangle;
+        float density;
+    } Surface;
+
+    typedef struct _Block
+    {
+        /// Corner of the block of lowest x and y.
+        vec2 corner;
+        /// Footprint of the building: center, unit direction of its length, length and width.
+        vec2 center;
+        vec2 axis;
+        float length;
+        float width;
+        /// Height of the eaves, and of the ridge of gabled roofs (the eaves height for flat roofs).
+        float height;
+        float ridge_height;
+        /// Center and radius of the crown of every tree.
+        vector<vec4> trees;
+    } Block;
+
+    Parameters parameters;
+    vector<Block> blocks;
+
+    void layout(size_t nb_blocks);
+
+    /// Roofs, walls and gables of the building of a block.
+    void getBuildingSurfaces(const Block &block, vector<Surface> &surfaces) const;
+    bool isInFootprint(const Block &block, float x, float y) const;
+    static size_t getNbPoints(const Surface &surface);
+    size_t getNbGroundPoints(const Block &block) const;
+    size_t getNbTreePoints(const vec4 &tree) const;
+
+    size_t getNbBlockPoints(const Block &block) const;
+    /// Append the points of the block to points. The points of a block only depend on the sampling seed and on the block.
+    void sampleBlock(size_t block_id, unsigned sampling_seed, vector<vec3> &points) const;
+};
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <sstream>
+#include <map>
 
 #include <time.h>
 
@@ -11,6 +12,7 @@
 #include <pcl/common/transforms.h>
 
 #include "common.h"
+#include "alignment_config.h"
 #include "plane_segmentation.h"
 #include "plane_merging.h"
 #include "segmented_points_container.h"
@@ -32,6 +34,40 @@ struct AlignmentResults
     int nb_planes_target = 0;
     vector<float> pair_distances;
     double elapsed_time = 0;
+
+    /// Largest of the euler angles of the rotation left between the aligned source and the target.
+    double getRotationError() const;
+    /// Distance between the centroids of the associated source and target plane centers.
+    double getTranslationError() const;
+    float getMeanPairDistance() const;
+
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+/// Planes of an object segmented with one configuration, along with the cloud they index (null for meshes).
+struct SegmentationResult
+{
+    vector<SegmentedPointsContainer::SegmentedPlane> planes;
+    PointNormalKCloud::Ptr p_cloud;
+    double segmentation_time = 0;
+    double merging_time = 0;
+};
+
+/// One source of a testing set aligned with one configuration of a parameter sweep.
+struct SweepRun
+{
+    size_t set_id = 0;
+    size_t source_id = 0;
+    size_t config_id = 0;
+    AlignmentResults results;
+    /// Time spent in each stage, measured when the stage was run even if its result was then reused by other runs.
+    double source_segmentation_time = 0;
+    double target_segmentation_time = 0;
+    double source_merging_time = 0;
+    double target_merging_time = 0;
+    double registration_time = 0;
+
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 };
 
 class AlignObjectInterface
@@ -49,6 +85,9 @@ public:
     mat4 getOriginalTransform();
     void setOriginalTransform(mat4 &t);
 
+    /// Parameters of the preprocessing, segmentation and merging of the object.
+    void setConfig(const AlignmentConfig &config) { this->config = config; }
+
     virtual void loadObject() = 0;
 
     virtual void displayObjectIn(pcl::visualization::PCLVisualizer::Ptr p_viewer, ivec3 color, int viewport = 0, string id_prefix = "") = 0;
@@ -61,6 +100,14 @@ public:
 
     virtual void preprocess() = 0;
 
+    /**
+     * @brief Segment the planes of the object with the given configuration, without modifying the object so that
+     * several configurations can be run concurrently. The planes are not merged yet, except for meshes.
+     */
+    virtual void segmentPlanes(const AlignmentConfig &config, SegmentationResult &result) = 0;
+    /// Merge the planes of a segmentation result with the given configuration.
+    virtual void mergePlanes(const AlignmentConfig &config, SegmentationResult &result) = 0;
+
     virtual void transform(mat4 &M) = 0;
 
     virtual void saveObject(string suffix, int set_id) = 0;
@@ -78,6 +125,7 @@ private:
 protected:
     bool isCld;
     mat4 originalT;
+    AlignmentConfig config;
 };
 
 class CloudObject : public AlignObjectInterface
@@ -99,6 +147,8 @@ public:
         this->isCld = true;
         this->p_object = PointNormalKCloud::Ptr(new PointNormalKCloud);
         pcl::copyPointCloud(*object.getObject(), *this->p_object);
+        this->p_graph = object.p_graph;
+        this->config = object.config;
     }
 
     void loadObject();
@@ -109,6 +159,10 @@ public:
 
     void segment(vector<SegmentedPointsContainer::SegmentedPlane> &out_planes);
 
+    void segmentPlanes(const AlignmentConfig &config, SegmentationResult &result);
+
+    void mergePlanes(const AlignmentConfig &config, SegmentationResult &result);
+
     void transform(mat4 &M);
 
     void saveObject(string suffix, int set_id);
@@ -122,6 +176,8 @@ public:
 
 private:
     PointNormalKCloud::Ptr p_object;
+    /// Neighbor graph computed with the preprocessing, saved and loaded along with the cloud. May be null.
+    NeighborGraph::Ptr p_graph;
 };
 
 class MeshObject : public AlignObjectInterface
@@ -142,6 +198,7 @@ public:
     {
         this->isCld = false;
         this->p_object = pcl::PolygonMesh::Ptr(new pcl::PolygonMesh(*object.getObject()));
+        this->config = object.config;
     }
 
     void loadObject();
@@ -152,6 +209,10 @@ public:
 
     void segment(vector<SegmentedPointsContainer::SegmentedPlane> &out_planes);
 
+    void segmentPlanes(const AlignmentConfig &config, SegmentationResult &result);
+
+    void mergePlanes(const AlignmentConfig &config, SegmentationResult &result);
+
     void transform(mat4 &M);
 
     void saveObject(string suffix, int set_id);
@@ -181,6 +242,9 @@ public:
     void addSource(string sourcefile, bool isCloud = true,  mat4 m = mat4::Identity());
     bool isInitialized();
 
+    /// Parameters used for every object of the set and for their registration.
+    void setConfig(const AlignmentConfig &config);
+
     void loadSet();
 
     void runTests();
@@ -194,7 +258,15 @@ public:
 
     void writeResults(int test_id);
 
+    /**
+     * @brief Align every source on the target with each configuration, appending one run per source and configuration.
+     * A segmentation or merging is computed once for all the configurations sharing its parameters, the distinct
+     * segmentations, mergings and registrations are each spread over the threads.
+     */
+    void runSweep(const vector<AlignmentConfig> &configs, size_t set_id, vector<SweepRun, Eigen::aligned_allocator<SweepRun>> &runs);
+
 private:
+    AlignmentConfig config;
     shared_ptr<AlignObjectInterface> p_target;
     vector<shared_ptr<AlignObjectInterface>> sources;
     vector<shared_ptr<AlignObjectInterface>> sources_aligned;
@@ -203,6 +275,8 @@ private:
     vector<AlignmentResults, Eigen::aligned_allocator<AlignmentResults> > results;
 
     void runAlignment(size_t source_id);
+    /// Register the source planes on the target planes, filling the transform, pair distances and centers of result.
+    void alignPlanes(const AlignmentConfig &config, size_t source_id, SegmentationResult &source, SegmentationResult &target, AlignmentResults &result);
 
     string getMatStr(mat4 &m);
 };
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <fstream>
+#include <map>
+
+#include <boost/filesystem.hpp>
+
+#include "common.h"
+#include "cloud_stream_reader.h"
+#include "plane_segmentation.h"
+#include "plane_merging.h"
+#include "profiler.h"
+
+/**
+ * @brief Out-of-core plane segmentation of clouds too large to be held in memory as a PointNormalKCloud.
+ *
+ * The input file is streamed once to find its XY bounds, then once more to dispatch its points in square XY tiles,
+ * each one extended by a halo so that the points near its border get their whole neighborhood. The tiles are written
+ * in temporary files and segmented one at a time with NormalComputation and PlaneSegmentation, only the points of the tile
+ * core (without halo) are kept. As soon as a tile is segmented, its planes reaching a tile border are stitched to the ones of
+ * the tiles already segmented around it, when they pass the PlaneMerging normal criterion and their points meet across the
+ * border. The band points along the borders (coordinates and plane id only) are dropped once every tile around theirs is
+ * segmented: at most about one row of tiles keeps them, peak memory depends on the tile size and on the number of tiles
+ * along x, not on the number of points of the cloud.
+ */
+class TiledSegmentation
+{
+public:
+    TiledSegmentation(float tile_size = TILE_SIZE, float halo = TILE_HALO, float stitch_band = TILE_STITCH_BAND):
+        tile_size(tile_size), halo(halo), stitch_band(stitch_band) {}
+
+    void setResample(bool resample) { this->resample = resample; }
+    /// Parameters of the segmentation of the tiles and of the stitching, the tile geometry is the one given to the constructor.
+    void setConfig(const AlignmentConfig &config) { this->config = config; }
+    void setNbParallelSeeds(int nb_seeds) { this->nb_parallel_seeds = nb_seeds; }
+
+    /**
+     * @brief Segment the cloud of input_file (PLY or PCD) and write it in output_file as a binary PCD cloud
+     * of PointNormalK, every point carrying the id of its plane (0 if excluded).
+     * @return EXIT_SUCCESS or EXIT_FAILURE if a file can't be read or written.
+     */
+    int segment(string input_file, string output_file);
+
+    size_t getNbPlanes() { return nb_planes; }
+    size_t getNbPoints() { return nb_output_points; }
+
+private:
+    /// Point as written in the output file, the fields are those of PointNormalK without padding.
+    typedef struct _OutputPoint
+    {
+        float x, y, z;
+        float normal_x, normal_y, normal_z;
+        uint32_t rgba;
+        float curvature;
+        float k;
+        int plane_id;
+    } OutputPoint;
+
+    float tile_size;
+    float halo;
+    float stitch_band;
+    bool resample = true;
+    AlignmentConfig config;
+    int nb_parallel_seeds = 1;
+
+    vec2 min_xy;
+    int nb_tiles_x = 0;
+    int nb_tiles_y = 0;
+
+    boost::filesystem::path work_dir;
+    size_t nb_planes = 0;
+    size_t nb_output_points = 0;
+
+    /// Point of a border band, with the global id of its plane.
+    typedef struct _BorderPoint
+    {
+        float x, y, z;
+        int plane_id;
+    } BorderPoint;
+
+    /// Core points of a tile in its border band, and the normalized normals of their planes by global id.
+    typedef struct _BorderBand
+    {
+        vector<BorderPoint> points;
+        map<int, vec3> normals;
+    } BorderBand;
+
+    /// Bands of the segmented tiles having a neighbor not segmented yet, by tile.
+    map<int, BorderBand> border_bands;
+    /// Union-find of the global plane ids, a stitched plane has the lowest id of its parts as root.
+    vector<int> plane_ids;
+
+    bool computeTiles(CloudStreamReader &reader);
+    bool dispatchPoints(CloudStreamReader &reader);
+    void segmentTile(int tile, ofstream &out);
+    /// Stitch the planes of the band of the tile to the ones of the bands of the segmented tiles around it.
+    void stitchTile(int tile);
+    /// Drop the bands whose tiles around are all segmented once the tile is.
+    void releaseBands(int tile);
+    int findRoot(int id);
+    /// Global id of every plane after stitching, indexed by global id before stitching.
+    vector<int> getStitchedIds();
+    bool writeOutput(string output_file, vector<int> &plane_ids);
+
+    boost::filesystem::path getTilePath(int tile);
+    bool isInCore(int tile, float x, float y);
+    bool isInBorderBand(int tile, float x, float y);
+};
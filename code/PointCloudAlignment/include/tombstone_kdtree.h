@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+
+#include "common.h"
+#include "neighbor_search.h"
+#include "profiler.h"
+
+/**
+ * @brief Search structure supporting the removal of points in place. Removed points are only marked as dead
+ * in a bitmask and filtered out of the search results, the search (kdtree or grid) is rebuilt with the alive points
+ * only once the dead ones make up more than a given ratio of the indexed points.
+ * Removing points thus costs O(removed) instead of a full O(N log N) rebuild.
+ *
+ * A query inside a large dead region would have to skip all of it: searches stop after MAX_EXPANSION * k neighbors, and
+ * the next removal then rebuilds the search even if the dead points are below the ratio overall.
+ */
+class TombstoneKdTree
+{
+public:
+    typedef boost::shared_ptr<TombstoneKdTree> Ptr;
+
+    /// backend is one of NeighborSearch::Backend.
+    TombstoneKdTree(int backend = NeighborSearch::KDTREE, float rebuild_ratio = 0.5f):
+        backend(backend), p_search(NeighborSearch::create(backend)), nb_alive(0), nb_indexed(0), rebuild_ratio(rebuild_ratio) {}
+
+    /// Change the search backend, the alive points are indexed again by the new one.
+    void setBackend(int backend);
+
+    /// Index every point of the cloud, they are all alive.
+    void setInputCloud(PointNormalKCloud::Ptr cloud);
+    /// Index only the given points of the cloud, the others are considered dead.
+    void setInputCloud(PointNormalKCloud::Ptr cloud, boost::shared_ptr<vector<int>> indices);
+
+    /// Mark the given points as dead. Already dead points are ignored.
+    void remove(const vector<int> &indices);
+
+    bool isAlive(int index) const { return alive[index]; }
+    size_t getNbAlive() const { return nb_alive; }
+    vector<int> getAliveIndices() const;
+
+    /// Underlying search, it may still contain dead points.
+    NeighborSearch::Ptr getSearch() { return p_search; }
+
+    /**
+     * @brief Search the k nearest alive neighbors of p among its MAX_EXPANSION * k nearest indexed points. Can safely be
+     * called from several threads as long as no point is removed concurrently.
+     * @return The number of neighbors found, less than k if fewer points are alive or if the bound was reached.
+     */
+    int nearestKSearch(const PointNormalK &p, int k, vector<int> &k_indices, vector<float> &k_sqr_distances) const;
+
+private:
+    /// Bound on the number of indexed neighbors searched for each of the k requested, dead ones included.
+    static const int MAX_EXPANSION = 64;
+
+    PointNormalKCloud::Ptr p_cloud;
+    int backend;
+    NeighborSearch::Ptr p_search;
+    vector<bool> alive;
+    /// Number of alive points.
+    size_t nb_alive;
+    /// Number of points (dead or alive) contained in the search.
+    size_t nb_indexed;
+    /// Ratio of dead points in the search above which it is rebuilt.
+    float rebuild_ratio;
+    /// Set by a search that reached MAX_EXPANSION, the search is rebuilt at the next removal.
+    mutable atomic<bool> is_expansion_bounded{false};
+
+    void rebuild();
+};
@@ -2,6 +2,7 @@
 
 /// This header file aims regroup in one place every variable that can be changed manually at one point
 /// in the  plane segmentation, merging or alignement processes.
+/// The tuning parameters below are only the defaults of AlignmentConfig, which can be changed at runtime.
 
 ///================================ PREPROCESSING STEPS: contains normal and curvature computation. =========================================///
 
@@ -13,6 +14,10 @@
 #define MAX_K_RESAMPLED 15
 /// Lower bound on K computation.
 #define MIN_K 7
+/// Backend of the k nearest neighbors searches: 0 for the FLANN kdtree, 1 for a uniform grid over XY, faster on 2.5D aerial scans.
+#define NEIGHBOR_SEARCH 0
+/// 1 to sort the points along a Morton (Z-order) curve before the normal computation, so that neighbors are close in memory.
+#define MORTON_ORDER 0
 /// Maximum curvature threshold to exclude points before plane segmentation.
 #define MAX_CURVATURE 0.5
 
@@ -33,6 +38,19 @@
 #define MIN_PLANE_SIZE 10
 /// Upper bound on the number of region grwoing iterations.
 #define MAX_ITERATIONS 100
+/// Minimal distance between two seeds grown concurrently when the parallel region growing is enabled.
+#define MIN_SEED_DISTANCE 20.0f
+
+///================================ TILED SEGMENTATION ====================================================================================///
+
+/// Side of the square XY tiles in which large clouds are segmented.
+#define TILE_SIZE 200.0f
+/// Width of the overlap added around each tile, so that the points near its border get their whole neighborhood.
+#define TILE_HALO 10.0f
+/// Width of the band along the tile borders whose points are used to stitch the planes crossing them.
+#define TILE_STITCH_BAND 2.0f
+/// Number of points read or buffered at once when streaming a cloud file.
+#define STREAM_CHUNK_SIZE 1000000
 
 ///================================ PLANE MERGING CLOUD ===================================================================================///
 
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <omp.h>
+#include <unordered_map>
+
+#include "common.h"
+#include "cloud_stream_reader.h"
+
+/**
+ * @brief Voxel grid downsampling accumulating the points chunk by chunk in a hash map of the occupied voxels, so that
+ * the input cloud never has to be held in memory: memory only depends on the number of voxels, i.e. on the output size.
+ *
+ * As with pcl::VoxelGrid, the grid is aligned on the origin and each voxel gives the centroid of its points. Only the
+ * coordinates are averaged, other fields of the output points keep their default values. Voxels are spread over shards
+ * by their hash, each thread accumulating the points of a chunk that fall in its own shards.
+ */
+class VoxelGridResampler
+{
+public:
+    VoxelGridResampler(float leaf_size = LEAF_SIZE);
+
+    /// Changing the leaf size discards the points added so far.
+    void setLeafSize(float leaf_size);
+    float getLeafSize() const { return leaf_size; }
+    void clear();
+
+    void addPoints(const vector<vec3> &points);
+    void addPoints(const PointNormalKCloud &cloud);
+    /// Stream the points of a PLY or PCD file through the grid. Returns false if the file can't be read.
+    bool addFile(string filename);
+
+    size_t getNbVoxels() const;
+    /// One point per occupied voxel, ordered by voxel as pcl::VoxelGrid does (x first, then y, then z).
+    PointNormalKCloud::Ptr getCloud() const;
+
+private:
+    static const size_t NB_SHARDS = 64;
+
+    typedef struct _VoxelKey
+    {
+        int32_t x, y, z;
+
+        bool operator==(const _VoxelKey &other) const { return x == other.x && y == other.y && z == other.z; }
+    } VoxelKey;
+
+    struct VoxelKeyHash
+    {
+        size_t operator()(const VoxelKey &key) const;
+    };
+
+    /// Sums in double, to stay accurate on georeferenced coordinates and voxels of many points.
+    typedef struct _Voxel
+    {
+        vec3d sum = vec3d::Zero();
+        size_t nb_points = 0;
+    } Voxel;
+
+    float leaf_size;
+    vector<unordered_map<VoxelKey, Voxel, VoxelKeyHash>> shards;
+
+    template<typename PointAt>
+    void accumulate(size_t nb_points, PointAt point_at);
+};
@@ -174,6 +174,10 @@ void keyboardCallback(const pcl::visualization::KeyboardEvent &event,
 
             // Writing PC to file
             pcl::io::savePLYFile(filename, *pc_source_segmentation.getPointCloud());
+            if(pc_source_segmentation.getNeighborGraph())
+            {
+                pc_source_segmentation.getNeighborGraph()->save(NeighborGraph::getSidecarPath(filename));
+            }
         }
 
         if(!targetIsMesh)
@@ -182,6 +186,10 @@ void keyboardCallback(const pcl::visualization::KeyboardEvent &event,
             string filename = "myTargetPC.ply";
 
             pcl::io::savePLYFile(filename, *pc_target_segmentation.getPointCloud());
+            if(pc_target_segmentation.getNeighborGraph())
+            {
+                pc_target_segmentation.getNeighborGraph()->save(NeighborGraph::getSidecarPath(filename));
+            }
         }
     }
     else if(event.getKeySym() == "F7" && event.keyDown())
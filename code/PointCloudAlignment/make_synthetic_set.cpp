@@ -0,0 +1,160 @@
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "common.h"
+#include "preprocessing_cache.h"
+#include "synthetic_city.h"
+#include "test_set.h"
+
+using namespace std;
+
+/// Testing set built from a procedural city instead of scanned data: the target and the sources are different
+/// samplings (or the mesh) of the same city, every source being moved by a random transform as createTestSet does.
+
+int main(int argc, char *argv[])
+{
+    AlignmentConfig config;
+    SyntheticCity::Parameters parameters;
+    size_t nb_points = 0;
+    int nb_cloud_sources = 1;
+    int nb_mesh_sources = 0;
+    bool mesh_target = false;
+    bool raw = false;
+    vector<string> args;
+
+    for(int i = 1; i < argc; ++i)
+    {
+        string arg = argv[i];
+
+        if(arg == "--points" && i + 1 < argc)
+        {
+            nb_points = stoull(argv[++i]);
+        }
+        else if(arg == "--size" && i + 1 < argc)
+        {
+            parameters.size = atof(argv[++i]);
+        }
+        else if(arg == "--density" && i + 1 < argc)
+        {
+            parameters.density = atof(argv[++i]);
+        }
+        else if(arg == "--noise" && i + 1 < argc)
+        {
+            parameters.noise = atof(argv[++i]);
+        }
+        else if(arg == "--trees" && i + 1 < argc)
+        {
+            parameters.trees = atof(argv[++i]);
+        }
+        else if(arg == "--wall-ratio" && i + 1 < argc)
+        {
+            parameters.wall_ratio = atof(argv[++i]);
+        }
+        else if(arg == "--seed" && i + 1 < argc)
+        {
+            parameters.seed = atoi(argv[++i]);
+        }
+        else if(arg == "--cloud-sources" && i + 1 < argc)
+        {
+            nb_cloud_sources = atoi(argv[++i]);
+        }
+        else if(arg == "--mesh-sources" && i + 1 < argc)
+        {
+            nb_mesh_sources = atoi(argv[++i]);
+        }
+        else if(arg == "--mesh-target")
+        {
+            mesh_target = true;
+        }
+        else if(arg == "--raw")
+        {
+            raw = true;
+        }
+        else if(arg == "--config" && i + 1 < argc)
+        {
+            // The leaf size and the bounds on k of the preprocessing are read from the configuration
+            if(!config.load(argv[++i])) exit(EXIT_FAILURE);
+        }
+        else if(arg == "--set" && i + 1 < argc)
+        {
+            if(!config.setArgument(argv[++i])) exit(EXIT_FAILURE);
+        }
+        else if(arg == "--cache" && i + 1 < argc)
+        {
+            // Normals, curvatures and k of clouds already preprocessed with the same parameters are read back
+            if(!PreprocessingCache::get().setDirectory(argv[++i])) exit(EXIT_FAILURE);
+        }
+        else
+        {
+            args.push_back(arg);
+        }
+    }
+
+    if(args.size() != 1 || parameters.size <= 0 || parameters.density <= 0 || parameters.noise < 0 || parameters.trees < 0 ||
+       nb_cloud_sources < 0 || nb_mesh_sources < 0 || (!raw && nb_cloud_sources + nb_mesh_sources == 0) || !config.isValid())
+    {
+        cout << "Usage: createSyntheticSet [--points N | --size S] [--density D] [--noise sigma] [--trees T] [--wall-ratio R] [--seed S] [--cloud-sources N] [--mesh-sources N] [--mesh-target] [--raw] [--config file] [--set name=value] [--cache directory] [output_prefix]" << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    string prefix = args[0];
+
+    SyntheticCity city;
+    city.setParameters(parameters);
+    if(nb_points > 0)
+    {
+        city.generate(nb_points);
+    }
+    else
+    {
+        city.generate();
+    }
+
+    LOG(INFO) << "City of " << city.getNbBlocks() << " blocks, " << city.getParameters().size << " m wide, " << city.getNbPoints() << " points by cloud";
+
+    // The target and the sources are distinct samplings of the city, as two scans of the same place would be
+    string target_file = prefix + "_cloud.ply";
+    string source_file = prefix + "_source.ply";
+    string mesh_file = prefix + "_mesh.ply";
+
+    if(!city.saveCloud(target_file, parameters.seed)) exit(EXIT_FAILURE);
+
+    if(raw)
+    {
+        // Clouds too large for the preprocessing are left as they are, for segmentTiles
+        cout << "Synthetic city written in " << target_file << endl;
+        return EXIT_SUCCESS;
+    }
+
+    if(nb_cloud_sources > 0 && !city.saveCloud(source_file, parameters.seed + 1)) exit(EXIT_FAILURE);
+    if((mesh_target || nb_mesh_sources > 0) && !city.saveMesh(mesh_file)) exit(EXIT_FAILURE);
+
+    TestingSet set(mesh_target ? mesh_file : target_file, !mesh_target);
+    set.setConfig(config);
+
+    for(int i = 0; i < nb_cloud_sources; ++i)
+    {
+        set.addSource(source_file, true);
+    }
+    for(int i = 0; i < nb_mesh_sources; ++i)
+    {
+        set.addSource(mesh_file, false);
+    }
+
+    // The random transforms only depend on the seed
+    srand(parameters.seed);
+    set.applyRandomTransforms();
+    set.preprocessClouds();
+    set.saveObjectsPLY(0);
+
+    string set_file = prefix + "_set.txt";
+    ofstream output(set_file);
+    set.writeTestSet(output);
+    output << endl;
+    output.close();
+
+    cout << "Synthetic testing set written in " << set_file << endl;
+
+    return EXIT_SUCCESS;
+}
@@ -17,6 +17,8 @@
 #include "mesh_segmentation.h"
 #include "registration.h"
 #include "test_set.h"
+#include "parameter_sweep.h"
+#include "profiler.h"
 
 using namespace std;
 
@@ -116,14 +118,67 @@ static bool parseTestingFile(string file_path)
 
 int main(int argc, char *argv[])
 {
-    if(argc != 2)
+    bool display = true;
+    string testing_set_file;
+    string sweep_file;
+    string sweep_output = "sweep_results.csv";
+    string profile_file, trace_file;
+    AlignmentConfig config;
+
+    for(int i = 1; i < argc; ++i)
     {
-        cout << "Usage: run_test_set [testing_set_file]" << endl;
+        if(string(argv[i]) == "--no-display")
+        {
+            display = false;
+        }
+        else if(string(argv[i]) == "--config" && i + 1 < argc)
+        {
+            // Parameters are applied in the order of the arguments, --set may then override the file
+            if(!config.load(argv[++i])) exit(EXIT_FAILURE);
+        }
+        else if(string(argv[i]) == "--set" && i + 1 < argc)
+        {
+            if(!config.setArgument(argv[++i])) exit(EXIT_FAILURE);
+        }
+        else if(string(argv[i]) == "--sweep" && i + 1 < argc)
+        {
+            sweep_file = argv[++i];
+        }
+        else if(string(argv[i]) == "--output" && i + 1 < argc)
+        {
+            sweep_output = argv[++i];
+        }
+        else if(string(argv[i]) == "--log-level" && i + 1 < argc)
+        {
+            int level = Logging::parseLevel(argv[++i]);
+            if(level == -1)
+            {
+                cout << "Unknown log level " << argv[i] << endl;
+                exit(EXIT_FAILURE);
+            }
+            Logging::setLevel(level);
+        }
+        else if(string(argv[i]) == "--profile" && i + 1 < argc)
+        {
+            profile_file = argv[++i];
+        }
+        else if(string(argv[i]) == "--trace" && i + 1 < argc)
+        {
+            trace_file = argv[++i];
+        }
+        else
+        {
+            testing_set_file = argv[i];
+        }
+    }
+
+    if(testing_set_file.empty() || !config.isValid())
+    {
+        cout << "Usage: run_test_set [--no-display] [--config file] [--set name=value] [--sweep grid_file [--output results.csv|.json]] [--log-level level] [--profile file.json] [--trace file.json] [testing_set_file]" << endl;
         exit(EXIT_FAILURE);
     }
 
     //current file: "/home/loris/Documents/EPFL/Master/master-project-2019/Data/TestingSet/ConC_test_list.txt"
-    string testing_set_file = argv[1];
 
     if(!parseTestingFile(testing_set_file))
     {
@@ -131,13 +186,52 @@ int main(int argc, char *argv[])
         exit(EXIT_FAILURE);
     }
 
+    // Timers and counters are only recorded if their results are written
+    Profiler::get().setEnabled(!profile_file.empty() || !trace_file.empty());
+
+    // Sweep mode: every testing set is aligned with every configuration of the grid, the table replaces the display
+    if(!sweep_file.empty())
+    {
+        ParameterSweep sweep;
+        if(!sweep.load(sweep_file)) exit(EXIT_FAILURE);
+
+        vector<AlignmentConfig> configs = sweep.getConfigs(config);
+        for(size_t c = 0; c < configs.size(); ++c)
+        {
+            if(!configs[c].isValid())
+            {
+                cout << "Configuration " << c << " of the grid is invalid" << endl;
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        vector<SweepRun, Eigen::aligned_allocator<SweepRun>> runs;
+        for(size_t i = 0; i < testing_set.size(); ++i)
+        {
+            testing_set[i].setConfig(config);
+            testing_set[i].runSweep(configs, i, runs);
+        }
+
+        if(!profile_file.empty()) Profiler::get().save(profile_file, false);
+        if(!trace_file.empty()) Profiler::get().save(trace_file, true);
+
+        return sweep.writeTable(sweep_output, configs, runs) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
     // Launch the tests for all testing set
     for(size_t i = 0; i < testing_set.size(); ++i)
     {
+        testing_set[i].setConfig(config);
         testing_set[i].runTests();
         testing_set[i].writeResults(i);
     }
 
+    if(!profile_file.empty()) Profiler::get().save(profile_file, false);
+    if(!trace_file.empty()) Profiler::get().save(trace_file, true);
+
+    // On headless machines, the results files are enough
+    if(!display) return EXIT_SUCCESS;
+
     // Display final alignments
     p_viewer = pcl::visualization::PCLVisualizer::Ptr(new pcl::visualization::PCLVisualizer("PointCloud Viewer"));
     p_viewer->initCameraParameters();
@@ -0,0 +1,121 @@
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <time.h>
+
+#include "common.h"
+#include "preprocessing_cache.h"
+#include "tiled_segmentation.h"
+
+using namespace std;
+
+/// Plane segmentation of clouds too large to be loaded at once. The cloud is streamed and segmented tile by tile,
+/// the result can then be opened in the viewer or given to align as an already segmented cloud.
+
+int main(int argc, char *argv[])
+{
+    AlignmentConfig config;
+    bool resample = true;
+    int nb_seeds = 1;
+    string profile_file, trace_file;
+    vector<string> args;
+
+    for(int i = 1; i < argc; ++i)
+    {
+        string arg = argv[i];
+
+        if(arg == "--tile-size" && i + 1 < argc)
+        {
+            config.tile_size = atof(argv[++i]);
+        }
+        else if(arg == "--halo" && i + 1 < argc)
+        {
+            config.tile_halo = atof(argv[++i]);
+        }
+        else if(arg == "--no-resample")
+        {
+            resample = false;
+        }
+        else if(arg == "--leaf-size" && i + 1 < argc)
+        {
+            config.leaf_size = atof(argv[++i]);
+        }
+        else if(arg == "--config" && i + 1 < argc)
+        {
+            // Parameters are applied in the order of the arguments, --set may then override the file
+            if(!config.load(argv[++i])) exit(EXIT_FAILURE);
+        }
+        else if(arg == "--set" && i + 1 < argc)
+        {
+            if(!config.setArgument(argv[++i])) exit(EXIT_FAILURE);
+        }
+        else if(arg == "--cache" && i + 1 < argc)
+        {
+            // Normals, curvatures and k of clouds already preprocessed with the same parameters are read back
+            if(!PreprocessingCache::get().setDirectory(argv[++i])) exit(EXIT_FAILURE);
+        }
+        else if(arg == "--parallel-seeds" && i + 1 < argc)
+        {
+            // 0 grows as many seeds as there are threads
+            nb_seeds = atoi(argv[++i]);
+            if(nb_seeds == 0) nb_seeds = omp_get_max_threads();
+        }
+        else if(arg == "--log-level" && i + 1 < argc)
+        {
+            int level = Logging::parseLevel(argv[++i]);
+            if(level == -1)
+            {
+                cout << "Unknown log level " << argv[i] << endl;
+                exit(EXIT_FAILURE);
+            }
+            Logging::setLevel(level);
+        }
+        else if(arg == "--profile" && i + 1 < argc)
+        {
+            profile_file = argv[++i];
+        }
+        else if(arg == "--trace" && i + 1 < argc)
+        {
+            trace_file = argv[++i];
+        }
+        else
+        {
+            args.push_back(arg);
+        }
+    }
+
+    if(args.size() != 2 || !config.isValid())
+    {
+        cout << "Usage: segmentTiles [--tile-size S] [--halo H] [--no-resample] [--leaf-size L] [--config file] [--set name=value] [--cache directory] [--parallel-seeds N] [--log-level level] [--profile file.json] [--trace file.json] [input_file] [output_file.pcd]" << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    // Timers and counters are only recorded if their results are written
+    Profiler::get().setEnabled(!profile_file.empty() || !trace_file.empty());
+
+    struct timespec start, finish;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    TiledSegmentation segmentation(config.tile_size, config.tile_halo, config.tile_stitch_band);
+    segmentation.setConfig(config);
+    segmentation.setResample(resample);
+    segmentation.setNbParallelSeeds(nb_seeds);
+
+    if(segmentation.segment(args[0], args[1]) == EXIT_FAILURE)
+    {
+        cerr << "Tiled segmentation of " << args[0] << " failed" << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &finish);
+    double elapsed = (finish.tv_sec - start.tv_sec);
+    elapsed += (finish.tv_nsec - start.tv_nsec) / 1000000000.0;
+
+    cout << "Segmented " << segmentation.getNbPoints() << " points in " << segmentation.getNbPlanes() << " planes in " << elapsed << " seconds." << endl;
+
+    if(!profile_file.empty()) Profiler::get().save(profile_file, false);
+    if(!trace_file.empty()) Profiler::get().save(trace_file, true);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,251 @@
+#include "alignment_config.h"
+
+#include <sstream>
+#include <limits>
+
+const vector<AlignmentConfig::Parameter> &AlignmentConfig::getParameters()
+{
+    static const vector<Parameter> parameters = {
+        {"leaf_size", PREPROCESSING, &AlignmentConfig::leaf_size, nullptr},
+        {"max_k_original", PREPROCESSING, nullptr, &AlignmentConfig::max_k_original},
+        {"max_k_resampled", PREPROCESSING, nullptr, &AlignmentConfig::max_k_resampled},
+        {"min_k", PREPROCESSING, nullptr, &AlignmentConfig::min_k},
+        {"neighbor_search", PREPROCESSING, nullptr, &AlignmentConfig::neighbor_search},
+        {"morton_order", PREPROCESSING, nullptr, &AlignmentConfig::morton_order},
+        {"max_curvature", CLOUD_SEGMENTATION, &AlignmentConfig::max_curvature, nullptr},
+        {"max_normal_angle", CLOUD_SEGMENTATION, &AlignmentConfig::max_normal_angle, nullptr},
+        {"plane_treshold", CLOUD_SEGMENTATION, &AlignmentConfig::plane_treshold, nullptr},
+        {"phase1_iterations", CLOUD_SEGMENTATION, nullptr, &AlignmentConfig::phase1_iterations},
+        {"min_stable_size", CLOUD_SEGMENTATION, nullptr, &AlignmentConfig::min_stable_size},
+        {"min_plane_size", CLOUD_SEGMENTATION, nullptr, &AlignmentConfig::min_plane_size},
+        {"max_iterations", CLOUD_SEGMENTATION, nullptr, &AlignmentConfig::max_iterations},
+        {"min_seed_distance", CLOUD_SEGMENTATION, &AlignmentConfig::min_seed_distance, nullptr},
+        {"tile_size", TILING, &AlignmentConfig::tile_size, nullptr},
+        {"tile_halo", TILING, &AlignmentConfig::tile_halo, nullptr},
+        {"tile_stitch_band", TILING, &AlignmentConfig::tile_stitch_band, nullptr},
+        {"knn", CLOUD_MERGING, nullptr, &AlignmentConfig::knn},
+        {"normal_error", CLOUD_MERGING, &AlignmentConfig::normal_error, nullptr},
+        {"distance_error", CLOUD_MERGING, &AlignmentConfig::distance_error, nullptr},
+        {"overlap_angle", CLOUD_MERGING, &AlignmentConfig::overlap_angle, nullptr},
+        {"knn_mesh", MESH_SEGMENTATION, nullptr, &AlignmentConfig::knn_mesh},
+        {"mesh_normal_error", MESH_SEGMENTATION, &AlignmentConfig::mesh_normal_error, nullptr},
+        {"v_error", MESH_SEGMENTATION, &AlignmentConfig::v_error, nullptr},
+        {"min_surface", MESH_SEGMENTATION, &AlignmentConfig::min_surface, nullptr},
+        {"std_dev_mult", REGISTRATION, &AlignmentConfig::std_dev_mult, nullptr},
+        {"center_knn", REGISTRATION, nullptr, &AlignmentConfig::center_knn},
+        {"surface_interval", REGISTRATION, &AlignmentConfig::surface_interval, nullptr}
+    };
+
+    return parameters;
+}
+
+bool AlignmentConfig::load(string filename)
+{
+    ifstream file(filename);
+    if(!file.is_open())
+    {
+        LOG(ERROR) << "Could not open configuration file " << filename;
+        return false;
+    }
+
+    string line;
+    int line_nb = 0;
+
+    while(getline(file, line))
+    {
+        line_nb++;
+        line = line.substr(0, line.find('#'));
+
+        size_t equal = line.find('=');
+        stringstream ss(line);
+        string name, value;
+
+        if(equal == string::npos)
+        {
+            // Only blank lines and comments may have no assignment
+            if(ss >> name)
+            {
+                LOG(ERROR) << "Error at line " << line_nb << " of " << filename << ": expected \"name = value\"";
+                return false;
+            }
+            continue;
+        }
+
+        stringstream(line.substr(0, equal)) >> name;
+        stringstream(line.substr(equal + 1)) >> value;
+
+        if(!set(name, value))
+        {
+            LOG(ERROR) << "Error at line " << line_nb << " of " << filename;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool AlignmentConfig::set(string name, string value)
+{
+    for(const Parameter &parameter: getParameters())
+    {
+        if(name != parameter.name) continue;
+
+        size_t parsed = 0;
+        try
+        {
+            if(parameter.p_float != nullptr)
+            {
+                this->*parameter.p_float = stof(value, &parsed);
+            }
+            else
+            {
+                this->*parameter.p_int = stoi(value, &parsed);
+            }
+        }
+        catch(const logic_error &)
+        {
+            parsed = 0;
+        }
+
+        if(parsed == 0 || parsed != value.size())
+        {
+            LOG(ERROR) << "Invalid value \"" << value << "\" for parameter " << name;
+            return false;
+        }
+
+        return true;
+    }
+
+    LOG(ERROR) << "Unknown parameter " << name;
+    return false;
+}
+
+bool AlignmentConfig::setArgument(string argument)
+{
+    size_t equal = argument.find('=');
+    if(equal == string::npos)
+    {
+        LOG(ERROR) << "Expected name=value instead of " << argument;
+        return false;
+    }
+
+    return set(argument.substr(0, equal), argument.substr(equal + 1));
+}
+
+bool AlignmentConfig::isValid() const
+{
+    vector<pair<const char*, bool>> checks = {
+        {"leaf_size must be positive", leaf_size > 0},
+        {"min_k must be positive", min_k > 0},
+        {"min_k must not exceed max_k_resampled", min_k <= max_k_resampled},
+        {"max_k_resampled must not exceed max_k_original", max_k_resampled <= max_k_original},
+        {"max_k_original must not exceed 255, k is stored on 8 bits", max_k_original <= 255},
+        {"max_k_resampled must not exceed 255, k is stored on 8 bits", max_k_resampled <= 255},
+        {"neighbor_search must be 0 (kdtree) or 1 (grid)", neighbor_search == 0 || neighbor_search == 1},
+        {"morton_order must be 0 or 1", morton_order == 0 || morton_order == 1},
+        {"phase1_iterations must be positive", phase1_iterations > 0},
+        {"max_iterations must exceed phase1_iterations", max_iterations > phase1_iterations},
+        {"min_seed_distance must be positive", min_seed_distance > 0},
+        {"tile_size must be positive", tile_size > 0},
+        {"tile_halo must not be negative", tile_halo >= 0},
+        {"knn must be positive", knn > 0},
+        {"knn_mesh must be positive", knn_mesh > 0},
+        {"center_knn must be positive", center_knn > 0}
+    };
+
+    for(const auto &check: checks)
+    {
+        if(!check.second)
+        {
+            LOG(ERROR) << "Invalid configuration: " << check.first;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+string AlignmentConfig::get(string name) const
+{
+    for(const Parameter &parameter: getParameters())
+    {
+        if(name != parameter.name) continue;
+
+        stringstream ss;
+        if(parameter.p_float != nullptr)
+        {
+            ss << this->*parameter.p_float;
+        }
+        else
+        {
+            ss << this->*parameter.p_int;
+        }
+        return ss.str();
+    }
+
+    return "";
+}
+
+int AlignmentConfig::getStage(string name)
+{
+    for(const Parameter &parameter: getParameters())
+    {
+        if(name == parameter.name) return parameter.stage;
+    }
+
+    return 0;
+}
+
+string AlignmentConfig::getKey(int stages) const
+{
+    // Every digit is kept, so that close values never share a key
+    stringstream ss;
+    ss.precision(numeric_limits<float>::max_digits10);
+
+    for(const Parameter &parameter: getParameters())
+    {
+        if(!(parameter.stage & stages)) continue;
+
+        ss << parameter.name << "=";
+        if(parameter.p_float != nullptr)
+        {
+            ss << this->*parameter.p_float << ";";
+        }
+        else
+        {
+            ss << this->*parameter.p_int << ";";
+        }
+    }
+
+    return ss.str();
+}
+
+void AlignmentConfig::write(ostream &out) const
+{
+    for(const Parameter &parameter: getParameters())
+    {
+        out << parameter.name << " = ";
+        if(parameter.p_float != nullptr)
+        {
+            out << this->*parameter.p_float << endl;
+        }
+        else
+        {
+            out << this->*parameter.p_int << endl;
+        }
+    }
+}
+
+bool AlignmentConfig::save(string filename) const
+{
+    ofstream out(filename, ios::out | ios::trunc);
+    if(!out.is_open())
+    {
+        LOG(ERROR) << "Could not write configuration in " << filename;
+        return false;
+    }
+
+    write(out);
+
+    return out.good();
+}
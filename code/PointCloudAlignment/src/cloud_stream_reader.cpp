@@ -0,0 +1,378 @@
+#include "cloud_stream_reader.h"
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+bool CloudStreamReader::open(string filename)
+{
+    close();
+    this->filename = filename;
+
+    file.open(filename, ios::in | ios::binary);
+    if(!file.is_open())
+    {
+        LOG(ERROR) << "Could not open " << filename;
+        return false;
+    }
+
+    string magic;
+    getline(file, magic);
+    if(!magic.empty() && magic.back() == '\r') magic.pop_back();
+
+    bool parsed;
+    if(magic == "ply")
+    {
+        parsed = parsePLYHeader();
+    }
+    else
+    {
+        // PCD files may start with comments, the header is parsed from the beginning
+        file.seekg(0);
+        parsed = parsePCDHeader();
+    }
+
+    if(!parsed || !findCoordinates())
+    {
+        close();
+        return false;
+    }
+
+    data_start = file.tellg();
+    nb_read = 0;
+
+    return true;
+}
+
+void CloudStreamReader::close()
+{
+    if(file.is_open()) file.close();
+    file.clear();
+    fields.clear();
+    nb_points = 0;
+    nb_read = 0;
+    record_size = 0;
+    nb_columns = 0;
+}
+
+bool CloudStreamReader::hasField(string name) const
+{
+    return find_if(fields.begin(), fields.end(), [&name](const Field &field){ return field.name == name; }) != fields.end();
+}
+
+bool CloudStreamReader::rewind()
+{
+    if(!file.is_open()) return false;
+
+    file.clear();
+    file.seekg(data_start);
+    nb_read = 0;
+
+    return file.good();
+}
+
+size_t CloudStreamReader::read(vector<vec3> &points, size_t max_points)
+{
+    points.clear();
+
+    if(!file.is_open() || nb_read >= nb_points) return 0;
+
+    size_t nb_to_read = std::min(max_points, nb_points - nb_read);
+    points.reserve(nb_to_read);
+
+    if(is_binary)
+    {
+        vector<char> buffer(nb_to_read * record_size);
+        file.read(buffer.data(), buffer.size());
+        nb_to_read = file.gcount() / record_size;
+
+        for(size_t i = 0; i < nb_to_read; ++i)
+        {
+            const char *record = buffer.data() + i * record_size;
+            points.push_back(vec3(decode(record + offsets[0], xyz_fields[0]),
+                                  decode(record + offsets[1], xyz_fields[1]),
+                                  decode(record + offsets[2], xyz_fields[2])));
+        }
+    }
+    else
+    {
+        string line;
+        vector<double> values(nb_columns);
+
+        while(points.size() < nb_to_read && getline(file, line))
+        {
+            const char *c = line.c_str();
+            char *end;
+            size_t nb_values = 0;
+
+            while(nb_values < nb_columns)
+            {
+                double v = strtod(c, &end);
+                if(end == c) break;
+                values[nb_values++] = v;
+                c = end;
+            }
+
+            // Empty lines are skipped
+            if(nb_values == 0) continue;
+
+            if(nb_values < nb_columns)
+            {
+                LOG(ERROR) << "Malformed point in " << filename << ": " << line;
+                nb_points = nb_read + points.size();
+                break;
+            }
+
+            points.push_back(vec3(values[columns[0]], values[columns[1]], values[columns[2]]));
+        }
+    }
+
+    if(points.size() < nb_to_read && nb_read + points.size() < nb_points)
+    {
+        LOG(ERROR) << "Unexpected end of file " << filename << " after " << nb_read + points.size() << " points.";
+        nb_points = nb_read + points.size();
+    }
+
+    nb_read += points.size();
+
+    return points.size();
+}
+
+bool CloudStreamReader::parsePLYHeader()
+{
+    string line;
+    bool in_vertex = false;
+    bool vertex_found = false;
+
+    while(getline(file, line))
+    {
+        if(!line.empty() && line.back() == '\r') line.pop_back();
+
+        istringstream ss(line);
+        string keyword;
+        ss >> keyword;
+
+        if(keyword == "format")
+        {
+            string format;
+            ss >> format;
+
+            if(format == "ascii")
+            {
+                is_binary = false;
+            }
+            else if(format == "binary_little_endian")
+            {
+                is_binary = true;
+            }
+            else
+            {
+                LOG(ERROR) << "Unsupported PLY format " << format << " in " << filename;
+                return false;
+            }
+        }
+        else if(keyword == "element")
+        {
+            string name;
+            size_t count;
+            ss >> name >> count;
+
+            in_vertex = name == "vertex";
+
+            if(in_vertex)
+            {
+                nb_points = count;
+                vertex_found = true;
+            }
+            else if(!vertex_found)
+            {
+                // The points would have to be found after the data of this element
+                LOG(ERROR) << "Unsupported PLY file " << filename << ": vertex must be the first element.";
+                return false;
+            }
+        }
+        else if(keyword == "property" && in_vertex)
+        {
+            string type, name;
+            ss >> type >> name;
+
+            if(type == "list")
+            {
+                LOG(ERROR) << "Unsupported list property in the vertices of " << filename;
+                return false;
+            }
+
+            Field field;
+            field.name = name;
+            field.count = 1;
+
+            if(!parsePLYType(type, field))
+            {
+                LOG(ERROR) << "Unknown PLY type " << type << " in " << filename;
+                return false;
+            }
+
+            fields.push_back(field);
+        }
+        else if(keyword == "end_header")
+        {
+            return vertex_found;
+        }
+    }
+
+    LOG(ERROR) << "Missing end_header in " << filename;
+    return false;
+}
+
+bool CloudStreamReader::parsePCDHeader()
+{
+    string line;
+    size_t width = 0, height = 1;
+    bool points_found = false;
+
+    while(getline(file, line))
+    {
+        if(!line.empty() && line.back() == '\r') line.pop_back();
+        if(line.empty() || line[0] == '#') continue;
+
+        istringstream ss(line);
+        string keyword;
+        ss >> keyword;
+
+        if(keyword == "FIELDS")
+        {
+            string name;
+            while(ss >> name)
+            {
+                Field field;
+                field.name = name;
+                field.type = 'F';
+                field.size = 4;
+                field.count = 1;
+                fields.push_back(field);
+            }
+        }
+        else if(keyword == "SIZE")
+        {
+            for(Field &field: fields) ss >> field.size;
+        }
+        else if(keyword == "TYPE")
+        {
+            for(Field &field: fields) ss >> field.type;
+        }
+        else if(keyword == "COUNT")
+        {
+            for(Field &field: fields) ss >> field.count;
+        }
+        else if(keyword == "WIDTH")
+        {
+            ss >> width;
+        }
+        else if(keyword == "HEIGHT")
+        {
+            ss >> height;
+        }
+        else if(keyword == "POINTS")
+        {
+            ss >> nb_points;
+            points_found = true;
+        }
+        else if(keyword == "DATA")
+        {
+            string format;
+            ss >> format;
+
+            if(!points_found) nb_points = width * height;
+
+            if(format == "ascii")
+            {
+                is_binary = false;
+            }
+            else if(format == "binary")
+            {
+                is_binary = true;
+            }
+            else
+            {
+                LOG(ERROR) << "Unsupported PCD data format " << format << " in " << filename;
+                return false;
+            }
+
+            return !fields.empty();
+        }
+    }
+
+    LOG(ERROR) << "Could not read the header of " << filename;
+    return false;
+}
+
+bool CloudStreamReader::findCoordinates()
+{
+    const string names[3] = {"x", "y", "z"};
+    bool found[3] = {false, false, false};
+    size_t offset = 0, column = 0;
+
+    for(Field &field: fields)
+    {
+        for(int i = 0; i < 3; ++i)
+        {
+            if(field.name == names[i])
+            {
+                offsets[i] = offset;
+                columns[i] = column;
+                xyz_fields[i] = field;
+                found[i] = true;
+            }
+        }
+
+        offset += field.size * field.count;
+        column += field.count;
+    }
+
+    record_size = offset;
+    nb_columns = column;
+
+    if(!found[0] || !found[1] || !found[2])
+    {
+        LOG(ERROR) << "No x, y and z fields in " << filename;
+        return false;
+    }
+
+    return true;
+}
+
+bool CloudStreamReader::parsePLYType(string type, Field &field)
+{
+    if(type == "char" || type == "int8") { field.type = 'I'; field.size = 1; }
+    else if(type == "uchar" || type == "uint8") { field.type = 'U'; field.size = 1; }
+    else if(type == "short" || type == "int16") { field.type = 'I'; field.size = 2; }
+    else if(type == "ushort" || type == "uint16") { field.type = 'U'; field.size = 2; }
+    else if(type == "int" || type == "int32") { field.type = 'I'; field.size = 4; }
+    else if(type == "uint" || type == "uint32") { field.type = 'U'; field.size = 4; }
+    else if(type == "float" || type == "float32") { field.type = 'F'; field.size = 4; }
+    else if(type == "double" || type == "float64") { field.type = 'F'; field.size = 8; }
+    else return false;
+
+    return true;
+}
+
+double CloudStreamReader::decode(const char *data, const Field &field)
+{
+    // Binary files are little endian, as the machines this code runs on.
+    switch(field.type)
+    {
+    case 'F':
+        if(field.size == 8) { double v; memcpy(&v, data, 8); return v; }
+        { float v; memcpy(&v, data, 4); return v; }
+    case 'I':
+        if(field.size == 1) { int8_t v; memcpy(&v, data, 1); return v; }
+        if(field.size == 2) { int16_t v; memcpy(&v, data, 2); return v; }
+        if(field.size == 8) { int64_t v; memcpy(&v, data, 8); return v; }
+        { int32_t v; memcpy(&v, data, 4); return v; }
+    default:
+        if(field.size == 1) { uint8_t v; memcpy(&v, data, 1); return v; }
+        if(field.size == 2) { uint16_t v; memcpy(&v, data, 2); return v; }
+        if(field.size == 8) { uint64_t v; memcpy(&v, data, 8); return v; }
+        { uint32_t v; memcpy(&v, data, 4); return v; }
+    }
+}
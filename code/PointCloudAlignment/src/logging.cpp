@@ -0,0 +1,27 @@
+#include "logging.h"
+
+atomic<int> Logging::level(PCA_LOG_INFO);
+mutex Logging::output_mutex;
+
+int Logging::parseLevel(string name)
+{
+    const string names[] = {"trace", "debug", "info", "warning", "error"};
+
+    for(int l = PCA_LOG_TRACE; l <= PCA_LOG_ERROR; ++l)
+    {
+        if(name == names[l]) return l;
+    }
+
+    return -1;
+}
+
+Logging::Line::~Line()
+{
+    ss << '\n';
+    string line = ss.str();
+
+    lock_guard<mutex> lock(output_mutex);
+    cout.write(line.data(), static_cast<streamsize>(line.size()));
+
+    if(level >= PCA_LOG_WARNING) cout.flush();
+}
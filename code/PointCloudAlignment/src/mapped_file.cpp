@@ -0,0 +1,39 @@
+#include "mapped_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool MappedFile::open(string filename)
+{
+    close();
+
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if(fd == -1) return false;
+
+    struct stat st;
+    if(fstat(fd, &st) == -1 || st.st_size == 0)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    void *p = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    // The mapping stays valid once the descriptor is closed
+    ::close(fd);
+
+    if(p == MAP_FAILED) return false;
+
+    data = static_cast<char*>(p);
+    size = st.st_size;
+
+    return true;
+}
+
+void MappedFile::close()
+{
+    if(data != nullptr) munmap(data, size);
+    data = nullptr;
+    size = 0;
+}
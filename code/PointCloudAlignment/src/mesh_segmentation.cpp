@@ -6,11 +6,11 @@ bool MeshSegmentation::loadMesh(string filename)
 
     if(pcl::io::loadPolygonFilePLY(filename, *p_mesh) == -1)
     {
-        cout << "Failed to load given file" << endl;
+        LOG(ERROR) << "Failed to load given file";
         return false;
     }
 
-    cout << "Loaded mesh " << filename << endl;
+    LOG(INFO) << "Loaded mesh " << filename;
 
     // Converting PolygonMesh->cloud to PointCloud<pcl::PointXYZ>
     p_cloud = pcl::PointCloud<pcl::PointXYZRGB>::Ptr(new pcl::PointCloud<pcl::PointXYZRGB>);
@@ -31,6 +31,8 @@ bool MeshSegmentation::loadMesh(pcl::PolygonMeshPtr mesh_ptr)
 
 void MeshSegmentation::segmentPlanes()
 {
+    PROFILE_SCOPE("mesh_segmentation");
+
     ivec3 color(0, 0, 0);
 
     for (size_t i = 0; i < p_mesh->polygons.size(); ++i)
@@ -58,11 +60,69 @@ void MeshSegmentation::segmentPlanes()
         }
     }
 
-    cout << "Plane segmentation of mesh finished first phase." << endl;
+    orientPlanes();
+
+    LOG(INFO) << "Plane segmentation of mesh finished first phase.";
+}
+
+void MeshSegmentation::orientPlanes()
+{
+    if(planes.empty()) return;
+
+    int k = std::min(config.knn_mesh, static_cast<int>(planes.size()));
+
+    // Each face is a point at its centroid, the normals keep their norm (the surface of the face) in the planes
+    PointNormalKCloud::Ptr p_faces(new PointNormalKCloud);
+    p_faces->resize(planes.size());
+    for(size_t i = 0; i < planes.size(); ++i)
+    {
+        vec3 c = planes[i].plane.getCenter();
+        vec3 n = planes[i].plane.getNormalizedN();
+        PointNormalK &p = p_faces->points[i];
+        p.x = c.x();
+        p.y = c.y();
+        p.z = c.z();
+        p.normal_x = n.x();
+        p.normal_y = n.y();
+        p.normal_z = n.z();
+        p.k = k;
+    }
+
+    NeighborSearch::Ptr p_search = NeighborSearch::create(NeighborSearch::KDTREE);
+    p_search->setInputCloud(p_faces);
+
+    NeighborGraph graph;
+    graph.allocate(*p_faces);
+
+    #pragma omp parallel
+    {
+        vector<int> indices;
+        vector<float> sqr_distances;
+
+        #pragma omp for
+        for(size_t i = 0; i < p_faces->size(); ++i)
+        {
+            p_search->nearestKSearch(p_faces->points[i], k, indices, sqr_distances);
+            graph.setRow(i, indices, sqr_distances);
+        }
+    }
+
+    graph.makeSymmetric();
+
+    NormalOrientation().orient(*p_faces, graph);
+
+    for(size_t i = 0; i < planes.size(); ++i)
+    {
+        const PointNormalK &p = p_faces->points[i];
+        vec3 n = planes[i].plane.getNormal();
+        if(n.dot(vec3(p.normal_x, p.normal_y, p.normal_z)) < 0) planes[i].plane.setNormal(-n);
+    }
 }
 
 void MeshSegmentation::mergePlanes()
 {
+    PROFILE_SCOPE("mesh_merging");
+
     if(planes.empty()) return;
 
     p_available_indices = boost::shared_ptr<vector<int>>(new vector<int>);
@@ -84,14 +144,14 @@ void MeshSegmentation::mergePlanes()
     // Removing merged planes from planes list, and planes with small surface
     vector<SegmentedPointsContainer::SegmentedPlane> final_planes;
     for_each(p_available_indices->begin(), p_available_indices->end(), [&final_planes, this](int index){
-        if(planes[index].plane.getNormal().norm() > MIN_SURFACE)
+        if(planes[index].plane.getNormal().norm() > config.min_surface)
         {
             final_planes.push_back(planes[index]);
         }
     });
     planes.swap(final_planes);
 
-    cout << "Finished mesh planes merging" << endl;
+    LOG(INFO) << "Finished mesh planes merging";
 
     //Update colors in pc
     updatePCcolors();
@@ -110,9 +170,9 @@ void MeshSegmentation::mergeRecursive()
             SegmentedPointsContainer::SegmentedPlane plane = planes[p_available_indices->at(i)];
 
             // Do a knn search on neighboring centroids
-            vector<int> nghbrs(KNN_MESH);
-            vector<float> dists(KNN_MESH);
-            p_kdTree->nearestKSearch(plane.plane.getCenterPCL(), KNN_MESH, nghbrs, dists);
+            vector<int> nghbrs(config.knn_mesh);
+            vector<float> dists(config.knn_mesh);
+            p_kdTree->nearestKSearch(plane.plane.getCenterPCL(), config.knn_mesh, nghbrs, dists);
 
             for(size_t j = 1; j < nghbrs.size(); ++j)
             {
@@ -143,7 +203,7 @@ void MeshSegmentation::mergeRecursive()
 
     p_kdTree->setInputCloud(p_centroid_cloud, p_available_indices);
 
-    cout << "Finishing one level of merge. Available indices: " << p_available_indices->size() << ", merged planes: " << merged_planes.size() << endl;
+    LOG(DEBUG) << "Finishing one level of merge. Available indices: " << p_available_indices->size() << ", merged planes: " << merged_planes.size();
 
     if(merged_planes.size() > 0){
         mergeRecursive();
@@ -158,7 +218,7 @@ bool MeshSegmentation::planesAreMergeable(SegmentedPointsContainer::SegmentedPla
     // may need to reorient normal
     n2  = n2.dot(n1) < 0.0f ? -n2 : n2;
 
-    return (n2.dot(n1) >= MESH_NORMAL_ERROR) && haveCommonVertex(p1, p2);
+    return (n2.dot(n1) >= config.mesh_normal_error) && haveCommonVertex(p1, p2);
 }
 
 bool MeshSegmentation::haveCommonVertex(SegmentedPointsContainer::SegmentedPlane &p1, SegmentedPointsContainer::SegmentedPlane &p2)
@@ -167,7 +227,7 @@ bool MeshSegmentation::haveCommonVertex(SegmentedPointsContainer::SegmentedPlane
     {
         for(auto j: p2.indices_list)
         {
-            if(squaredDistance(pclToVec3(p_cloud->points[i]), pclToVec3(p_cloud->points[j])) <= V_ERROR) return true;
+            if(squaredDistance(pclToVec3(p_cloud->points[i]), pclToVec3(p_cloud->points[j])) <= config.v_error) return true;
         }
     }
 
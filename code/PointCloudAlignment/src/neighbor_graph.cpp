@@ -0,0 +1,262 @@
+#include "neighbor_graph.h"
+
+#include <cstring>
+
+void NeighborGraph::allocate(const PointNormalKCloud &cloud)
+{
+    offsets.resize(cloud.size() + 1);
+    offsets[0] = 0;
+
+    for(size_t i = 0; i < cloud.size(); ++i)
+    {
+        size_t k = std::min(static_cast<size_t>(cloud.points[i].k), cloud.size());
+        offsets[i + 1] = offsets[i] + k;
+    }
+
+    neighbors.resize(offsets.back());
+    sqr_distances.clear();
+    if(keep_distances) sqr_distances.resize(offsets.back());
+}
+
+void NeighborGraph::setRow(size_t i, const vector<int> &indices, const vector<float> &sqr_distances)
+{
+    size_t k = offsets[i + 1] - offsets[i];
+    copy(indices.begin(), indices.begin() + k, neighbors.begin() + offsets[i]);
+
+    if(hasDistances())
+    {
+        copy(sqr_distances.begin(), sqr_distances.begin() + k, this->sqr_distances.begin() + offsets[i]);
+    }
+}
+
+void NeighborGraph::makeSymmetric()
+{
+    size_t nb_points = size();
+
+    // Edges whose reverse is missing from the row of their target
+    vector<char> is_one_way(neighbors.size(), 0);
+
+    #pragma omp parallel for
+    for(size_t i = 0; i < nb_points; ++i)
+    {
+        for(uint64_t e = offsets[i]; e < offsets[i + 1]; ++e)
+        {
+            int j = neighbors[e];
+            is_one_way[e] = find(rowBegin(j), rowEnd(j), static_cast<int>(i)) == rowEnd(j);
+        }
+    }
+
+    vector<uint64_t> nb_added(nb_points + 1, 0);
+    vector<pair<int, uint64_t>> reverse_edges;
+
+    for(uint64_t e = 0; e < neighbors.size(); ++e)
+    {
+        if(is_one_way[e])
+        {
+            reverse_edges.push_back(make_pair(neighbors[e], e));
+            nb_added[neighbors[e] + 1]++;
+        }
+    }
+
+    if(reverse_edges.empty()) return;
+
+    // Rows are sorted by point, the reverse edges keep the order of their source point
+    stable_sort(reverse_edges.begin(), reverse_edges.end(), [](const pair<int, uint64_t> &a, const pair<int, uint64_t> &b){
+        return a.first < b.first;
+    });
+
+    vector<uint64_t> new_offsets(nb_points + 1, 0);
+    for(size_t i = 0; i < nb_points; ++i)
+    {
+        new_offsets[i + 1] = new_offsets[i] + (offsets[i + 1] - offsets[i]) + nb_added[i + 1];
+    }
+
+    vector<int> new_neighbors(new_offsets.back());
+    vector<float> new_distances(hasDistances() ? new_offsets.back() : 0);
+
+    // Source point of every edge, to write the reverse ones
+    vector<int> edge_sources(neighbors.size());
+    for(size_t i = 0; i < nb_points; ++i)
+    {
+        fill(edge_sources.begin() + offsets[i], edge_sources.begin() + offsets[i + 1], static_cast<int>(i));
+    }
+
+    size_t r = 0;
+    for(size_t i = 0; i < nb_points; ++i)
+    {
+        uint64_t out = new_offsets[i];
+        for(uint64_t e = offsets[i]; e < offsets[i + 1]; ++e, ++out)
+        {
+            new_neighbors[out] = neighbors[e];
+            if(hasDistances()) new_distances[out] = sqr_distances[e];
+        }
+
+        for(; r < reverse_edges.size() && reverse_edges[r].first == static_cast<int>(i); ++r, ++out)
+        {
+            uint64_t e = reverse_edges[r].second;
+            new_neighbors[out] = edge_sources[e];
+            if(hasDistances()) new_distances[out] = sqr_distances[e];
+        }
+    }
+
+    offsets.swap(new_offsets);
+    neighbors.swap(new_neighbors);
+    sqr_distances.swap(new_distances);
+}
+
+void NeighborGraph::permute(const vector<int> &order)
+{
+    size_t nb_points = size();
+
+    vector<int> new_index(nb_points);
+    for(size_t i = 0; i < nb_points; ++i)
+    {
+        new_index[order[i]] = static_cast<int>(i);
+    }
+
+    vector<uint64_t> new_offsets(nb_points + 1, 0);
+    for(size_t i = 0; i < nb_points; ++i)
+    {
+        new_offsets[i + 1] = new_offsets[i] + (offsets[order[i] + 1] - offsets[order[i]]);
+    }
+
+    vector<int> new_neighbors(neighbors.size());
+    vector<float> new_distances(sqr_distances.size());
+
+    // Rows keep their order, neighbors sorted by distance stay sorted
+    #pragma omp parallel for
+    for(size_t i = 0; i < nb_points; ++i)
+    {
+        uint64_t out = new_offsets[i];
+        for(uint64_t e = offsets[order[i]]; e < offsets[order[i] + 1]; ++e, ++out)
+        {
+            new_neighbors[out] = new_index[neighbors[e]];
+            if(hasDistances()) new_distances[out] = sqr_distances[e];
+        }
+    }
+
+    offsets.swap(new_offsets);
+    neighbors.swap(new_neighbors);
+    sqr_distances.swap(new_distances);
+}
+
+void NeighborGraph::clear()
+{
+    offsets.clear();
+    neighbors.clear();
+    sqr_distances.clear();
+}
+
+bool NeighborGraph::save(string filename) const
+{
+    ofstream out(filename, ios::out | ios::binary | ios::trunc);
+    if(!out.is_open())
+    {
+        LOG(ERROR) << "Could not write neighbor graph in " << filename;
+        return false;
+    }
+
+    write(out);
+
+    return out.good();
+}
+
+bool NeighborGraph::load(string filename)
+{
+    clear();
+
+    MappedFile file;
+    if(!file.open(filename)) return false;
+
+    return read(file.getData(), file.getSize(), filename);
+}
+
+void NeighborGraph::write(ostream &out) const
+{
+    uint32_t version = VERSION;
+    uint32_t flags = hasDistances() ? HAS_DISTANCES : 0;
+    uint64_t nb_points = size();
+    uint64_t nb_edges = getNbEdges();
+
+    out.write(MAGIC, sizeof(MAGIC));
+    out.write(reinterpret_cast<const char*>(&version), sizeof(version));
+    out.write(reinterpret_cast<const char*>(&flags), sizeof(flags));
+    out.write(reinterpret_cast<const char*>(&nb_points), sizeof(nb_points));
+    out.write(reinterpret_cast<const char*>(&nb_edges), sizeof(nb_edges));
+
+    out.write(reinterpret_cast<const char*>(offsets.data()), offsets.size() * sizeof(uint64_t));
+    out.write(reinterpret_cast<const char*>(neighbors.data()), neighbors.size() * sizeof(int));
+    if(hasDistances())
+    {
+        out.write(reinterpret_cast<const char*>(sqr_distances.data()), sqr_distances.size() * sizeof(float));
+    }
+}
+
+bool NeighborGraph::read(const char *data, size_t size, string name)
+{
+    clear();
+
+    const size_t header_size = sizeof(MAGIC) + 2 * sizeof(uint32_t) + 2 * sizeof(uint64_t);
+    uint32_t version, flags;
+    uint64_t nb_points, nb_edges;
+
+    if(size < header_size || memcmp(data, MAGIC, sizeof(MAGIC)) != 0)
+    {
+        LOG(ERROR) << name << " is not a neighbor graph";
+        return false;
+    }
+
+    const char *p = data + sizeof(MAGIC);
+    memcpy(&version, p, sizeof(version));
+    memcpy(&flags, p + 4, sizeof(flags));
+    memcpy(&nb_points, p + 8, sizeof(nb_points));
+    memcpy(&nb_edges, p + 16, sizeof(nb_edges));
+    p = data + header_size;
+
+    if(version != VERSION)
+    {
+        LOG(ERROR) << name << " is not a neighbor graph of version " << VERSION;
+        return false;
+    }
+
+    // Sizes are checked against the remaining bytes before allocating
+    uint64_t data_size = size - header_size;
+    uint64_t edge_size = sizeof(int) + ((flags & HAS_DISTANCES) ? sizeof(float) : 0);
+    if(nb_points >= data_size / sizeof(uint64_t) || nb_edges > data_size / edge_size ||
+            (nb_points + 1) * sizeof(uint64_t) + nb_edges * edge_size != data_size)
+    {
+        LOG(ERROR) << name << " is truncated or corrupted";
+        return false;
+    }
+
+    offsets.resize(nb_points + 1);
+    neighbors.resize(nb_edges);
+    memcpy(offsets.data(), p, offsets.size() * sizeof(uint64_t));
+    p += offsets.size() * sizeof(uint64_t);
+    memcpy(neighbors.data(), p, neighbors.size() * sizeof(int));
+    p += neighbors.size() * sizeof(int);
+    if(flags & HAS_DISTANCES)
+    {
+        sqr_distances.resize(nb_edges);
+        memcpy(sqr_distances.data(), p, sqr_distances.size() * sizeof(float));
+    }
+
+    bool is_valid = offsets.front() == 0 && offsets.back() == nb_edges;
+    for(size_t i = 0; is_valid && i < nb_points; ++i)
+    {
+        is_valid = offsets[i] <= offsets[i + 1];
+    }
+    for(size_t i = 0; is_valid && i < nb_edges; ++i)
+    {
+        is_valid = neighbors[i] >= 0 && static_cast<uint64_t>(neighbors[i]) < nb_points;
+    }
+
+    if(!is_valid)
+    {
+        LOG(ERROR) << name << " is truncated or corrupted";
+        clear();
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,165 @@
+#include "neighbor_search.h"
+
+NeighborSearch::Ptr NeighborSearch::create(int backend)
+{
+    if(backend == GRID) return Ptr(new GridSearch);
+
+    return Ptr(new KdTreeSearch);
+}
+
+// =========================== // KdTreeSearch // ============================================== //
+
+void KdTreeSearch::setInputCloud(PointNormalKCloud::Ptr cloud, boost::shared_ptr<vector<int>> indices)
+{
+    if(indices)
+    {
+        p_kdtree->setInputCloud(cloud, indices);
+    }
+    else
+    {
+        p_kdtree->setInputCloud(cloud);
+    }
+}
+
+int KdTreeSearch::nearestKSearch(const PointNormalK &p, int k, vector<int> &k_indices, vector<float> &k_sqr_distances) const
+{
+    return p_kdtree->nearestKSearch(p, k, k_indices, k_sqr_distances);
+}
+
+// =========================== // GridSearch // ============================================== //
+
+void GridSearch::setInputCloud(PointNormalKCloud::Ptr cloud, boost::shared_ptr<vector<int>> indices)
+{
+    PROFILE_SCOPE("grid_build");
+
+    size_t nb_points = indices ? indices->size() : cloud->size();
+    auto getIndex = [&indices](size_t i) { return indices ? (*indices)[i] : static_cast<int>(i); };
+
+    points.clear();
+    cell_starts.assign(1, 0);
+    nb_cols = nb_rows = 0;
+
+    if(nb_points == 0) return;
+
+    vec2 min_xy(numeric_limits<float>::max(), numeric_limits<float>::max());
+    vec2 max_xy(numeric_limits<float>::lowest(), numeric_limits<float>::lowest());
+    for(size_t i = 0; i < nb_points; ++i)
+    {
+        const PointNormalK &p = cloud->points[getIndex(i)];
+        min_xy = min_xy.cwiseMin(vec2(p.x, p.y));
+        max_xy = max_xy.cwiseMax(vec2(p.x, p.y));
+    }
+
+    // Cells hold points_per_cell points on average, and there are never many more cells than points on thin clouds
+    vec2 extent = max_xy - min_xy;
+    cell_size = std::max(std::sqrt(extent.x() * extent.y() * points_per_cell / nb_points), extent.maxCoeff() * points_per_cell / nb_points);
+    if(!(cell_size > 0)) cell_size = 1;
+
+    origin = min_xy;
+    nb_cols = static_cast<int>(extent.x() / cell_size) + 1;
+    nb_rows = static_cast<int>(extent.y() / cell_size) + 1;
+
+    // Counting sort of the points by cell
+    vector<uint32_t> cells(nb_points);
+    cell_starts.assign(static_cast<size_t>(nb_cols) * nb_rows + 1, 0);
+    for(size_t i = 0; i < nb_points; ++i)
+    {
+        const PointNormalK &p = cloud->points[getIndex(i)];
+        cells[i] = static_cast<uint32_t>(getRow(p.y) * nb_cols + getCol(p.x));
+        cell_starts[cells[i] + 1]++;
+    }
+
+    partial_sum(cell_starts.begin(), cell_starts.end(), cell_starts.begin());
+
+    vector<uint32_t> next(cell_starts.begin(), cell_starts.end() - 1);
+    points.resize(nb_points);
+    for(size_t i = 0; i < nb_points; ++i)
+    {
+        int index = getIndex(i);
+        const PointNormalK &p = cloud->points[index];
+        points[next[cells[i]]++] = {p.x, p.y, p.z, index};
+    }
+}
+
+int GridSearch::getCol(float x) const
+{
+    return std::min(std::max(static_cast<int>(std::floor((x - origin.x()) / cell_size)), 0), nb_cols - 1);
+}
+
+int GridSearch::getRow(float y) const
+{
+    return std::min(std::max(static_cast<int>(std::floor((y - origin.y()) / cell_size)), 0), nb_rows - 1);
+}
+
+int GridSearch::nearestKSearch(const PointNormalK &p, int k, vector<int> &k_indices, vector<float> &k_sqr_distances) const
+{
+    k_indices.clear();
+    k_sqr_distances.clear();
+
+    if(points.empty() || k <= 0) return 0;
+    size_t nb_wanted = std::min(static_cast<size_t>(k), points.size());
+
+    // Max heap of the nearest points found so far, reused by the searches of the thread
+    thread_local vector<pair<float, int>> heap;
+    heap.clear();
+
+    int col = getCol(p.x);
+    int row = getRow(p.y);
+
+    for(int ring = 0; ; ++ring)
+    {
+        int col_min = col - ring, col_max = col + ring;
+        int row_min = row - ring, row_max = row + ring;
+
+        for(int r = std::max(row_min, 0); r <= std::min(row_max, nb_rows - 1); ++r)
+        {
+            // The first and last rows of the ring are scanned whole, the others only at both ends
+            int step = (r == row_min || r == row_max) ? 1 : col_max - col_min;
+
+            for(int c = col_min; c <= col_max; c += step)
+            {
+                if(c < 0 || c >= nb_cols) continue;
+
+                size_t cell = static_cast<size_t>(r) * nb_cols + c;
+                for(uint32_t i = cell_starts[cell]; i < cell_starts[cell + 1]; ++i)
+                {
+                    const GridPoint &q = points[i];
+                    float dx = q.x - p.x, dy = q.y - p.y, dz = q.z - p.z;
+                    float d = dx * dx + dy * dy + dz * dz;
+
+                    if(heap.size() < nb_wanted)
+                    {
+                        heap.push_back({d, q.index});
+                        push_heap(heap.begin(), heap.end());
+                    }
+                    else if(d < heap.front().first)
+                    {
+                        pop_heap(heap.begin(), heap.end());
+                        heap.back() = {d, q.index};
+                        push_heap(heap.begin(), heap.end());
+                    }
+                }
+            }
+        }
+
+        if(col_min <= 0 && col_max >= nb_cols - 1 && row_min <= 0 && row_max >= nb_rows - 1) break;
+
+        // Points of the cells not scanned yet are at least as far as the border of the scanned square
+        float bound = std::min(std::min(p.x - (origin.x() + col_min * cell_size), origin.x() + (col_max + 1) * cell_size - p.x),
+                               std::min(p.y - (origin.y() + row_min * cell_size), origin.y() + (row_max + 1) * cell_size - p.y));
+
+        if(heap.size() == nb_wanted && bound > 0 && bound * bound >= heap.front().first) break;
+    }
+
+    sort_heap(heap.begin(), heap.end());
+
+    k_indices.resize(heap.size());
+    k_sqr_distances.resize(heap.size());
+    for(size_t i = 0; i < heap.size(); ++i)
+    {
+        k_sqr_distances[i] = heap[i].first;
+        k_indices[i] = heap[i].second;
+    }
+
+    return static_cast<int>(heap.size());
+}
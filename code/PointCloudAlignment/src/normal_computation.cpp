@@ -1,87 +1,114 @@
 #include "normal_computation.h"
 
-void NormalComputation::computeNormalCloud(PointNormalKCloud::Ptr cloud_in, KdTreeFlannK::Ptr kdTree_in, bool isResampled)
+void NormalComputation::computeNormalCloud(PointNormalKCloud::Ptr cloud_in, NeighborSearch::Ptr p_search, bool isResampled, NeighborGraph::Ptr p_graph)
 {
-    // parallel for loop on each point p in cloud_in
+    PROFILE_SCOPE("normal_computation");
+
+    int max_k = isResampled ? config.max_k_resampled : config.max_k_original;
+
+    // The orientation needs the graph even if the caller does not
+    if(!p_graph) p_graph = NeighborGraph::Ptr(new NeighborGraph);
+
+    // Neighborhoods of every point, only kept until the graph is filled
+    vector<vector<int>> neighborhoods(cloud_in->size());
+    vector<vector<float>> neighborhoods_distances(cloud_in->size());
+
+    #pragma omp parallel
+    {
+        // Buffers of the thread, reused from one point to the next
+        vector<int> nn_indices;
+        vector<float> nn_sqrd_distances;
+        NeighborhoodMoments moments;
+
+        // parallel for loop on each point p in cloud_in
+        #pragma omp for
+        for(size_t i = 0; i < cloud_in->size(); ++i)
+        {
+            // Search the largest neighborhood once
+            const PointNormalK &p = cloud_in->points[i];
+            p_search->nearestKSearch(p, max_k, nn_indices, nn_sqrd_distances);
+            moments.compute(*cloud_in, nn_indices, nn_sqrd_distances, vec3(p.x, p.y, p.z));
+
+            // compute appropriate K value for current point
+            float curv;
+            int k = estimateKForPoint(i, cloud_in, moments, nn_sqrd_distances, max_k, curv);
+
+            // Best fit plane of the K neighborhood
+            size_t nb_found = std::min(static_cast<size_t>(k), nn_indices.size());
+            Plane plane;
+            moments.fitPlane(nb_found, plane);
+
+            // Oriented once every normal is known
+            vec3 n = plane.getNormal().normalized();
+
+            cloud_in->points[i].normal_x = n.x();
+            cloud_in->points[i].normal_y = n.y();
+            cloud_in->points[i].normal_z = n.z();
+            cloud_in->points[i].curvature = roundTo(curv, 1);
+            cloud_in->points[i].k = k;
+
+            neighborhoods[i].assign(nn_indices.begin(), nn_indices.begin() + nb_found);
+            neighborhoods_distances[i].assign(nn_sqrd_distances.begin(), nn_sqrd_distances.begin() + nb_found);
+        }
+    }
+
+    // Rows can only be placed once every k is known
+    p_graph->allocate(*cloud_in);
+
     #pragma omp parallel for
     for(size_t i = 0; i < cloud_in->size(); ++i)
     {
-        // compute appropriate K value for current point
-        float curv;
-        int k = estimateKForPoint(i, cloud_in, kdTree_in, isResampled, curv);
-
-        // get K neighborhood indices
-        boost::shared_ptr<vector<int>> indices(new vector<int>);
-        vector<float> sqrd_distances;
-        kdTree_in->nearestKSearch(cloud_in->points.at(i), k, *indices, sqrd_distances);
-
-        // Estimate best fit plane for the indices found.
-        Plane plane;
-        Plane::estimatePlane(cloud_in, indices, plane);
-
-        vec3 n = plane.getNormal().normalized();
-        vec3 up(1, 1, 1);
-        up.normalize();
-
-        // Need to reorient normals.
-        n = (up.dot(n) < 0) ? -n : n;
-
-        cloud_in->points[i].normal_x = n.x();
-        cloud_in->points[i].normal_y = n.y();
-        cloud_in->points[i].normal_z = n.z();
-        cloud_in->points[i].curvature = roundTo(curv, 1);
-        cloud_in->points[i].k = k;
+        p_graph->setRow(i, neighborhoods[i], neighborhoods_distances[i]);
+        vector<int>().swap(neighborhoods[i]);
+        vector<float>().swap(neighborhoods_distances[i]);
     }
+
+    p_graph->makeSymmetric();
+
+    NormalOrientation().orient(*cloud_in, *p_graph);
 }
 
-int NormalComputation::estimateKForPoint(int p_id, PointNormalKCloud::Ptr cloud_in, KdTreeFlannK::Ptr kdTree_in, bool isResampled, float &curv)
+int NormalComputation::estimateKForPoint(int p_id, PointNormalKCloud::Ptr cloud_in, const NeighborhoodMoments &moments, vector<float> &nn_sqrd_distances, int max_k, float &curv)
 {
     float d1(1), d2(4), e(0.1f), max_count(10), sigma(0.2f);
     int k(15), count(0);
 
-    int max_k = isResampled ? MAX_K_RESAMPLED : MAX_K_ORIGINAL;
-
     float r_new, density;
     PointNormalK p = cloud_in->points.at(p_id);
 
     do {
-        boost::shared_ptr<vector<int>> indices(new vector<int>);
-        vector<float> sqrd_distances;
-        kdTree_in->nearestKSearch(p, k, *indices, sqrd_distances);
+        // The k nearest neighbors are the first k of the max_k nearest ones
+        size_t nb_found = std::min(static_cast<size_t>(k), nn_sqrd_distances.size());
 
         // Compute density estimation using 
         // the squared distance to farest neighbor found.
-        density = k / (M_PI * sqrd_distances.back());
+        density = k / (M_PI * nn_sqrd_distances[nb_found - 1]);
 
-        curv = computeCurvature(cloud_in, indices, sqrd_distances, p);
+        curv = computeCurvature(moments, nb_found, p);
 
         r_new = approxR(curv, d1, d2, sigma, e, density);
 
         k = std::ceil(M_PI * density * r_new * r_new);
-        k = std::max(MIN_K, k);
+        k = std::max(config.min_k, k);
         k = std::fmin(max_k, k);
 
         count++;
     } while(k < max_k && count < max_count);
 
+    PROFILE_COUNT("k_estimation_iterations", count);
+
     return k;
 }
 
-float NormalComputation::computeCurvature(PointNormalKCloud::Ptr cloud, boost::shared_ptr<vector<int>> indices, vector<float> sqrd_distances, PointNormalK p)
+float NormalComputation::computeCurvature(const NeighborhoodMoments &moments, size_t k, PointNormalK p)
 {
-    if(indices->size() <= 3) return 1.0f;
+    if(k <= 3) return 1.0f;
 
-    float avgDist(0.0f);
-    for_each(sqrd_distances.begin(), sqrd_distances.end(), [&avgDist](const float d)
-        {
-            avgDist += std::sqrt(d);
-        }
-    );
-    avgDist /= sqrd_distances.size();
+    float avgDist = moments.getMeanDistance(k);
 
-    // Estimate best fit plane for the indices found.
+    // Best fit plane of the k nearest neighbors
     Plane plane;
-    Plane::estimatePlane(cloud, indices, plane);
+    moments.fitPlane(k, plane);
 
     return 2.0f * plane.distanceTo(vec3(p.x, p.y, p.z)) / (avgDist * avgDist);
 }
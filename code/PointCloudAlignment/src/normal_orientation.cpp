@@ -0,0 +1,189 @@
+#include "normal_orientation.h"
+
+static vec3 getNormal(const PointNormalK &p)
+{
+    return vec3(p.normal_x, p.normal_y, p.normal_z);
+}
+
+/**
+ * @brief Root of the component of point i in the union-find, and in flip whether the normal of i is opposite to the one
+ * of the root. The path from i is attached to the root.
+ */
+static int findRoot(int i, vector<int> &parent, vector<uint8_t> &parity, uint8_t &flip)
+{
+    int root = i;
+    flip = 0;
+    while(parent[root] != root)
+    {
+        flip ^= parity[root];
+        root = parent[root];
+    }
+
+    // c is the parity from i to x
+    uint8_t c = 0;
+    for(int x = i; x != root;)
+    {
+        int next = parent[x];
+        uint8_t parity_x = parity[x];
+        parent[x] = root;
+        parity[x] = flip ^ c;
+        c ^= parity_x;
+        x = next;
+    }
+
+    return root;
+}
+
+void NormalOrientation::orient(PointNormalKCloud &cloud, const NeighborGraph &graph) const
+{
+    PROFILE_SCOPE("normal_orientation");
+
+    int nb_points = static_cast<int>(cloud.size());
+
+    if(graph.size() != cloud.size())
+    {
+        LOG(ERROR) << "The neighbor graph does not match the cloud, normals are only oriented toward the reference.";
+
+        #pragma omp parallel for
+        for(int i = 0; i < nb_points; ++i)
+        {
+            PointNormalK &p = cloud.points[i];
+            if(getNormal(p).dot(reference) < 0)
+            {
+                p.normal_x = -p.normal_x;
+                p.normal_y = -p.normal_y;
+                p.normal_z = -p.normal_z;
+            }
+        }
+        return;
+    }
+
+    vector<Edge> edges;
+    sortEdges(cloud, graph, edges);
+
+    // Union-find whose parity tells whether a point's normal is opposite to the one of its parent
+    vector<int> parent(nb_points);
+    vector<uint8_t> parity(nb_points, 0);
+    vector<int> component_size(nb_points, 1);
+    for(int i = 0; i < nb_points; ++i) parent[i] = i;
+
+    // Smoothest edges first, an edge joining two components is one of the spanning tree
+    int nb_components = nb_points;
+    for(const Edge &e: edges)
+    {
+        uint8_t flip_i, flip_j;
+        int root_i = findRoot(e.i, parent, parity, flip_i);
+        int root_j = findRoot(e.j, parent, parity, flip_j);
+        if(root_i == root_j) continue;
+
+        if(component_size[root_i] < component_size[root_j]) swap(root_i, root_j);
+        parent[root_j] = root_i;
+        parity[root_j] = flip_i ^ flip_j ^ static_cast<uint8_t>(e.is_opposite);
+        component_size[root_i] += component_size[root_j];
+        nb_components--;
+    }
+
+    vector<Edge>().swap(edges);
+    PROFILE_COUNT("normal_orientation_components", nb_components);
+
+    // Paths were compressed, they are short: walk them without writing
+    vector<int> roots(nb_points);
+    vector<uint8_t> flips(nb_points);
+
+    #pragma omp parallel for
+    for(int i = 0; i < nb_points; ++i)
+    {
+        int root = i;
+        uint8_t flip = 0;
+        while(parent[root] != root)
+        {
+            flip ^= parity[root];
+            root = parent[root];
+        }
+        roots[i] = root;
+        flips[i] = flip;
+    }
+
+    // Each component points toward the reference on average
+    vector<double> votes(nb_points, 0);
+    for(int i = 0; i < nb_points; ++i)
+    {
+        float alignment = getNormal(cloud.points[i]).dot(reference);
+        votes[roots[i]] += flips[i] ? -alignment : alignment;
+    }
+
+    #pragma omp parallel for
+    for(int i = 0; i < nb_points; ++i)
+    {
+        if(flips[i] != (votes[roots[i]] < 0))
+        {
+            PointNormalK &p = cloud.points[i];
+            p.normal_x = -p.normal_x;
+            p.normal_y = -p.normal_y;
+            p.normal_z = -p.normal_z;
+        }
+    }
+}
+
+void NormalOrientation::sortEdges(const PointNormalKCloud &cloud, const NeighborGraph &graph, vector<Edge> &edges) const
+{
+    int nb_points = static_cast<int>(cloud.size());
+
+    auto getBucket = [&](int i, int j) {
+        float weight = 1 - fabs(getNormal(cloud.points[i]).dot(getNormal(cloud.points[j])));
+        return std::min(NB_BUCKETS - 1, std::max(0, static_cast<int>(weight * NB_BUCKETS)));
+    };
+
+    // Counting sort: both loops are scheduled the same way, each thread writes its edges after the ones of the previous
+    // threads in each bucket, the order does not depend on the timing of the threads
+    vector<vector<uint64_t>> bucket_starts;
+
+    #pragma omp parallel
+    {
+        #pragma omp single
+        bucket_starts.assign(omp_get_num_threads(), vector<uint64_t>(NB_BUCKETS, 0));
+
+        vector<uint64_t> &starts = bucket_starts[omp_get_thread_num()];
+
+        #pragma omp for schedule(static)
+        for(int i = 0; i < nb_points; ++i)
+        {
+            for(const int *p_j = graph.rowBegin(i); p_j != graph.rowEnd(i); ++p_j)
+            {
+                // Rows are symmetric, each edge is taken from its lowest point
+                if(*p_j > i) starts[getBucket(i, *p_j)]++;
+            }
+        }
+
+        #pragma omp single
+        {
+            uint64_t nb_edges = 0;
+            for(int b = 0; b < NB_BUCKETS; ++b)
+            {
+                for(vector<uint64_t> &thread_starts: bucket_starts)
+                {
+                    uint64_t count = thread_starts[b];
+                    thread_starts[b] = nb_edges;
+                    nb_edges += count;
+                }
+            }
+            edges.resize(nb_edges);
+        }
+
+        #pragma omp for schedule(static)
+        for(int i = 0; i < nb_points; ++i)
+        {
+            vec3 n_i = getNormal(cloud.points[i]);
+            for(const int *p_j = graph.rowBegin(i); p_j != graph.rowEnd(i); ++p_j)
+            {
+                int j = *p_j;
+                if(j <= i) continue;
+
+                Edge &e = edges[starts[getBucket(i, j)]++];
+                e.i = i;
+                e.j = j;
+                e.is_opposite = n_i.dot(getNormal(cloud.points[j])) < 0;
+            }
+        }
+    }
+}
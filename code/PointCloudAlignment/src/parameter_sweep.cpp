@@ -0,0 +1,239 @@
+#include "parameter_sweep.h"
+
+#include <sstream>
+#include <cmath>
+
+#include <boost/algorithm/string.hpp>
+
+bool ParameterSweep::load(string filename)
+{
+    ifstream file(filename);
+    if(!file.is_open())
+    {
+        LOG(ERROR) << "Could not open parameter grid " << filename;
+        return false;
+    }
+
+    string line;
+    int line_nb = 0;
+
+    while(getline(file, line))
+    {
+        line_nb++;
+        line = line.substr(0, line.find('#'));
+        boost::trim(line);
+
+        if(line.empty()) continue;
+
+        size_t equal = line.find('=');
+        if(equal == string::npos)
+        {
+            LOG(ERROR) << "Error at line " << line_nb << " of " << filename << ": expected \"name = value, value, ...\"";
+            return false;
+        }
+
+        string name = boost::trim_copy(line.substr(0, equal));
+
+        vector<string> values;
+        boost::split(values, line.substr(equal + 1), boost::is_any_of(","));
+        for(string &value: values)
+        {
+            boost::trim(value);
+        }
+
+        if(!addParameter(name, values))
+        {
+            LOG(ERROR) << "Error at line " << line_nb << " of " << filename;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool ParameterSweep::addParameter(string name, const vector<string> &values)
+{
+    for(const auto &parameter: parameters)
+    {
+        if(parameter.first == name)
+        {
+            LOG(ERROR) << "Parameter " << name << " is already in the grid";
+            return false;
+        }
+    }
+
+    // Values are checked on a scratch configuration, so that errors are found before any alignment is run
+    AlignmentConfig config;
+    for(const string &value: values)
+    {
+        if(!config.set(name, value)) return false;
+    }
+
+    if(AlignmentConfig::getStage(name) & (AlignmentConfig::PREPROCESSING | AlignmentConfig::TILING))
+    {
+        LOG(WARNING) << "Warning: " << name << " has no effect on testing sets, their clouds are already preprocessed";
+    }
+
+    parameters.push_back(make_pair(name, values));
+
+    return true;
+}
+
+size_t ParameterSweep::getNbConfigs() const
+{
+    size_t nb_configs = 1;
+    for(const auto &parameter: parameters)
+    {
+        nb_configs *= parameter.second.size();
+    }
+
+    return nb_configs;
+}
+
+vector<AlignmentConfig> ParameterSweep::getConfigs(const AlignmentConfig &base) const
+{
+    vector<AlignmentConfig> configs(getNbConfigs(), base);
+
+    // Mixed radix decomposition of the configuration index, the last parameter being the least significant digit
+    for(size_t c = 0; c < configs.size(); ++c)
+    {
+        size_t index = c;
+        for(size_t p = parameters.size(); p-- > 0;)
+        {
+            const vector<string> &values = parameters[p].second;
+            configs[c].set(parameters[p].first, values[index % values.size()]);
+            index /= values.size();
+        }
+    }
+
+    return configs;
+}
+
+/// Numeric columns of the table written for a run, after its identifiers and parameters.
+static const vector<const char*> RUN_COLUMNS = {
+    "rotation_error", "translation_error", "mean_pair_distance", "nb_pairs",
+    "nb_points_source", "nb_points_target", "nb_planes_source", "nb_planes_target",
+    "source_segmentation_time", "target_segmentation_time", "source_merging_time", "target_merging_time",
+    "registration_time", "total_time"
+};
+
+/// Values of RUN_COLUMNS for a run.
+static vector<double> getRunValues(const SweepRun &run)
+{
+    const AlignmentResults &r = run.results;
+
+    return {
+        r.getRotationError(), r.getTranslationError(), r.getMeanPairDistance(), static_cast<double>(r.pair_distances.size()),
+        static_cast<double>(r.nb_points_source), static_cast<double>(r.nb_points_target),
+        static_cast<double>(r.nb_planes_source), static_cast<double>(r.nb_planes_target),
+        run.source_segmentation_time, run.target_segmentation_time, run.source_merging_time, run.target_merging_time,
+        run.registration_time, r.elapsed_time
+    };
+}
+
+bool ParameterSweep::writeTable(string filename, const vector<AlignmentConfig> &configs, const vector<SweepRun, Eigen::aligned_allocator<SweepRun>> &runs) const
+{
+    ofstream out(filename, ios::out | ios::trunc);
+    if(!out.is_open())
+    {
+        LOG(ERROR) << "Could not write sweep results in " << filename;
+        return false;
+    }
+
+    if(boost::algorithm::iends_with(filename, ".json"))
+    {
+        writeJSON(out, configs, runs);
+    }
+    else
+    {
+        writeCSV(out, configs, runs);
+    }
+
+    LOG(INFO) << runs.size() << " runs written in " << filename;
+
+    return out.good();
+}
+
+void ParameterSweep::writeCSV(ostream &out, const vector<AlignmentConfig> &configs, const vector<SweepRun, Eigen::aligned_allocator<SweepRun>> &runs) const
+{
+    out << "set,source,config";
+    for(const auto &parameter: parameters)
+    {
+        out << "," << parameter.first;
+    }
+    for(const char *column: RUN_COLUMNS)
+    {
+        out << "," << column;
+    }
+    out << ",pair_distances" << endl;
+
+    for(const SweepRun &run: runs)
+    {
+        out << run.set_id << "," << run.source_id << "," << run.config_id;
+        for(const auto &parameter: parameters)
+        {
+            out << "," << configs[run.config_id].get(parameter.first);
+        }
+        for(double value: getRunValues(run))
+        {
+            out << "," << value;
+        }
+
+        // The list stays in one field, its distances being separated by spaces
+        out << ",";
+        for(size_t i = 0; i < run.results.pair_distances.size(); ++i)
+        {
+            out << (i > 0 ? " " : "") << run.results.pair_distances[i];
+        }
+        out << endl;
+    }
+}
+
+/// JSON has no NaN nor infinity, a failed alignment gives null errors.
+static void writeJSONNumber(ostream &out, double value)
+{
+    if(isfinite(value))
+    {
+        out << value;
+    }
+    else
+    {
+        out << "null";
+    }
+}
+
+void ParameterSweep::writeJSON(ostream &out, const vector<AlignmentConfig> &configs, const vector<SweepRun, Eigen::aligned_allocator<SweepRun>> &runs) const
+{
+    out << "[" << endl;
+
+    for(size_t r = 0; r < runs.size(); ++r)
+    {
+        const SweepRun &run = runs[r];
+
+        out << "  {\"set\": " << run.set_id << ", \"source\": " << run.source_id << ", \"config\": " << run.config_id;
+
+        out << ", \"parameters\": {";
+        for(size_t p = 0; p < parameters.size(); ++p)
+        {
+            out << (p > 0 ? ", " : "") << "\"" << parameters[p].first << "\": " << configs[run.config_id].get(parameters[p].first);
+        }
+        out << "}";
+
+        vector<double> values = getRunValues(run);
+        for(size_t i = 0; i < RUN_COLUMNS.size(); ++i)
+        {
+            out << ", \"" << RUN_COLUMNS[i] << "\": ";
+            writeJSONNumber(out, values[i]);
+        }
+
+        out << ", \"pair_distances\": [";
+        for(size_t i = 0; i < run.results.pair_distances.size(); ++i)
+        {
+            out << (i > 0 ? ", " : "");
+            writeJSONNumber(out, run.results.pair_distances[i]);
+        }
+        out << "]}" << (r + 1 < runs.size() ? "," : "") << endl;
+    }
+
+    out << "]" << endl;
+}
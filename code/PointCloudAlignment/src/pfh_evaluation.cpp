@@ -1,16 +1,16 @@
 #include "pfh_evaluation.h"
 
-bool PFHEvaluation::isValidPlane(PointNormalKCloud::Ptr points, vector<int> &indices)
+bool PFHEvaluation::isValidPlane(PointNormalKCloud::Ptr points, vector<int> &indices, float plane_treshold)
 {
     Eigen::VectorXf pfh_histogram(125);
     pcl::PFHEstimation<PointNormalK, PointNormalK, pcl::PFHSignature125> pfh;
     pfh.computePointPFHSignature(*points, *points, indices, 5, pfh_histogram);
 
     // Test the histogram for plane
-    return pfh_histogram[62] > PLANE_TRESHOLD;
+    return pfh_histogram[62] > plane_treshold;
 }
 
-PFHCloud PFHEvaluation::computePFHSignatures(vector<SegmentedPointsContainer::SegmentedPlane> &l_planes)
+PFHCloud PFHEvaluation::computePFHSignatures(vector<SegmentedPointsContainer::SegmentedPlane> &l_planes, int center_knn)
 {
     // First, build cloud of points+normals of every planes' centers and normals.
     PointNormalCloud::Ptr cloud = PFHEvaluation::buildPointCloud(l_planes);
@@ -26,7 +26,7 @@ PFHCloud PFHEvaluation::computePFHSignatures(vector<SegmentedPointsContainer::Se
     pfh.setInputCloud(cloud);
     pfh.setInputNormals(cloud);
     pfh.setSearchMethod(p_kdTree);
-    pfh.setKSearch(CENTER_KNN);
+    pfh.setKSearch(center_knn);
     pfh.compute(pfh_cloud);
 
     return pfh_cloud;
@@ -64,6 +64,8 @@ void PFHEvaluation::computeFPFHSignature(vector<SegmentedPointsContainer::Segmen
 
 APFHCloud PFHEvaluation::computeAPFHSignature(vector<SegmentedPointsContainer::SegmentedPlane> &l_planes, vector<float> &surfaces)
 {
+    PROFILE_SCOPE("apfh_signatures");
+
     PointNormalCloud::Ptr cloud = PFHEvaluation::buildPointCloud(l_planes);
 
     pcl::search::KdTree<PointNormal>::Ptr p_kdTree(new pcl::search::KdTree<PointNormal>());
@@ -246,7 +248,7 @@ size_t PFHEvaluation::getMinTarget(size_t i, PFHCloud source_signs, PFHCloud tar
             j = it;
         }
         else if (curr_error == min_error) {
-            cout << "SAME ERROR VALUE: " << curr_error << endl;
+            LOG(DEBUG) << "SAME ERROR VALUE: " << curr_error;
         }
     }
 
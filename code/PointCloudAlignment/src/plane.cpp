@@ -29,6 +29,17 @@ vec3 Plane::getNormalizedN()
     return n.normalized();
 }
 
+void Plane::orientAlong(vec3 direction)
+{
+    if(n.dot(direction) >= 0) return;
+
+    a = -a;
+    b = -b;
+    c = -c;
+    d = -d;
+    n = -n;
+}
+
 pcl::ModelCoefficients Plane::getModelCoefficients()
 {
     pcl::ModelCoefficients coeffs;
@@ -45,23 +56,22 @@ float Plane::getPlaneTolerance(PointNormalKCloud::Ptr cloud, boost::shared_ptr<v
     vector<float> distances(indices->size());
     float dist_mean(0);
 
-    #pragma omp parallel for shared(distances, dist_mean)
+    #pragma omp parallel for reduction(+:dist_mean)
     for(size_t i = 0; i < indices->size(); ++i)
     {
         float d = this->distanceTo(cloud->points[indices->at(i)]);
         distances[i] = d;
-
-        #pragma omp critical
         dist_mean += d;
     }
 
     dist_mean /= static_cast<float>(indices->size());
 
-    float dev(0), max_d(0);
-    for(float j: distances)
+    float dev(0);
+
+    #pragma omp parallel for reduction(+:dev)
+    for(size_t i = 0; i < distances.size(); ++i)
     {
-        dev += std::pow(j - dist_mean, 2.0f);
-        max_d = j > max_d ? j : max_d;
+        dev += (distances[i] - dist_mean) * (distances[i] - dist_mean);
     }
     dev /= static_cast<float>(distances.size());
 
@@ -90,36 +100,63 @@ void Plane::cartesianToNormal(vec3 &ni, float &di)
     ni = v.normalized();
 }
 
-void Plane::estimatePlane(PointNormalKCloud::Ptr cloud_in, boost::shared_ptr<vector<int>> indices_in, Plane &plane)
+/// Plane through the centroid, normal to the direction of least variance of the covariance.
+static void planeFromCovariance(const vec3d &centroid, const Eigen::Matrix3d &covariance, Plane &plane)
 {
-    // Get list of points
-    PointNormalKCloud::Ptr cloud_f(new PointNormalKCloud);
-    pcl::ExtractIndices<PointNormalK> iFilter(false);
-    iFilter.setInputCloud(cloud_in);
-    iFilter.setIndices(indices_in);
-    iFilter.filter(*cloud_f);
+    // Eigenvalues are sorted in increasing order, the normal is the direction of least variance
+    Eigen::SelfAdjointEigenSolver<mat3> solver(covariance.cast<float>());
+    vec3 n = solver.eigenvectors().col(0);
+    vec3 center = centroid.cast<float>();
 
-    vec4 center;
-    pcl::compute3DCentroid(*cloud_f, center);
+    // Compute plane last parameter
+    float d = - n.x() * center.x() - n.y() * center.y() - n.z() * center.z();
 
-    // Compose optimisation matrix
-    Eigen::MatrixXf m;
-    pcl::demeanPointCloud(*cloud_f, center, m);
+    plane.setCoeffs(n.x(), n.y(), n.z(), d);
+    plane.setCenter(center);
+}
 
-    // Compute svd decomposition
-    Eigen::JacobiSVD<Eigen::MatrixXf> svd(m.block(0,0, 3, m.cols()), Eigen::ComputeThinU);
-    Eigen::MatrixXf u = svd.matrixU();
+/**
+ * @brief Least squares fit of a plane through points, point_at(i) returning the i-th point as a vec3.
+ * The 3x3 covariance is accumulated on demeaned points in double, to stay accurate on georeferenced coordinates,
+ * and decomposed with a fixed size solver: no heap allocation.
+ */
+template<typename PointAt>
+static void fitPlane(size_t nb_points, PointAt point_at, Plane &plane)
+{
+    vec3d centroid(0, 0, 0);
+    for(size_t i = 0; i < nb_points; ++i)
+    {
+        centroid += point_at(i).template cast<double>();
+    }
+    centroid /= static_cast<double>(nb_points);
 
-    //Extract plane parameters
-    float a = u(0, 2);
-    float b = u(1, 2);
-    float c = u(2, 2);
+    Eigen::Matrix3d covariance = Eigen::Matrix3d::Zero();
+    for(size_t i = 0; i < nb_points; ++i)
+    {
+        vec3d p = point_at(i).template cast<double>() - centroid;
+        covariance += p * p.transpose();
+    }
+    covariance /= static_cast<double>(nb_points);
 
-    // Compute plane last parameter
-    float d = - a * center.x() - b * center.y() - c * center.z();
+    planeFromCovariance(centroid, covariance, plane);
+}
 
-    plane.setCoeffs(a, b, c, d);
-    plane.setCenter(vec3(center.x(), center.y(), center.z()));
+void Plane::estimatePlane(PointNormalKCloud::Ptr cloud_in, boost::shared_ptr<vector<int>> indices_in, Plane &plane)
+{
+    const vector<int> &indices = *indices_in;
+    const PointNormalKCloud &cloud = *cloud_in;
+
+    fitPlane(indices.size(), [&cloud, &indices](size_t i){
+        const PointNormalK &p = cloud.points[indices[i]];
+        return vec3(p.x, p.y, p.z);
+    }, plane);
+}
+
+void Plane::estimatePlane(const PointCloudSoA &cloud, const vector<int> &indices, Plane &plane)
+{
+    fitPlane(indices.size(), [&cloud, &indices](size_t i){
+        return cloud.getPoint(indices[i]);
+    }, plane);
 }
 
 bool Plane::pointInPlane(PointNormalK p, float epsilon)
@@ -143,6 +180,188 @@ bool Plane::normalInPlane(PointNormalK p, float max_angle)
     return fabs(acos(pn.dot(n))) <= max_angle;
 }
 
+bool Plane::pointInPlane(const PointCloudSoA &cloud, int index, float epsilon)
+{
+    vec3 n = getNormal().normalized();
+    float dist = abs(n.dot(cloud.getPoint(index)) + d);
+
+    return dist <= epsilon;
+}
+
+bool Plane::normalInPlane(const PointCloudSoA &cloud, int index, float max_angle)
+{
+    vec3 n = getNormal().normalized();
+    vec3 pn = cloud.getNormal(index);
+    pn.normalize();
+
+    //It may be necessary to reorient the normal vector.
+    n = pn.dot(n) >= pn.dot(-n) ? n : -n;
+
+    return fabs(acos(pn.dot(n))) <= max_angle;
+}
+
+void PlaneMoments::reset(vec3 origin)
+{
+    this->origin = origin.cast<double>();
+    nb_points = 0;
+    sum.setZero();
+    sum_squares.setZero();
+    nb_distances = 0;
+    sum_distances = 0;
+    sum_squared_distances = 0;
+}
+
+void PlaneMoments::addPoints(const PointCloudSoA &cloud, const vector<int> &indices)
+{
+    for(int i: indices)
+    {
+        vec3d p = cloud.getPoint(i).cast<double>() - origin;
+        sum += p;
+        sum_squares += p * p.transpose();
+    }
+
+    nb_points += indices.size();
+}
+
+void PlaneMoments::addDistances(const PointCloudSoA &cloud, const vector<int> &indices, Plane &plane)
+{
+    for(int i: indices)
+    {
+        double d = plane.distanceTo(cloud.getPoint(i));
+        sum_distances += d;
+        sum_squared_distances += d * d;
+    }
+
+    nb_distances += indices.size();
+}
+
+void PlaneMoments::fitPlane(Plane &plane) const
+{
+    vec3d mean = sum / static_cast<double>(nb_points);
+    Eigen::Matrix3d covariance = sum_squares / static_cast<double>(nb_points) - mean * mean.transpose();
+
+    planeFromCovariance(origin + mean, covariance, plane);
+}
+
+float PlaneMoments::getTolerance() const
+{
+    double mean = sum_distances / static_cast<double>(nb_distances);
+    double variance = sum_squared_distances / static_cast<double>(nb_distances) - mean * mean;
+
+    return static_cast<float>(mean + 3.0 * sqrt(max(variance, 0.0)));
+}
+
+void NeighborhoodMoments::compute(const PointNormalKCloud &cloud, const vector<int> &indices, const vector<float> &sqrd_distances, vec3 origin)
+{
+    this->origin = origin.cast<double>();
+
+    sums.resize(indices.size() + 1);
+    sum_squares.resize(indices.size() + 1);
+    sum_distances.resize(indices.size() + 1);
+
+    sums[0].setZero();
+    sum_squares[0].setZero();
+    sum_distances[0] = 0;
+
+    for(size_t i = 0; i < indices.size(); ++i)
+    {
+        const PointNormalK &point = cloud.points[indices[i]];
+        vec3d p = vec3d(point.x, point.y, point.z) - this->origin;
+
+        sums[i + 1] = sums[i] + p;
+        sum_squares[i + 1] = sum_squares[i] + p * p.transpose();
+        sum_distances[i + 1] = sum_distances[i] + std::sqrt(static_cast<double>(sqrd_distances[i]));
+    }
+}
+
+void NeighborhoodMoments::fitPlane(size_t k, Plane &plane) const
+{
+    vec3d mean = sums[k] / static_cast<double>(k);
+    Eigen::Matrix3d covariance = sum_squares[k] / static_cast<double>(k) - mean * mean.transpose();
+
+    planeFromCovariance(origin + mean, covariance, plane);
+}
+
+/**
+ * @brief Kernel of Plane::filterPointsInPlane. The candidates are tested by blocks, each test writing a mask in a loop without
+ * branches that the compiler can vectorize with gathers from the SoA arrays. The distance is tested first, the normals are
+ * only read for the points passing it, as the scalar path does.
+ * With normalized vectors, angle(pn, +-n) <= max_angle is |pn.n| >= cos(max_angle), compared squared to avoid normalizing pn.
+ * Normals are compared whatever their orientation, fragments of a plane meeting only at sharp edges may be oriented apart.
+ * A zero normal is at a right angle of n, as in normalInPlane: it is only accepted if max_angle is at least a right angle.
+ */
+template<bool check_normals>
+static void filterCandidates(const PointCloudSoA &cloud, const vector<int> &indices, vec3 n, float d, float epsilon, float cos_max_angle, vector<int> &accepted)
+{
+    const size_t BLOCK_SIZE = 256;
+    uint8_t mask[BLOCK_SIZE];
+    int in_plane[BLOCK_SIZE];
+
+    const float nx = n.x(), ny = n.y(), nz = n.z();
+    const float sqrd_cos = cos_max_angle * cos_max_angle;
+    const uint8_t accept_zero_normals = cos_max_angle <= 0;
+
+    for(size_t start = 0; start < indices.size(); start += BLOCK_SIZE)
+    {
+        const int *block = indices.data() + start;
+        const size_t block_size = std::min(BLOCK_SIZE, indices.size() - start);
+
+        #pragma omp simd
+        for(size_t j = 0; j < block_size; ++j)
+        {
+            const int i = block[j];
+            mask[j] = std::fabs(nx * cloud.x[i] + ny * cloud.y[i] + nz * cloud.z[i] + d) <= epsilon;
+        }
+
+        if(!check_normals)
+        {
+            for(size_t j = 0; j < block_size; ++j)
+            {
+                if(mask[j]) accepted.push_back(block[j]);
+            }
+            continue;
+        }
+
+        size_t nb_in_plane = 0;
+        for(size_t j = 0; j < block_size; ++j)
+        {
+            in_plane[nb_in_plane] = block[j];
+            nb_in_plane += mask[j];
+        }
+
+        #pragma omp simd
+        for(size_t j = 0; j < nb_in_plane; ++j)
+        {
+            const int i = in_plane[j];
+            const float dot = nx * cloud.nx[i] + ny * cloud.ny[i] + nz * cloud.nz[i];
+            const float sqrd_norm = cloud.nx[i] * cloud.nx[i] + cloud.ny[i] * cloud.ny[i] + cloud.nz[i] * cloud.nz[i];
+            mask[j] = sqrd_norm > 0 ? dot * dot >= sqrd_cos * sqrd_norm : accept_zero_normals;
+        }
+
+        for(size_t j = 0; j < nb_in_plane; ++j)
+        {
+            if(mask[j]) accepted.push_back(in_plane[j]);
+        }
+    }
+}
+
+void Plane::filterPointsInPlane(const PointCloudSoA &cloud, const vector<int> &indices, float epsilon, vector<int> &accepted)
+{
+    filterCandidates<false>(cloud, indices, getNormal().normalized(), d, epsilon, 0, accepted);
+}
+
+void Plane::filterPointsInPlane(const PointCloudSoA &cloud, const vector<int> &indices, float epsilon, float cos_max_angle, vector<int> &accepted)
+{
+    // Every normal is within a right angle of either n or -n
+    if(cos_max_angle <= 0)
+    {
+        filterPointsInPlane(cloud, indices, epsilon, accepted);
+        return;
+    }
+
+    filterCandidates<true>(cloud, indices, getNormal().normalized(), d, epsilon, cos_max_angle, accepted);
+}
+
 vec3 Plane::getCenter()
 {
     return this->center;
@@ -12,10 +12,13 @@ void PlaneMerging::init(function<void(PointNormalKCloud::Ptr, ivec3, vector<int>
 
 void PlaneMerging::start_merge(vector<SegmentedPointsContainer::SegmentedPlane> &p_list, PointNormalKCloud::Ptr p_cloud)
 {
+    PROFILE_SCOPE("plane_merging");
+
     // We assume that the plane list must be sorted by plane id order.
     this->plane_list = p_list;
 
     p_point_cloud = p_cloud;
+    p_point_soa = PointCloudSoA::Ptr(new PointCloudSoA(*p_cloud));
 
     //fill center clouds and indices list
     p_plane_cloud->points.reserve(p_list.size());
@@ -54,6 +57,8 @@ void PlaneMerging::filter_small_planes(vector<SegmentedPointsContainer::Segmente
 
 void PlaneMerging::merge()
 {
+    PROFILE_COUNT("merge_passes", 1);
+
     bool continue_merging = false;
 
     for(size_t i = 0; i < plane_list.size(); ++i)
@@ -65,7 +70,7 @@ void PlaneMerging::merge()
             // Search nearest neighbors plane centers
             vector<int> indices;
             vector<float> sqrd_dists;
-            p_kdtree->nearestKSearch(plane.plane.getCenterPCL(), KNN, indices, sqrd_dists);
+            p_kdtree->nearestKSearch(plane.plane.getCenterPCL(), config.knn, indices, sqrd_dists);
 
             vector<int> remove_list;
 
@@ -74,13 +79,8 @@ void PlaneMerging::merge()
             {
                 if(plane_list[j].id != plane.id)
                 {
-                    //May need to reorient normal
-                    vec3 n = plane.plane.getNormal().normalized();
-                    vec3 ni = plane_list[j].plane.getNormal().normalized();
-                    n = ni.dot(n) >= ni.dot(-n) ? n : -n;
-
                     // Filter by plane normal vector and then plane overlap
-                    if(ni.dot(n) >= cos(NORMAL_ERROR) && planeOverlap(plane, plane_list[j], DISTANCE_ERROR))
+                    if(haveSimilarNormals(plane.plane, plane_list[j].plane, cos_normal_error) && planeOverlap(plane, plane_list[j], config.distance_error))
                     {
                         //  - change color of points
                         callDisplayCallback(p_point_cloud, plane.color, plane_list[j].indices_list, isSource);
@@ -89,7 +89,7 @@ void PlaneMerging::merge()
                         plane_list[i].indices_list.insert(plane_list[i].indices_list.end(), plane_list[j].indices_list.begin(), plane_list[j].indices_list.end());
 
                         //  - recompute center
-                        plane_list[i].plane.setCenter(computePlaneCenter(p_point_cloud, plane_list[i].indices_list));
+                        plane_list[i].plane.setCenter(p_point_soa->computeCenter(plane_list[i].indices_list));
                         p_plane_cloud->points[i] = plane_list[i].plane.getCenterPCL();
 
                         //  - add merged plane id to remove list
@@ -121,11 +121,26 @@ void PlaneMerging::merge()
     }
     else
     {
-        cout << "Plane merging finished: merged " << p_plane_cloud->size() - p_plane_indices->size() <<
-                " planes. There is now " << p_plane_indices->size() << " planes." << endl;
+        LOG(INFO) << "Plane merging finished: merged " << p_plane_cloud->size() - p_plane_indices->size() <<
+                " planes. There is now " << p_plane_indices->size() << " planes.";
     }
 }
 
+void PlaneMerging::setConfig(const AlignmentConfig &config)
+{
+    this->config = config;
+    cos_normal_error = std::cos(config.normal_error);
+    cos_overlap_angle = std::cos(config.overlap_angle);
+}
+
+bool PlaneMerging::haveSimilarNormals(Plane &p1, Plane &p2, float cos_max_angle)
+{
+    vec3 n = p1.getNormal().normalized();
+    vec3 ni = p2.getNormal().normalized();
+
+    return std::fabs(ni.dot(n)) >= cos_max_angle;
+}
+
 bool PlaneMerging::planeOverlap(SegmentedPointsContainer::SegmentedPlane &p1, SegmentedPointsContainer::SegmentedPlane &p2, float d_tolerance)
 {
     vec3 dir1 = p2.plane.getCenter() - p1.plane.getCenter();
@@ -148,11 +163,12 @@ float PlaneMerging::farestPointInDir(SegmentedPointsContainer::SegmentedPlane &p
 
     for(int i: plane.indices_list)
     {
-        vec3 pi(p_point_cloud->points[i].x, p_point_cloud->points[i].y, p_point_cloud->points[i].z);
+        vec3 pi = p_point_soa->getPoint(i);
         vec3 p_dir = pi - plane.plane.getCenter();
         float p_dir_norm = p_dir.norm();
-        p_dir.normalize();
-        if(dir.dot(p_dir) >= cos(OVERLAP_ANGLE) && p_dir_norm > max_r)
+
+        // Angle between dir and p_dir within overlap_angle, without normalizing p_dir
+        if(dir.dot(p_dir) >= cos_overlap_angle * p_dir_norm && p_dir_norm > max_r)
         {
             max_r = p_dir_norm;
         }
@@ -17,14 +17,15 @@ void PlaneSegmentation::RunProperties::setupNextPlane(int index, PointNormalK &p
     prev_size = 0;
     max_search_distance = 0;
     epsilon = 0;
+    moments.reset(vec3(p.x, p.y, p.z));
     p_nghbrs_indices->clear();
     p_new_points_indices->clear();
 }
 
-void PlaneSegmentation::RunProperties::addToNeighborhood(vector<int> &new_points)
+void PlaneSegmentation::RunProperties::addToNeighborhood(vector<int> &new_points, const AlignmentConfig &config)
 {
-    if(iteration < PHASE1_ITERATIONS ||
-            p_nghbrs_indices->size() < MIN_STABLE_SIZE)
+    if(iteration < config.phase1_iterations ||
+            p_nghbrs_indices->size() < static_cast<size_t>(config.min_stable_size))
     {
         new_points.swap(*p_nghbrs_indices);
     }
@@ -51,6 +52,41 @@ void PlaneSegmentation::RunProperties::addToNeighborhood(vector<int> &new_points
     }
 }
 
+// ========================================================================================== //
+// PlaneSegmentation::FrontierStamps
+// ========================================================================================== //
+
+void PlaneSegmentation::FrontierStamps::begin(size_t nb_points, size_t frontier_size)
+{
+    // Stamps of previous gatherings are all below the new base, unless it wraps around
+    bool wraps = next_base > numeric_limits<uint32_t>::max() - frontier_size;
+
+    if(nb_points != size || wraps)
+    {
+        if(nb_points != size) p_stamps.reset(new atomic<uint32_t>[nb_points]);
+        size = nb_points;
+
+        for(size_t i = 0; i < size; ++i)
+        {
+            p_stamps[i].store(0, memory_order_relaxed);
+        }
+        next_base = 1;
+    }
+
+    base = next_base;
+    next_base = base + static_cast<uint32_t>(frontier_size);
+}
+
+void PlaneSegmentation::FrontierStamps::visit(int index, uint32_t position)
+{
+    uint32_t stamp = base + position;
+    uint32_t current = p_stamps[index].load(memory_order_relaxed);
+
+    // Keep the smallest position of this gathering
+    while((current < base || current > stamp) &&
+          !p_stamps[index].compare_exchange_weak(current, stamp, memory_order_relaxed));
+}
+
 // ========================================================================================== //
 // PlaneSegmentation
 // ========================================================================================== //
@@ -61,28 +97,25 @@ int PlaneSegmentation::init(PointNormalKCloud::Ptr p_object, bool isSource)
     this->p_cloud = p_object;
 
     p_excluded_indices = boost::shared_ptr<vector<int>>(new vector<int>(0));
-    p_indices = boost::shared_ptr<vector<int>>(new vector<int>(p_cloud->points.size()));
-
-    #pragma omp parallel for
-    for(size_t i = 0; i < p_cloud->points.size(); ++i)
-    {
-        p_indices->at(i) = static_cast<int>(i);
-    }
-
-    cout << "PointIndices is filled" << endl;
-
-    // Fill kdtree search strucuture
-    p_kdtree = KdTreeFlannK::Ptr(new KdTreeFlannK);
+    frontier_stamps.clear();
+    frontier_stamps.resize(1);
+    is_seed_queue_built = false;
+    is_soa_built = false;
+    p_graph.reset();
+    original_indices.clear();
+
+    // Fill kdtree search strucuture, every point is available
+    p_kdtree = TombstoneKdTree::Ptr(new TombstoneKdTree(config.neighbor_search));
     p_kdtree->setInputCloud(p_cloud);
 
     if(p_cloud->points[0].k == 0)
     {
-        cout << "Loaded point cloud is not preprocessed." << endl;
+        LOG(INFO) << "Loaded point cloud is not preprocessed.";
         is_ready = false;
     }
     else
     {
-        cout << "Loaded point cloud is already preprocessed." << endl;
+        LOG(INFO) << "Loaded point cloud is already preprocessed.";
 
         is_ready = true;
     }
@@ -105,6 +138,23 @@ int PlaneSegmentation::init(PointNormalKCloud::Ptr p_object, bool isSource)
 
 int PlaneSegmentation::init(string cloud_file, bool isSource)
 {
+    if(PreprocessedCloudFile::isPreprocessedCloudFile(cloud_file))
+    {
+        PreprocessedCloudFile file;
+        if(!file.open(cloud_file)) return EXIT_FAILURE;
+
+        p_cloud = file.getCloud();
+        LOG(INFO) << "Preprocessed pointcloud containing " << p_cloud->points.size() << " points loaded.";
+
+        int r_init = this->init(p_cloud, isSource);
+
+        // The region growing reads the arrays of the file directly
+        p_soa = file.getSoA();
+        is_soa_built = true;
+        setNeighborGraph(file.getNeighborGraph());
+
+        return r_init;
+    }
 
     p_cloud = PointNormalKCloud::Ptr(new PointNormalKCloud);
 
@@ -116,22 +166,103 @@ int PlaneSegmentation::init(string cloud_file, bool isSource)
         return EXIT_FAILURE;
     }
 
-    cout << "Pointcloud containing " << p_cloud->points.size() << " points loaded." << endl;
+    LOG(INFO) << "Pointcloud containing " << p_cloud->points.size() << " points loaded.";
 
-    return this->init(p_cloud, isSource);
+    int r_init = this->init(p_cloud, isSource);
+
+    // Neighbor graph saved along with the preprocessed cloud
+    NeighborGraph::Ptr p_saved_graph(new NeighborGraph);
+    if(is_ready && p_saved_graph->load(NeighborGraph::getSidecarPath(cloud_file)))
+    {
+        setNeighborGraph(p_saved_graph);
+    }
+
+    return r_init;
+}
+
+int PlaneSegmentation::initResampled(string cloud_file, bool isSource)
+{
+    CloudStreamReader reader;
+    bool is_raw_cloud = !PreprocessedCloudFile::isPreprocessedCloudFile(cloud_file) && reader.open(cloud_file) && !reader.hasField("k");
+    reader.close();
+
+    if(!is_raw_cloud)
+    {
+        if(this->init(cloud_file, isSource) == EXIT_FAILURE) return EXIT_FAILURE;
+        if(!is_ready) resampleCloud();
+
+        return EXIT_SUCCESS;
+    }
+
+    VoxelGridResampler resampler(config.leaf_size);
+    if(!resampler.addFile(cloud_file)) return EXIT_FAILURE;
+
+    PointNormalKCloud::Ptr p_resampled = resampler.getCloud();
+    if(p_resampled->empty())
+    {
+        LOG(ERROR) << cloud_file << " does not contain any point";
+        return EXIT_FAILURE;
+    }
+
+    int r_init = this->init(p_resampled, isSource);
+    isResampled = true;
+
+    return r_init;
+}
+
+void PlaneSegmentation::setConfig(const AlignmentConfig &config)
+{
+    this->config = config;
+    cos_max_normal_angle = std::cos(config.max_normal_angle);
+    sqr_min_seed_distance = config.min_seed_distance * config.min_seed_distance;
+
+    if(p_kdtree) p_kdtree->setBackend(config.neighbor_search);
+}
+
+void PlaneSegmentation::setNeighborGraph(NeighborGraph::Ptr p_graph)
+{
+    if(p_graph && p_graph->size() != p_cloud->size())
+    {
+        LOG(WARNING) << "Neighbor graph of " << p_graph->size() << " points does not match the cloud, it is ignored.";
+        return;
+    }
+
+    this->p_graph = p_graph;
 }
 
 void PlaneSegmentation::preprocessCloud()
 {
     if(is_ready) return;
 
-    cout << "Starting normal, curvature and k computation." << endl;
+    if(config.morton_order && !isReordered()) reorderCloud();
 
-    NormalComputation nc;
-    nc.computeNormalCloud(p_cloud, p_kdtree, isResampled);
+    PreprocessingCache &cache = PreprocessingCache::get();
+    string cache_key = cache.isEnabled() ? PreprocessingCache::getKey(*p_cloud, config, isResampled) : "";
+
+    if(cache.isEnabled() && cache.load(cache_key, *p_cloud, p_graph))
+    {
+        LOG(INFO) << "Normals, curvatures and k read from the preprocessing cache.";
+        PROFILE_COUNT("preprocessing_cache_hits", 1);
+    }
+    else
+    {
+        LOG(INFO) << "Starting normal, curvature and k computation.";
+
+        NormalComputation nc;
+        nc.setConfig(config);
+        p_graph = NeighborGraph::Ptr(new NeighborGraph);
+        nc.computeNormalCloud(p_cloud, p_kdtree->getSearch(), isResampled, p_graph);
+
+        LOG(INFO) << "Normal computation successfully ended.";
+
+        if(cache.isEnabled()) cache.save(cache_key, *p_cloud, p_graph);
+    }
 
-    cout << "Normal computation successfully ended." << endl;
     is_ready = true;
+
+    // Curvatures changed, the seeds must be sorted again
+    is_seed_queue_built = false;
+    is_soa_built = false;
 }
 
 void PlaneSegmentation::resampleCloud()
@@ -140,24 +271,116 @@ void PlaneSegmentation::resampleCloud()
 
     is_ready = false;
 
-    PointNormalKCloud::Ptr p_cloud_filtered(new PointNormalKCloud);
+    VoxelGridResampler resampler(config.leaf_size);
+    resampler.addPoints(*p_cloud);
+    PointNormalKCloud::Ptr p_cloud_filtered = resampler.getCloud();
 
-    pcl::VoxelGrid<PointNormalK>::Ptr filter(new pcl::VoxelGrid<PointNormalK>);
-    filter->setInputCloud(p_cloud);
-    filter->setLeafSize(LEAF_SIZE, LEAF_SIZE, LEAF_SIZE);
-    filter->filter(*p_cloud_filtered);
-
-    cout << "Cloud filtered from " << p_cloud->size() << " to " << p_cloud_filtered->size() << " points." << endl;
+    LOG(INFO) << "Cloud filtered from " << p_cloud->size() << " to " << p_cloud_filtered->size() << " points.";
 
     p_cloud->clear();
     p_cloud = p_cloud_filtered;
 
-    p_indices->resize(p_cloud->size());
-    p_kdtree->setInputCloud(p_cloud, p_indices);
+    p_kdtree->setInputCloud(p_cloud);
+    is_seed_queue_built = false;
+    is_soa_built = false;
+    p_graph.reset();
+    original_indices.clear();
 
     isResampled = true;
 }
 
+/// Bits of v, up to the 21st, spread to every third bit.
+static uint64_t spreadBits(uint32_t v)
+{
+    uint64_t x = v & 0x1fffff;
+    x = (x | x << 32) & 0x1f00000000ffff;
+    x = (x | x << 16) & 0x1f0000ff0000ff;
+    x = (x | x << 8) & 0x100f00f00f00f00f;
+    x = (x | x << 4) & 0x10c30c30c30c30c3;
+    x = (x | x << 2) & 0x1249249249249249;
+    return x;
+}
+
+void PlaneSegmentation::reorderCloud()
+{
+    if(p_cloud->empty()) return;
+
+    if(!p_excluded_indices->empty() || isSegmented)
+    {
+        LOG(WARNING) << "Points are already excluded or segmented, the cloud is not reordered.";
+        return;
+    }
+
+    PROFILE_SCOPE("morton_order");
+
+    vec3 min_p(numeric_limits<float>::max(), numeric_limits<float>::max(), numeric_limits<float>::max());
+    vec3 max_p(numeric_limits<float>::lowest(), numeric_limits<float>::lowest(), numeric_limits<float>::lowest());
+    for(const PointNormalK &p: p_cloud->points)
+    {
+        min_p = min_p.cwiseMin(vec3(p.x, p.y, p.z));
+        max_p = max_p.cwiseMax(vec3(p.x, p.y, p.z));
+    }
+
+    // The same scale on every axis, cells of the curve are cubes
+    float extent = (max_p - min_p).maxCoeff();
+    float scale = extent > 0 ? 0x1fffff / extent : 0;
+
+    auto quantize = [scale](float offset) { return spreadBits(std::min(static_cast<uint32_t>(offset * scale), 0x1fffffu)); };
+
+    size_t nb_points = p_cloud->size();
+    vector<pair<uint64_t, int>> codes(nb_points);
+
+    #pragma omp parallel for
+    for(size_t i = 0; i < nb_points; ++i)
+    {
+        const PointNormalK &p = p_cloud->points[i];
+        uint64_t code = quantize(p.x - min_p.x()) | quantize(p.y - min_p.y()) << 1 | quantize(p.z - min_p.z()) << 2;
+        codes[i] = make_pair(code, static_cast<int>(i));
+    }
+
+    sort(codes.begin(), codes.end());
+
+    vector<int> order(nb_points);
+    decltype(p_cloud->points) points(nb_points);
+    for(size_t i = 0; i < nb_points; ++i)
+    {
+        order[i] = codes[i].second;
+        points[i] = p_cloud->points[order[i]];
+    }
+    p_cloud->points.swap(points);
+
+    if(p_graph) p_graph->permute(order);
+
+    // A second reordering composes with the first one
+    if(isReordered())
+    {
+        for(int &index: order) index = original_indices[index];
+    }
+    original_indices.swap(order);
+
+    p_kdtree->setInputCloud(p_cloud);
+    is_seed_queue_built = false;
+    is_soa_built = false;
+
+    LOG(DEBUG) << "Cloud of " << nb_points << " points sorted along a Morton curve.";
+}
+
+PointNormalKCloud::Ptr PlaneSegmentation::getPointCloudInOriginalOrder()
+{
+    if(!isReordered()) return p_cloud;
+
+    PointNormalKCloud::Ptr p_original(new PointNormalKCloud);
+    p_original->points.resize(p_cloud->size());
+    for(size_t i = 0; i < p_cloud->size(); ++i)
+    {
+        p_original->points[original_indices[i]] = p_cloud->points[i];
+    }
+    p_original->width = static_cast<uint32_t>(p_original->points.size());
+    p_original->height = 1;
+
+    return p_original;
+}
+
 void PlaneSegmentation::setViewerUpdateCallback(function<void(PointNormalKCloud::Ptr, ivec3, vector<int>, bool)> callable)
 {
     display_update_callable = callable;
@@ -182,27 +405,46 @@ void PlaneSegmentation::start_pause()
 {
     if(!is_ready)
     {
-        cout << "Can't start algorithm, not initialized properly" << endl;
+        LOG(ERROR) << "Can't start algorithm, not initialized properly";
         return;
     }
 
     if(isSegmented)
     {
-        cout << "The cloud is already segmented." << endl;
+        LOG(INFO) << "The cloud is already segmented.";
         return;
     }
 
     is_started = !is_started;
 }
 
+void PlaneSegmentation::setNbParallelSeeds(int nb_seeds)
+{
+    nb_parallel_seeds = std::max(1, nb_seeds);
+}
+
 void PlaneSegmentation::runMainLoop()
 {
+    PROFILE_SCOPE("segmentation");
+
+    if(!is_soa_built)
+    {
+        buildPointCloudSoA();
+    }
+
+    if(nb_parallel_seeds > 1)
+    {
+        runParallelMainLoop();
+        p_soa->copyPlaneIdsTo(*p_cloud);
+        return;
+    }
+
     int index = 0;
     while(dont_quit)
     {
         while(is_started && (index = getRegionGrowingStartLocation()) != -1)
         {
-            cout << "Starting new plane segmentation from index: " << index << endl;
+            LOG(DEBUG) << "Starting new plane segmentation from index: " << index;
 
             // Start of a new plane segmentation
             // -> reinitialise variables
@@ -215,7 +457,31 @@ void PlaneSegmentation::runMainLoop()
         {
             dont_quit = false;
             isSegmented = true;
-            cout << "Segmented " << p_segmented_points_container->getNbPlanes() << " planes. Excluded " << p_segmented_points_container->getNbOfExcludedPoints() << endl;
+            LOG(INFO) << "Segmented " << p_segmented_points_container->getNbPlanes() << " planes. Excluded " << p_segmented_points_container->getNbOfExcludedPoints();
+        }
+    }
+
+    // Plane ids are only written in the SoA copy during the segmentation
+    p_soa->copyPlaneIdsTo(*p_cloud);
+}
+
+void PlaneSegmentation::runParallelMainLoop()
+{
+    vector<int> seeds;
+    bool has_seeds = true;
+    while(dont_quit)
+    {
+        while(is_started && (has_seeds = getParallelStartLocations(nb_parallel_seeds, seeds)))
+        {
+            LOG(DEBUG) << "Starting " << seeds.size() << " concurrent plane segmentations.";
+            segmentPlanesInParallel(seeds);
+        }
+
+        if(!has_seeds)
+        {
+            dont_quit = false;
+            isSegmented = true;
+            LOG(INFO) << "Segmented " << p_segmented_points_container->getNbPlanes() << " planes. Excluded " << p_segmented_points_container->getNbOfExcludedPoints();
         }
     }
 }
@@ -224,21 +490,31 @@ void PlaneSegmentation::runOneStep()
 {
     if(isSegmented)
     {
-        cout << "The cloud is already segmented." << endl;
+        LOG(INFO) << "The cloud is already segmented.";
         return;
     }
 
     int index;
 
+    if(!is_soa_built)
+    {
+        buildPointCloudSoA();
+    }
+
     if(is_plane_initialized)
     {
         is_plane_initialized = regionGrowthOneStep();
+
+        if(!is_plane_initialized)
+        {
+            p_soa->copyPlaneIdsTo(*p_cloud);
+        }
     }
     else if((index = getRegionGrowingStartLocation()) != -1)
     {
         int new_plane_id = p_segmented_points_container->getNbPlanes() + 1;
         current_run.setupNextPlane(index, p_cloud->points[index], p_segmented_points_container->getNextPlaneColor(), new_plane_id);
-        initRegionGrowth();
+        initRegionGrowth(current_run);
         is_plane_initialized = true;
     }
 }
@@ -249,26 +525,28 @@ void PlaneSegmentation::stop()
     dont_quit = false;
 }
 
-bool PlaneSegmentation::initRegionGrowth()
+bool PlaneSegmentation::initRegionGrowth(RunProperties &run)
 {
-    current_run.p_nghbrs_indices->clear();
+    PROFILE_COUNT("seeds_tried", 1);
+
+    run.p_nghbrs_indices->clear();
 
-    // Get first neighborhood
-    vector<float> sqr_distances(current_run.root_p.k);
+    // Get first neighborhood, fewer than k points may be left at the end of the segmentation
+    vector<float> sqr_distances(run.root_p.k);
 
-    p_kdtree->nearestKSearch(current_run.root_p, current_run.root_p.k,
-                             *current_run.p_nghbrs_indices,
-                             sqr_distances);
+    int nb_found = p_kdtree->nearestKSearch(run.root_p, run.root_p.k,
+                                            *run.p_nghbrs_indices,
+                                            sqr_distances);
 
     // Compute mean of min distances in the neighborhood
-    current_run.max_search_distance = 3.0f * getMeanOfMinDistances();
+    run.max_search_distance = 3.0f * getMeanOfMinDistances(*run.p_nghbrs_indices);
 
-    float dist_to_kth = std::sqrt(sqr_distances[current_run.root_p.k - 1]);
+    float dist_to_kth = nb_found > 0 ? std::sqrt(sqr_distances[nb_found - 1]) : 0.0f;
 
     // At 10th iteration, we ensure that we are not trying to
     // segment an already treated zone.
-    if(current_run.plane_nb > 10 &&
-            (dist_to_kth > 3 * safety_distance / static_cast<float>(current_run.plane_nb)))
+    if(run.plane_nb > 10 &&
+            (dist_to_kth > 3 * safety_distance / static_cast<float>(run.plane_nb)))
     {
         // This means that the algo is looking an area
         // that has probably been already processed and is
@@ -278,11 +556,12 @@ bool PlaneSegmentation::initRegionGrowth()
         // Thus, we add the points to exclusion list since we don't want to
         // consider them again.
 
-        cout << "Trying to start segmentation in already classified area. Point index: " << current_run.p_index << endl;
+        LOG(DEBUG) << "Trying to start segmentation in already classified area. Point index: " << run.p_index;
 
         // Add to exclusion list
-        exclude_points(*current_run.p_nghbrs_indices);
-        p_segmented_points_container->addExcludedPoints(*current_run.p_nghbrs_indices);
+        exclude_points(*run.p_nghbrs_indices);
+        p_segmented_points_container->addExcludedPoints(*run.p_nghbrs_indices);
+        PROFILE_COUNT("seeds_rejected", 1);
 
         return false;
     }
@@ -291,10 +570,10 @@ bool PlaneSegmentation::initRegionGrowth()
     safety_distance += dist_to_kth;
 
     // Display selected points in green and root point in blue
-    color_points(*current_run.p_nghbrs_indices, ivec3(15, 255, 15));
-    color_point(current_run.p_index, ivec3(15, 15, 255));
+    color_points(*run.p_nghbrs_indices, ivec3(15, 255, 15));
+    color_point(run.p_index, ivec3(15, 15, 255));
 
-    cout << "Starting plane " << current_run.plane_nb << " at index " << current_run.p_index << endl;
+    LOG(DEBUG) << "Starting plane " << run.plane_nb << " at index " << run.p_index;
 
     return true;
 }
@@ -309,253 +588,641 @@ void PlaneSegmentation::performRegionGrowth()
 
 bool PlaneSegmentation::regionGrowthOneStep()
 {
-    cout << "Plane " << current_run.plane_nb << ": iteration " << current_run.iteration << " current size " << current_run.p_nghbrs_indices->size() << endl;
+    LOG(TRACE) << "Plane " << current_run.plane_nb << ": iteration " << current_run.iteration << " current size " << current_run.p_nghbrs_indices->size();
 
     // Check for termination conditions
-    if((p_segmented_points_container->getNbOfSegmentedPoints() > 0.9 * p_cloud->size()) ||
-            (p_indices->size() == 0))
+    if(isSegmentationComplete())
     {
-        cout << "Majority of points have been segmented -> Success" << endl;
+        LOG(DEBUG) << "Majority of points have been segmented -> Success";
 
         // majority of points have been segmented -> Success
         stop();
         return false;
     }
 
-    current_run.prev_size = current_run.p_nghbrs_indices->size();
+    GrowthStatus status = prepareRegionGrowthStep(current_run);
+
+    if(status == GROWING)
+    {
+        vector<int> points_in_plane;
+        findPointsInPlane(current_run, points_in_plane);
+        status = growNeighborhood(current_run, points_in_plane);
+    }
+
+    return commitRegionGrowthStep(current_run, status);
+}
+
+bool PlaneSegmentation::isSegmentationComplete()
+{
+    return (p_segmented_points_container->getNbOfSegmentedPoints() > 0.9 * p_cloud->size()) ||
+            (p_kdtree->getNbAlive() == 0);
+}
+
+PlaneSegmentation::GrowthStatus PlaneSegmentation::prepareRegionGrowthStep(RunProperties &run)
+{
+    PROFILE_COUNT("region_iterations", 1);
+
+    run.prev_size = run.p_nghbrs_indices->size();
 
     // If first 3 iterations, check area for valid plane
-    if(current_run.iteration == PHASE1_ITERATIONS)
+    if(run.iteration == config.phase1_iterations)
     {
-        if(!PFHEvaluation::isValidPlane(p_cloud, *current_run.p_nghbrs_indices))
+        if(!PFHEvaluation::isValidPlane(p_cloud, *run.p_nghbrs_indices, config.plane_treshold))
         {
-            cout << "Current plane is invalid" << endl;
-            // Add to exclusion
-            exclude_points(*current_run.p_nghbrs_indices);
-            p_segmented_points_container->addExcludedPoints(*current_run.p_nghbrs_indices);
-
-            return false;
+            LOG(DEBUG) << "Current plane is invalid";
+            return INVALID_PLANE;
         }
 
-        cout << "Current plane is valid" << endl;
+        LOG(DEBUG) << "Current plane is valid";
 
         // We are on a plane -> increase search radius to speed things up
-        current_run.max_search_distance *= 2.0f;
+        run.max_search_distance *= 2.0f;
     }
 
     // Check if neighborhood has shrinked
-    if(planeHasShrinked())
+    if(planeHasShrinked(run))
     {
-        cout << "Current plane has shrinked" << endl;
-
-        // Exclude starting point
-        vector<int> rootP;
-        rootP.push_back(current_run.p_index);
-        exclude_points(rootP);
-        p_segmented_points_container->addExcludedPoint(current_run.p_index);
-
-        return false;
+        LOG(DEBUG) << "Current plane has shrinked";
+        return SHRINKED;
     }
 
     // Compute current plane
-    if(current_run.iteration < PHASE1_ITERATIONS ||
-            current_run.p_nghbrs_indices->size() < MIN_STABLE_SIZE)
+    if(run.iteration < config.phase1_iterations ||
+            run.p_nghbrs_indices->size() < static_cast<size_t>(config.min_stable_size))
     {
-        cout << "Computing new plane parameters" << endl;
-        Plane curr_plane;
-        Plane::estimatePlane(p_cloud, current_run.p_nghbrs_indices, curr_plane);
-        current_run.plane = curr_plane;
-
-        // Update epsilon
-        current_run.epsilon = curr_plane.getPlaneTolerance(p_cloud, current_run.p_nghbrs_indices);
+        // The neighborhood is replaced at every step until the plane is stable, its sums are rebuilt
+        LOG(TRACE) << "Computing new plane parameters";
+        run.moments.reset(vec3(run.root_p.x, run.root_p.y, run.root_p.z));
+        run.moments.addPoints(*p_soa, *run.p_nghbrs_indices);
+        run.moments.fitPlane(run.plane);
+        run.moments.addDistances(*p_soa, *run.p_nghbrs_indices, run.plane);
     }
+    else
+    {
+        // Once stable, the sums were updated with the points accepted at the previous step only
+        run.moments.fitPlane(run.plane);
+    }
+
+    // The fit has no sign, the plane follows the normal of the seed so that the normals of its points can be compared to it
+    run.plane.orientAlong(vec3(run.root_p.normal_x, run.root_p.normal_y, run.root_p.normal_z));
+
+    // Update epsilon
+    run.epsilon = run.moments.getTolerance();
+
+    return GROWING;
+}
 
+void PlaneSegmentation::findPointsInPlane(RunProperties &run, vector<int> &points_in_plane)
+{
     // Find new candidates
     vector<int> candidates;
-    if(current_run.iteration <= PHASE1_ITERATIONS
-        || current_run.p_nghbrs_indices->size() < MIN_STABLE_SIZE
-        || current_run.p_new_points_indices->empty())
+    if(run.iteration <= config.phase1_iterations
+        || run.p_nghbrs_indices->size() < static_cast<size_t>(config.min_stable_size)
+        || run.p_new_points_indices->empty())
     {
-        getNeighborsOf(current_run.p_nghbrs_indices, current_run.max_search_distance, candidates);
+        getNeighborsOf(run.p_nghbrs_indices, frontier_stamps[run.rank], candidates);
     }
     else
     {
-        getNeighborsOf(current_run.p_new_points_indices, current_run.max_search_distance, candidates);
+        getNeighborsOf(run.p_new_points_indices, frontier_stamps[run.rank], candidates);
     }
 
-    cout << "Found " << candidates.size() << " candidates." << endl;
-    cout << "Epsilon = " << current_run.epsilon << endl;
+    LOG(TRACE) << "Found " << candidates.size() << " candidates.";
+    LOG(TRACE) << "Epsilon = " << run.epsilon;
 
-    // Test them with current plane
-    vector<int> points_in_plane;
+    // Test them with current plane, normals are only checked once the region is known to be a plane
+    points_in_plane.clear();
 
-    for(size_t i = 0; i < candidates.size(); ++i)
+    if(run.iteration >= config.phase1_iterations)
+    {
+        run.plane.filterPointsInPlane(*p_soa, candidates, run.epsilon, cos_max_normal_angle, points_in_plane);
+    }
+    else
     {
-        int index = candidates[i];
-        if(current_run.plane.pointInPlane(p_cloud->points[index], current_run.epsilon))
+        run.plane.filterPointsInPlane(*p_soa, candidates, run.epsilon, points_in_plane);
+    }
+
+    LOG(TRACE) << "Number of candidates in plane: " << points_in_plane.size();
+}
+
+PlaneSegmentation::GrowthStatus PlaneSegmentation::growNeighborhood(RunProperties &run, vector<int> &points_in_plane)
+{
+    // Add good candidates to neighborhood
+    bool was_stable = !run.p_new_points_indices->empty();
+    run.addToNeighborhood(points_in_plane, config);
+
+    // Accumulate the accepted points, with their distance to the plane they were tested against
+    if(!run.p_new_points_indices->empty())
+    {
+        if(!was_stable)
         {
-            if(current_run.iteration >= PHASE1_ITERATIONS)
-            {
-                if(current_run.plane.normalInPlane(p_cloud->points[index], MAX_NORMAL_ANGLE))
-                {
-                    points_in_plane.push_back(index);
-                }
-            }
-            else
-            {
-                points_in_plane.push_back(index);
-            }
+            // First stable step: the whole neighborhood was replaced one last time
+            run.moments.reset(vec3(run.root_p.x, run.root_p.y, run.root_p.z));
+            run.moments.addPoints(*p_soa, *run.p_nghbrs_indices);
+            run.moments.addDistances(*p_soa, *run.p_nghbrs_indices, run.plane);
+        }
+        else
+        {
+            run.moments.addPoints(*p_soa, *run.p_new_points_indices);
+            run.moments.addDistances(*p_soa, *run.p_new_points_indices, run.plane);
         }
     }
 
-    cout << "Number of candidates in plane: " << points_in_plane.size() << endl;
+    // Check for region growth stop
+    // Either the region stopped to grow naturally, or we are stuck in an infinite loop and we exit at iteration max_iterations
+    if(((run.iteration > config.phase1_iterations) &&
+            (run.prev_size == run.p_nghbrs_indices->size())) ||
+            (run.iteration == config.max_iterations))
+    {
+        return FINISHED;
+    }
 
-    // Add good candidates to neighborhood
-    current_run.addToNeighborhood(points_in_plane);
+    return GROWING;
+}
+
+bool PlaneSegmentation::commitRegionGrowthStep(RunProperties &run, GrowthStatus status)
+{
+    if(status == INVALID_PLANE)
+    {
+        // Add to exclusion
+        exclude_points(*run.p_nghbrs_indices);
+        p_segmented_points_container->addExcludedPoints(*run.p_nghbrs_indices);
+        PROFILE_COUNT("seeds_rejected", 1);
+
+        return false;
+    }
+
+    if(status == SHRINKED)
+    {
+        // Exclude starting point
+        vector<int> rootP;
+        rootP.push_back(run.p_index);
+        exclude_points(rootP);
+        p_segmented_points_container->addExcludedPoint(run.p_index);
+        PROFILE_COUNT("seeds_rejected", 1);
+
+        return false;
+    }
 
     // Update available Indices
-    if(current_run.p_nghbrs_indices->size() >= MIN_STABLE_SIZE && current_run.iteration >= PHASE1_ITERATIONS)
+    if(run.p_nghbrs_indices->size() >= static_cast<size_t>(config.min_stable_size) && run.iteration >= config.phase1_iterations)
     {
-        exclude_from_search(*current_run.p_new_points_indices);
+        exclude_from_search(*run.p_new_points_indices);
 
         // Color added points in green
-        color_points(*current_run.p_new_points_indices, ivec3(15, 255, 15));
+        color_points(*run.p_new_points_indices, ivec3(15, 255, 15));
     }
     else
     {
         // Color added points in green
-        color_points(*current_run.p_nghbrs_indices, ivec3(15, 255, 15));
+        color_points(*run.p_nghbrs_indices, ivec3(15, 255, 15));
     }
 
-    // Check for region growth stop
-    // Either the region stopped to grow naturally, or we are stuck in an infinite loop and we exit at iteration MAX_ITERATIONS
-    if(((current_run.iteration > PHASE1_ITERATIONS) &&
-            (current_run.prev_size == current_run.p_nghbrs_indices->size())) ||
-            (current_run.iteration == MAX_ITERATIONS))
+    if(status == FINISHED)
     {
-        cout << "Plane growth stopped, registering plane containing " << current_run.p_nghbrs_indices->size() << " points." << endl;
+        registerPlane(run);
+        return false;
+    }
+
+    LOG(TRACE) << "End of iteration nb " << run.iteration << ". New nb of points in plane: " << run.p_nghbrs_indices->size();
+    run.iteration++;
+
+    return true;
+}
 
-        // Computing the plane geometric center
-        current_run.plane.setCenter(computePlaneCenter(p_cloud, *current_run.p_nghbrs_indices));
+void PlaneSegmentation::registerPlane(RunProperties &run)
+{
+    LOG(DEBUG) << "Plane growth stopped, registering plane containing " << run.p_nghbrs_indices->size() << " points.";
+
+    PROFILE_COUNT("planes_registered", 1);
+
+    // Computing the plane geometric center
+    run.plane.setCenter(p_soa->computeCenter(*run.p_nghbrs_indices));
 
-        // Set plane_id of segmented planes
-        #pragma omp parallel for
-        for(size_t i = 0; i < current_run.p_nghbrs_indices->size(); ++i)
+    // Set plane_id of segmented planes
+    #pragma omp parallel for
+    for(size_t i = 0; i < run.p_nghbrs_indices->size(); ++i)
+    {
+        p_soa->plane_id[run.p_nghbrs_indices->at(i)] = run.plane_nb;
+    }
+
+    // store segmented plane
+    SegmentedPointsContainer::SegmentedPlane plane(run.plane_nb, run.curr_color, *run.p_nghbrs_indices, run.plane);
+    p_segmented_points_container->addSegmentedPoints(plane);
+    color_points(*run.p_nghbrs_indices, run.curr_color);
+    exclude_from_search(*run.p_nghbrs_indices);
+}
+
+void PlaneSegmentation::segmentPlane()
+{
+    PROFILE_SCOPE("plane_growth");
+
+    LOG(DEBUG) << "Thread " << omp_get_thread_num() << " starting segmentation.";
+
+    if(initRegionGrowth(current_run))
+    {
+        performRegionGrowth();
+    }
+}
+
+void PlaneSegmentation::segmentPlanesInParallel(const vector<int> &seeds)
+{
+    PROFILE_SCOPE("parallel_plane_growth");
+
+    const int nb_runs = static_cast<int>(seeds.size());
+    vector<RunProperties> runs(nb_runs);
+    vector<GrowthStatus> status(nb_runs, GROWING);
+    vector<char> is_active(nb_runs, false);
+    vector<vector<int>> points_in_plane(nb_runs);
+    // Points whose claim is held by each run, released once the run ends or drops them from its neighborhood.
+    vector<vector<int>> claimed(nb_runs);
+    // Runs whose neighborhood was replaced by the points accepted at this step, instead of being extended.
+    vector<char> is_replaced(nb_runs, false);
+
+    if(frontier_stamps.size() < seeds.size()) frontier_stamps.resize(seeds.size());
+
+    if(point_claims_size != p_cloud->size())
+    {
+        point_claims_size = p_cloud->size();
+        p_point_claims.reset(new atomic<int64_t>[point_claims_size]);
+
+        for(size_t i = 0; i < point_claims_size; ++i)
         {
-            p_cloud->points[current_run.p_nghbrs_indices->at(i)].plane_id = current_run.plane_nb;
+            p_point_claims[i].store(UNCLAIMED, memory_order_relaxed);
         }
+    }
+
+    // Initialisations modify the search tree, they are done serially in rank order.
+    // The plane id and color are only given when the plane is registered, so that ids stay contiguous.
+    for(int r = 0; r < nb_runs; ++r)
+    {
+        int new_plane_id = p_segmented_points_container->getNbPlanes() + 1;
+        runs[r].setupNextPlane(seeds[r], p_cloud->points[seeds[r]], ivec3(15, 255, 15), new_plane_id);
+        runs[r].rank = r;
 
-        // store segmented plane
-        SegmentedPointsContainer::SegmentedPlane plane(current_run.plane_nb, current_run.curr_color, *current_run.p_nghbrs_indices, current_run.plane);
-        p_segmented_points_container->addSegmentedPoints(plane);
-        color_points(*current_run.p_nghbrs_indices, current_run.curr_color);
-        exclude_from_search(*current_run.p_nghbrs_indices);
+        if(!initRegionGrowth(runs[r])) continue;
 
-        return false;
+        int64_t key = getClaimKey(0, r, nb_runs);
+        claimPoints(*runs[r].p_nghbrs_indices, key, nb_runs);
+        keepOwnedPoints(*runs[r].p_nghbrs_indices, key, nb_runs, claimed[r]);
+        is_active[r] = !runs[r].p_nghbrs_indices->empty();
+    }
+
+    int step = 0;
+    while(is_started && find(is_active.begin(), is_active.end(), true) != is_active.end())
+    {
+        ++step;
+
+        // Check for termination conditions
+        if(isSegmentationComplete())
+        {
+            LOG(DEBUG) << "Majority of points have been segmented -> Success";
+            stop();
+            break;
+        }
+
+        // Every run grows by one step concurrently. The search tree is not modified during this phase.
+        #pragma omp parallel for schedule(dynamic, 1)
+        for(int r = 0; r < nb_runs; ++r)
+        {
+            if(!is_active[r]) continue;
+
+            is_replaced[r] = false;
+            status[r] = prepareRegionGrowthStep(runs[r]);
+            if(status[r] != GROWING) continue;
+
+            findPointsInPlane(runs[r], points_in_plane[r]);
+            claimPoints(points_in_plane[r], getClaimKey(step, r, nb_runs), nb_runs);
+        }
+
+        // Every claim of this step is known, each run only keeps the points it won.
+        #pragma omp parallel for schedule(dynamic, 1)
+        for(int r = 0; r < nb_runs; ++r)
+        {
+            if(!is_active[r] || status[r] != GROWING) continue;
+
+            keepOwnedPoints(points_in_plane[r], getClaimKey(step, r, nb_runs), nb_runs, claimed[r]);
+            is_replaced[r] = runs[r].p_new_points_indices->empty();
+            status[r] = growNeighborhood(runs[r], points_in_plane[r]);
+        }
+
+        // Exclusions, registrations and display updates are applied serially in rank order.
+        for(int r = 0; r < nb_runs; ++r)
+        {
+            if(!is_active[r]) continue;
+
+            LOG(TRACE) << "Plane " << runs[r].plane_nb << ": iteration " << runs[r].iteration << " current size " << runs[r].p_nghbrs_indices->size();
+
+            if(status[r] == FINISHED)
+            {
+                runs[r].plane_nb = p_segmented_points_container->getNbPlanes() + 1;
+                runs[r].curr_color = p_segmented_points_container->getNextPlaneColor();
+            }
+
+            is_active[r] = commitRegionGrowthStep(runs[r], status[r]);
+
+            if(!is_active[r])
+            {
+                releaseClaims(claimed[r]);
+            }
+            else if(is_replaced[r])
+            {
+                // Points left out of the new neighborhood are free for the other runs from the next step on
+                releaseDroppedClaims(claimed[r], *runs[r].p_nghbrs_indices);
+            }
+        }
     }
 
-    cout << "End of iteration nb " << current_run.iteration << ". New nb of points in plane: " << current_run.p_nghbrs_indices->size() << endl;
-    current_run.iteration++;
+    // Runs interrupted by a pause or by the termination conditions
+    for(int r = 0; r < nb_runs; ++r)
+    {
+        releaseClaims(claimed[r]);
+    }
+}
 
-    return true;
+int64_t PlaneSegmentation::getClaimKey(int step, int rank, int nb_runs)
+{
+    return static_cast<int64_t>(step) * nb_runs + rank;
 }
 
-void PlaneSegmentation::segmentPlane()
+void PlaneSegmentation::claimPoints(vector<int> &indices, int64_t key, int nb_runs)
 {
-    cout << "Thread " << omp_get_thread_num() << " starting segmentation." << endl;
+    int64_t step = key / nb_runs;
+    int64_t rank = key % nb_runs;
+
+    vector<int> kept;
+    kept.reserve(indices.size());
 
-    if(initRegionGrowth())
+    for(int index: indices)
     {
-        performRegionGrowth();
+        int64_t claim = p_point_claims[index].load(memory_order_relaxed);
+
+        // Points claimed by another run at a previous step are already part of its plane.
+        // Claims made during the current step are ignored, they are resolved by keepOwnedPoints.
+        if(claim != UNCLAIMED && claim / nb_runs < step && claim % nb_runs != rank) continue;
+
+        // Atomic min: the smallest key wins, whatever the order in which the claims are made.
+        while(claim > key && !p_point_claims[index].compare_exchange_weak(claim, key, memory_order_relaxed));
+
+        kept.push_back(index);
+    }
+
+    indices.swap(kept);
+}
+
+void PlaneSegmentation::keepOwnedPoints(vector<int> &indices, int64_t key, int nb_runs, vector<int> &new_claims)
+{
+    int64_t rank = key % nb_runs;
+
+    vector<int> kept;
+    kept.reserve(indices.size());
+
+    for(int index: indices)
+    {
+        int64_t claim = p_point_claims[index].load(memory_order_relaxed);
+
+        if(claim % nb_runs != rank) continue;
+
+        if(claim == key) new_claims.push_back(index);
+        kept.push_back(index);
+    }
+
+    indices.swap(kept);
+}
+
+void PlaneSegmentation::releaseClaims(vector<int> &indices)
+{
+    for(int index: indices)
+    {
+        p_point_claims[index].store(UNCLAIMED, memory_order_relaxed);
     }
+
+    indices.clear();
 }
 
-float PlaneSegmentation::getMeanOfMinDistances()
+void PlaneSegmentation::releaseDroppedClaims(vector<int> &claimed, const vector<int> &neighborhood)
+{
+    // Neighborhoods are only replaced until the plane is stable, they are small
+    vector<int> kept_points(neighborhood);
+    sort(kept_points.begin(), kept_points.end());
+
+    vector<int> kept;
+    kept.reserve(kept_points.size());
+
+    for(int index: claimed)
+    {
+        if(binary_search(kept_points.begin(), kept_points.end(), index))
+        {
+            kept.push_back(index);
+        }
+        else
+        {
+            p_point_claims[index].store(UNCLAIMED, memory_order_relaxed);
+        }
+    }
+
+    claimed.swap(kept);
+}
+
+float PlaneSegmentation::getMeanOfMinDistances(vector<int> &indices)
 {
     const int K(2);
     float acc(0);
+    int nb_distances(0);
 
-    #pragma omp parallel for shared(acc)
-    for(size_t i = 0; i < current_run.p_nghbrs_indices->size(); ++i)
+    #pragma omp parallel reduction(+:acc, nb_distances)
     {
-        int p_id = current_run.p_nghbrs_indices->at(i);
-        vector<int> indices(K);
+        vector<int> nn_indices(K);
         vector<float> sqrd_distances(K);
-        p_kdtree->nearestKSearch(p_cloud->points[p_id], K, indices, sqrd_distances);
-        float dist = std::sqrt(sqrd_distances[1]);
 
-        #pragma omp critical
-        acc += dist;
+        #pragma omp for
+        for(size_t i = 0; i < indices.size(); ++i)
+        {
+            // Points left alone in the tree have no nearest neighbor
+            int p_id = indices[i];
+            if(p_kdtree->nearestKSearch(p_cloud->points[p_id], K, nn_indices, sqrd_distances) < K) continue;
+
+            acc += std::sqrt(sqrd_distances[1]);
+            nb_distances++;
+        }
     }
 
-    return acc / current_run.p_nghbrs_indices->size();
+    return nb_distances > 0 ? acc / nb_distances : 0.0f;
 }
 
 int PlaneSegmentation::getRegionGrowingStartLocation()
 {
-    if(p_indices->size() == 0)
+    if(p_kdtree->getNbAlive() == 0)
     {
-        cout << "No available index. Segmentation stopped." << endl;
+        LOG(DEBUG) << "No available index. Segmentation stopped.";
         return -1;
     }
 
-    // Copy indices
-    vector<int> tmp_indices(*p_indices);
-    sort(tmp_indices.begin(), tmp_indices.end(), [this](const int &lhs, const int &rhs){
-        return this->p_cloud->points[lhs].curvature < this->p_cloud->points[rhs].curvature;
-    });
+    if(!is_seed_queue_built)
+    {
+        buildSeedQueue();
+    }
 
-    return tmp_indices.at(0);
+    // Lazy deletion: points excluded since they were pushed are only removed when they reach the top.
+    while(!seed_queue.empty() && !p_kdtree->isAlive(seed_queue.top().second))
+    {
+        seed_queue.pop();
+    }
+
+    if(seed_queue.empty())
+    {
+        LOG(DEBUG) << "No available index. Segmentation stopped.";
+        return -1;
+    }
+
+    // The seed is not popped: if it is not excluded by the region growth, it will be selected again.
+    return seed_queue.top().second;
 }
 
-void PlaneSegmentation::getNeighborsOf(boost::shared_ptr<vector<int>> indices_in, float search_d, vector<int> &indices_out)
+void PlaneSegmentation::buildSeedQueue()
 {
-    vector<vector<int>> candidates_lists(indices_in->size());
-    size_t total_size = 0;
+    vector<int> indices = p_kdtree->getAliveIndices();
+    vector<SeedCandidate> seeds(indices.size());
 
-    #pragma omp parallel for shared(candidates_lists, total_size)
-    for(size_t i = 0; i < indices_in->size(); ++i)
+    #pragma omp parallel for
+    for(size_t i = 0; i < indices.size(); ++i)
     {
-        int p_id = indices_in->at(i);
-        vector<float> distances;
+        int index = indices[i];
+        seeds[i] = SeedCandidate(p_soa->curvature[index], index);
+    }
+
+    // Heapify in O(N), ties on curvature are broken by the smallest point index.
+    seed_queue = priority_queue<SeedCandidate, vector<SeedCandidate>, greater<SeedCandidate>>(greater<SeedCandidate>(), move(seeds));
+    is_seed_queue_built = true;
+}
 
-        // Nearest K search is way faster than radius search for kdtrees
-        p_kdtree->nearestKSearch(p_cloud->points[p_id], p_cloud->points[p_id].k, candidates_lists[i], distances);
+bool PlaneSegmentation::getParallelStartLocations(int nb_seeds, vector<int> &seeds)
+{
+    seeds.clear();
 
-        #pragma omp critical
-        total_size += candidates_lists[i].size();
-    }
+    if(getRegionGrowingStartLocation() == -1) return false;
+
+    // Seeds are taken by increasing curvature, skipping the ones too close to an already selected seed.
+    // The number of examined candidates is bounded, to not empty the heap when the remaining points are clustered.
+    const size_t max_examined = 64 * static_cast<size_t>(nb_seeds);
+    vector<SeedCandidate> examined;
+
+    while(seeds.size() < static_cast<size_t>(nb_seeds) && examined.size() < max_examined && !seed_queue.empty())
+    {
+        SeedCandidate candidate = seed_queue.top();
+        seed_queue.pop();
 
-    indices_out.reserve(total_size);
+        if(!p_kdtree->isAlive(candidate.second)) continue;
 
-    // Merging all lists of candidates in one list
-    for(int j = 0; j < candidates_lists.size(); ++j)
+        examined.push_back(candidate);
+
+        vec3 p = p_soa->getPoint(candidate.second);
+        bool is_far = all_of(seeds.begin(), seeds.end(), [&p, this](int seed){
+            return squaredDistance(p, this->p_soa->getPoint(seed)) > this->sqr_min_seed_distance;
+        });
+
+        if(is_far) seeds.push_back(candidate.second);
+    }
+
+    // Seeds are not consumed: the ones that are not excluded by the region growth will be selected again.
+    for(SeedCandidate &candidate: examined)
     {
-        indices_out.insert(indices_out.end(), candidates_lists[j].begin(), candidates_lists[j].end());
+        seed_queue.push(candidate);
     }
 
-    // Remove duplicates
-    sort(indices_out.begin(), indices_out.end());
-    vector<int>::iterator it = unique(indices_out.begin(), indices_out.end());
-    indices_out.resize(std::distance(indices_out.begin(), it));
+    return true;
 }
 
-void PlaneSegmentation::exclude_from_search(vector<int> &indices)
+void PlaneSegmentation::buildPointCloudSoA()
 {
-    // Ensure that the given list is sorted
-    sort(indices.begin(), indices.end());
+    if(!p_soa) p_soa = PointCloudSoA::Ptr(new PointCloudSoA);
 
-    // Remove points from available indices list
-    boost::shared_ptr<vector<int>> tmp(new vector<int>(0));
-    set_difference(p_indices->begin(), p_indices->end(), indices.begin(), indices.end(), back_inserter(*tmp));
-    p_indices = tmp;
+    p_soa->fromCloud(*p_cloud);
+    is_soa_built = true;
+}
+
+void PlaneSegmentation::getNeighborsOf(boost::shared_ptr<vector<int>> indices_in, FrontierStamps &stamps, vector<int> &indices_out)
+{
+    stamps.begin(p_cloud->size(), indices_in->size());
 
-    cout << "Adding " << indices.size() << " to exclusion list" << endl;
+    // Runs grown in parallel already use every thread, their frontiers are then scanned by the calling thread alone
+    int nb_threads = omp_get_level() > 0 ? 1 : omp_get_max_threads();
 
-    if(p_indices->size() == 0) return;
+    // Candidates found by each thread with the position of the frontier point that reached them,
+    // concatenated in thread order once their sizes are known
+    vector<vector<int>> thread_candidates(nb_threads);
+    vector<vector<uint32_t>> thread_positions(thread_candidates.size());
+    vector<size_t> thread_offsets(thread_candidates.size() + 1, 0);
 
-    // Update searching tree indices
-    p_kdtree->setInputCloud(p_cloud, p_indices);
+    #pragma omp parallel num_threads(nb_threads)
+    {
+        int t = omp_get_thread_num();
+        vector<int> &candidates = thread_candidates[t];
+        vector<uint32_t> &positions = thread_positions[t];
+        vector<int> nn_indices;
+        vector<float> distances;
+
+        #pragma omp for schedule(static) nowait
+        for(size_t i = 0; i < indices_in->size(); ++i)
+        {
+            int p_id = indices_in->at(i);
+
+            if(p_graph)
+            {
+                // Neighbors found during preprocessing, only the ones still available are candidates
+                for(const int *it = p_graph->rowBegin(p_id); it != p_graph->rowEnd(p_id); ++it)
+                {
+                    if(p_kdtree->isAlive(*it)) candidates.push_back(*it);
+                }
+            }
+            else
+            {
+                // Nearest K search is way faster than radius search for kdtrees
+                p_kdtree->nearestKSearch(p_cloud->points[p_id], p_soa->k[p_id], nn_indices, distances);
+                candidates.insert(candidates.end(), nn_indices.begin(), nn_indices.end());
+            }
+
+            for(size_t j = positions.size(); j < candidates.size(); ++j)
+            {
+                stamps.visit(candidates[j], static_cast<uint32_t>(i));
+            }
+            positions.resize(candidates.size(), static_cast<uint32_t>(i));
+        }
+
+        // Every visit must be done before checking which one came first
+        #pragma omp barrier
+
+        // Remove duplicates: a candidate is only kept by the first frontier point that reached it
+        size_t nb_kept = 0;
+        for(size_t j = 0; j < candidates.size(); ++j)
+        {
+            if(stamps.isFirstVisit(candidates[j], positions[j]))
+            {
+                candidates[nb_kept++] = candidates[j];
+            }
+        }
+        candidates.resize(nb_kept);
+
+        thread_offsets[t + 1] = candidates.size();
+
+        #pragma omp barrier
+        #pragma omp single
+        {
+            partial_sum(thread_offsets.begin(), thread_offsets.end(), thread_offsets.begin());
+            indices_out.resize(thread_offsets.back());
+        }
+
+        // Merging all lists of candidates in one list
+        copy(candidates.begin(), candidates.end(), indices_out.begin() + thread_offsets[t]);
+    }
+}
+
+void PlaneSegmentation::exclude_from_search(vector<int> &indices)
+{
+    // Points are only marked as removed in the searching tree, no rebuild needed
+    p_kdtree->remove(indices);
+
+    LOG(TRACE) << "Adding " << indices.size() << " to exclusion list";
 }
 
 void PlaneSegmentation::exclude_points(vector<int> indices)
@@ -576,6 +1243,7 @@ void PlaneSegmentation::filterOutCurvature(float max_curvature)
 {
     // Fill vector of points' indices to exclude
     vector<int> indices;
+    boost::shared_ptr<vector<int>> p_indices = getAvailableIndices();
     copy_if(p_indices->begin(), p_indices->end(), back_inserter(indices), [&max_curvature, this](int index){
         return this->p_cloud->points[index].curvature > max_curvature;
     });
@@ -601,7 +1269,7 @@ PointNormalKCloud::Ptr PlaneSegmentation::getAvailablePointCloud()
     PointNormalKCloud::Ptr filtered(new PointNormalKCloud);
     pcl::ExtractIndices<PointNormalK> extract;
     extract.setInputCloud(p_cloud);
-    extract.setIndices(p_indices);
+    extract.setIndices(getAvailableIndices());
     extract.setNegative(false);
     extract.filter(*filtered);
     return filtered;
@@ -612,34 +1280,15 @@ PointNormalKCloud::Ptr PlaneSegmentation::getExcludedPointCloud()
     PointNormalKCloud::Ptr filtered(new PointNormalKCloud);
     pcl::ExtractIndices<PointNormalK> extract;
     extract.setInputCloud(p_cloud);
-    extract.setIndices(p_indices);
+    extract.setIndices(getAvailableIndices());
     extract.setNegative(true);
     extract.filter(*filtered);
     return filtered;
 }
 
-bool PlaneSegmentation::planeHasShrinked()
-{
-    return current_run.p_nghbrs_indices->size() < MIN_PLANE_SIZE;
-}
-
-void PlaneSegmentation::reorient_normals(PointNormalKCloud::Ptr cloud_in, vector<int> indices, vec3 pn)
+bool PlaneSegmentation::planeHasShrinked(RunProperties &run)
 {
-    #pragma omp parallel for
-    for(size_t i = 0; i < indices.size(); ++i)
-    {
-        vec3 n = vec3(cloud_in->points[indices[i]].normal_x,
-                      cloud_in->points[indices[i]].normal_y,
-                      cloud_in->points[indices[i]].normal_z);
-
-        n = (acos(pn.dot(n)) <= acos(pn.dot(-n)))? n : -n;
-
-        cloud_in->points[indices[i]].normal_x = n.x();
-        cloud_in->points[indices[i]].normal_y = n.y();
-        cloud_in->points[indices[i]].normal_z = n.z();
-    }
-
-    update_normal_cloud_callable();
+    return run.p_nghbrs_indices->size() < static_cast<size_t>(config.min_plane_size);
 }
 
 float PlaneSegmentation::getCurvBound()
@@ -657,7 +1306,7 @@ void PlaneSegmentation::fillSegmentedPointsContainer()
     //          If not:
     //              If the plane is already created -> Add the point index.
     //              Else -> Create the plane container and add the point.
-    for(int index: *p_indices)
+    for(int index = 0; index < static_cast<int>(p_cloud->size()); ++index)
     {
         if(p_cloud->points[index].plane_id == 0)
         {
@@ -694,3 +1343,8 @@ void PlaneSegmentation::callDisplayCallback(PointNormalKCloud::Ptr p_cloud, ivec
         this->display_update_callable(p_cloud, c, indices, isSource);
     }
 }
+
+boost::shared_ptr<vector<int>> PlaneSegmentation::getAvailableIndices()
+{
+    return boost::shared_ptr<vector<int>>(new vector<int>(p_kdtree->getAliveIndices()));
+}
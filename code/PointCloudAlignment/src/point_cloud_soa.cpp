@@ -0,0 +1,98 @@
+#include "point_cloud_soa.h"
+
+void PointCloudSoA::fromCloud(const PointNormalKCloud &cloud)
+{
+    allocate(cloud.size());
+
+    #pragma omp parallel for
+    for(size_t i = 0; i < nb_points; ++i)
+    {
+        const PointNormalK &p = cloud.points[i];
+        x[i] = p.x;
+        y[i] = p.y;
+        z[i] = p.z;
+        nx[i] = p.normal_x;
+        ny[i] = p.normal_y;
+        nz[i] = p.normal_z;
+        curvature[i] = p.curvature;
+        k[i] = static_cast<uint8_t>(std::min(p.k, static_cast<float>(MAX_K)));
+        plane_id[i] = p.plane_id;
+    }
+}
+
+void PointCloudSoA::toCloud(PointNormalKCloud &cloud) const
+{
+    #pragma omp parallel for
+    for(size_t i = 0; i < nb_points; ++i)
+    {
+        PointNormalK &p = cloud.points[i];
+        p.normal_x = nx[i];
+        p.normal_y = ny[i];
+        p.normal_z = nz[i];
+        p.curvature = curvature[i];
+        p.k = k[i];
+        p.plane_id = plane_id[i];
+    }
+}
+
+void PointCloudSoA::copyPlaneIdsTo(PointNormalKCloud &cloud) const
+{
+    #pragma omp parallel for
+    for(size_t i = 0; i < nb_points; ++i)
+    {
+        cloud.points[i].plane_id = plane_id[i];
+    }
+}
+
+vec3 PointCloudSoA::computeCenter(const vector<int> &indices) const
+{
+    vec3 center(0, 0, 0);
+
+    for(int i: indices)
+    {
+        center += vec3(x[i], y[i], z[i]);
+    }
+
+    center /= indices.size();
+
+    return center;
+}
+
+void PointCloudSoA::attach(char *data, size_t nb_points, boost::shared_ptr<void> owner)
+{
+    buffer.reset();
+    p_owner = owner;
+    setArrays(data, nb_points);
+}
+
+size_t PointCloudSoA::getDataSize(size_t nb_points)
+{
+    // Number of 4 bytes elements rounded up to a multiple of the alignment
+    const size_t stride = ((nb_points * 4 + ALIGNMENT - 1) / ALIGNMENT) * ALIGNMENT;
+    const size_t byte_stride = ((nb_points + ALIGNMENT - 1) / ALIGNMENT) * ALIGNMENT;
+
+    return 8 * stride + byte_stride;
+}
+
+void PointCloudSoA::allocate(size_t size)
+{
+    p_owner.reset();
+    buffer.reset(static_cast<char*>(aligned_alloc(ALIGNMENT, getDataSize(size) + ALIGNMENT)));
+    setArrays(buffer.get(), size);
+}
+
+void PointCloudSoA::setArrays(char *data, size_t size)
+{
+    const size_t stride = ((size * 4 + ALIGNMENT - 1) / ALIGNMENT) * ALIGNMENT;
+
+    nb_points = size;
+    x = reinterpret_cast<float*>(data);
+    y = reinterpret_cast<float*>(data + stride);
+    z = reinterpret_cast<float*>(data + 2 * stride);
+    nx = reinterpret_cast<float*>(data + 3 * stride);
+    ny = reinterpret_cast<float*>(data + 4 * stride);
+    nz = reinterpret_cast<float*>(data + 5 * stride);
+    curvature = reinterpret_cast<float*>(data + 6 * stride);
+    plane_id = reinterpret_cast<int32_t*>(data + 7 * stride);
+    k = reinterpret_cast<uint8_t*>(data + 8 * stride);
+}
@@ -0,0 +1,156 @@
+#include "preprocessed_cloud_file.h"
+
+#include <cstring>
+
+bool PreprocessedCloudFile::save(string filename, const PointNormalKCloud &cloud, NeighborGraph::Ptr p_graph)
+{
+    ofstream out(filename, ios::out | ios::binary | ios::trunc);
+    if(!out.is_open())
+    {
+        LOG(ERROR) << "Could not write preprocessed cloud in " << filename;
+        return false;
+    }
+
+    Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.flags = p_graph ? HAS_GRAPH : 0;
+    header.nb_points = cloud.size();
+
+    // The header is written again once the sections are placed
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    pad(out);
+
+    PointCloudSoA soa(cloud);
+    header.soa_offset = out.tellp();
+    out.write(soa.getData(), PointCloudSoA::getDataSize(cloud.size()));
+    pad(out);
+
+    vector<uint32_t> rgba(cloud.size());
+    for(size_t i = 0; i < cloud.size(); ++i)
+    {
+        rgba[i] = cloud.points[i].rgba;
+    }
+    header.rgba_offset = out.tellp();
+    out.write(reinterpret_cast<const char*>(rgba.data()), rgba.size() * sizeof(uint32_t));
+    pad(out);
+
+    if(p_graph)
+    {
+        header.graph_offset = out.tellp();
+        p_graph->write(out);
+        header.graph_size = static_cast<uint64_t>(out.tellp()) - header.graph_offset;
+    }
+
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    return out.good();
+}
+
+bool PreprocessedCloudFile::isPreprocessedCloudFile(string filename)
+{
+    ifstream in(filename, ios::in | ios::binary);
+    char magic[sizeof(MAGIC)];
+
+    return in.read(magic, sizeof(magic)) && memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+bool PreprocessedCloudFile::open(string filename)
+{
+    p_header = nullptr;
+    p_file = MappedFile::Ptr(new MappedFile);
+
+    if(!p_file->open(filename))
+    {
+        LOG(ERROR) << "Could not read " << filename;
+        return false;
+    }
+
+    const Header *header = reinterpret_cast<const Header*>(p_file->getData());
+    size_t size = p_file->getSize();
+
+    if(size < sizeof(Header) || memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0 || header->version != VERSION)
+    {
+        LOG(ERROR) << filename << " is not a preprocessed cloud of version " << VERSION << ", it must be preprocessed again";
+        return false;
+    }
+
+    // Every section must be aligned and fit in the file
+    bool is_valid = header->nb_points < (size / 4) &&
+            header->soa_offset % ALIGNMENT == 0 &&
+            header->soa_offset + PointCloudSoA::getDataSize(header->nb_points) <= size &&
+            header->rgba_offset % ALIGNMENT == 0 &&
+            header->rgba_offset + header->nb_points * sizeof(uint32_t) <= size;
+
+    if(header->flags & HAS_GRAPH)
+    {
+        is_valid = is_valid && header->graph_offset <= size && header->graph_size <= size - header->graph_offset;
+    }
+
+    if(!is_valid)
+    {
+        LOG(ERROR) << filename << " is truncated or corrupted";
+        return false;
+    }
+
+    p_header = header;
+
+    return true;
+}
+
+PointCloudSoA::Ptr PreprocessedCloudFile::getSoA()
+{
+    PointCloudSoA::Ptr p_soa(new PointCloudSoA);
+    if(p_header == nullptr) return p_soa;
+
+    p_soa->attach(p_file->getData() + p_header->soa_offset, p_header->nb_points, p_file);
+
+    return p_soa;
+}
+
+PointNormalKCloud::Ptr PreprocessedCloudFile::getCloud()
+{
+    PointNormalKCloud::Ptr p_cloud(new PointNormalKCloud);
+    if(p_header == nullptr) return p_cloud;
+
+    PointCloudSoA::Ptr p_soa = getSoA();
+    const uint32_t *rgba = reinterpret_cast<const uint32_t*>(p_file->getData() + p_header->rgba_offset);
+
+    p_cloud->resize(p_header->nb_points);
+
+    #pragma omp parallel for
+    for(size_t i = 0; i < p_cloud->size(); ++i)
+    {
+        PointNormalK &p = p_cloud->points[i];
+        p.x = p_soa->x[i];
+        p.y = p_soa->y[i];
+        p.z = p_soa->z[i];
+        p.rgba = rgba[i];
+    }
+
+    p_soa->toCloud(*p_cloud);
+
+    return p_cloud;
+}
+
+NeighborGraph::Ptr PreprocessedCloudFile::getNeighborGraph()
+{
+    if(p_header == nullptr || !(p_header->flags & HAS_GRAPH)) return nullptr;
+
+    NeighborGraph::Ptr p_graph(new NeighborGraph);
+    if(!p_graph->read(p_file->getData() + p_header->graph_offset, p_header->graph_size, "Neighbor graph of the preprocessed cloud"))
+    {
+        return nullptr;
+    }
+
+    return p_graph;
+}
+
+void PreprocessedCloudFile::pad(ofstream &out)
+{
+    static const char zeros[ALIGNMENT] = {0};
+    size_t position = out.tellp();
+    out.write(zeros, (ALIGNMENT - position % ALIGNMENT) % ALIGNMENT);
+}
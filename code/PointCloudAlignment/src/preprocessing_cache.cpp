@@ -0,0 +1,135 @@
+#include "preprocessing_cache.h"
+
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+#include <unistd.h>
+
+PreprocessingCache &PreprocessingCache::get()
+{
+    static PreprocessingCache cache;
+    return cache;
+}
+
+bool PreprocessingCache::setDirectory(string directory)
+{
+    this->directory.clear();
+    if(directory.empty()) return true;
+
+    boost::system::error_code error;
+    boost::filesystem::create_directories(directory, error);
+    if(error || !boost::filesystem::is_directory(directory))
+    {
+        LOG(ERROR) << "Could not create the preprocessing cache directory " << directory;
+        return false;
+    }
+
+    this->directory = directory;
+    return true;
+}
+
+/// Finalizer of splitmix64, a bijection that spreads every bit of x over the whole result.
+static uint64_t mix(uint64_t x)
+{
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111eb;
+    return x ^ (x >> 31);
+}
+
+static uint32_t floatBits(float f)
+{
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    return bits;
+}
+
+string PreprocessingCache::getKey(const PointNormalKCloud &cloud, const AlignmentConfig &config, bool is_resampled)
+{
+    int max_k = is_resampled ? config.max_k_resampled : config.max_k_original;
+
+    // Two independent 64 bits hashes, collisions between different clouds are then out of reach
+    uint64_t h1 = mix(cloud.size() ^ 0x5043415052455052);
+    uint64_t h2 = mix(cloud.size() ^ 0x4341434845000001);
+
+    for(const PointNormalK &p: cloud.points)
+    {
+        uint64_t xy = static_cast<uint64_t>(floatBits(p.x)) << 32 | floatBits(p.y);
+        uint64_t z = floatBits(p.z);
+        h1 = mix(mix(h1 ^ xy) ^ z);
+        h2 = mix(h2 + xy * 0x9e3779b97f4a7c15 + z);
+    }
+
+    uint64_t parameters = static_cast<uint64_t>(floatBits(config.leaf_size)) << 32 |
+                          static_cast<uint64_t>(config.min_k & 0xffff) << 16 | static_cast<uint64_t>(max_k & 0xffff);
+
+    // The backends break distance ties differently, the k estimated and the graph may differ
+    uint64_t backend = static_cast<uint64_t>(config.neighbor_search);
+
+    h1 = mix(mix(mix(h1 ^ parameters) ^ backend) ^ VERSION);
+    h2 = mix(h2 + parameters + backend * 0x9e3779b97f4a7c15 + VERSION);
+
+    stringstream key;
+    key << hex << setfill('0') << setw(16) << h1 << setw(16) << h2;
+    return key.str();
+}
+
+bool PreprocessingCache::load(string key, PointNormalKCloud &cloud, NeighborGraph::Ptr &p_graph) const
+{
+    if(!isEnabled() || !boost::filesystem::exists(getPath(key))) return false;
+
+    PreprocessedCloudFile file;
+    if(!file.open(getPath(key).string()) || file.getNbPoints() != cloud.size()) return false;
+
+    PointNormalKCloud::Ptr p_entry = file.getCloud();
+    for(size_t i = 0; i < cloud.size(); ++i)
+    {
+        const PointNormalK &p = cloud.points[i], &q = p_entry->points[i];
+        if(p.x != q.x || p.y != q.y || p.z != q.z)
+        {
+            LOG(WARNING) << "Preprocessing cache entry " << key << " does not match the cloud, it is ignored.";
+            return false;
+        }
+    }
+
+    for(size_t i = 0; i < cloud.size(); ++i)
+    {
+        PointNormalK &p = cloud.points[i];
+        const PointNormalK &q = p_entry->points[i];
+        p.normal_x = q.normal_x;
+        p.normal_y = q.normal_y;
+        p.normal_z = q.normal_z;
+        p.curvature = q.curvature;
+        p.k = q.k;
+    }
+
+    p_graph = file.getNeighborGraph();
+
+    return true;
+}
+
+bool PreprocessingCache::save(string key, const PointNormalKCloud &cloud, NeighborGraph::Ptr p_graph) const
+{
+    if(!isEnabled()) return false;
+
+    // Readers never see a partially written entry
+    boost::filesystem::path path = getPath(key);
+    boost::filesystem::path temporary_path = path.string() + "." + to_string(getpid()) + ".tmp";
+
+    boost::system::error_code error;
+    if(!PreprocessedCloudFile::save(temporary_path.string(), cloud, p_graph))
+    {
+        boost::filesystem::remove(temporary_path, error);
+        return false;
+    }
+
+    boost::filesystem::rename(temporary_path, path, error);
+    if(error)
+    {
+        LOG(ERROR) << "Could not write the preprocessing cache entry " << path.string();
+        boost::filesystem::remove(temporary_path, error);
+        return false;
+    }
+
+    return true;
+}
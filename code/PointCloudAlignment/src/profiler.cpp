@@ -0,0 +1,202 @@
+#include "profiler.h"
+
+Profiler::Profiler(): enabled(false), context(NO_CONTEXT), origin(chrono::steady_clock::now())
+{
+}
+
+Profiler &Profiler::get()
+{
+    static Profiler profiler;
+    return profiler;
+}
+
+void Profiler::clear()
+{
+    lock_guard<mutex> lock(buffers_mutex);
+
+    for(auto &buffer: buffers)
+    {
+        buffer->scopes.clear();
+        buffer->counters.clear();
+    }
+}
+
+int64_t Profiler::now() const
+{
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - origin).count();
+}
+
+Profiler::ThreadBuffer &Profiler::getThreadBuffer()
+{
+    // The buffer of a thread is owned by the registry, so that it outlives the thread
+    thread_local ThreadBuffer *p_buffer = nullptr;
+
+    if(p_buffer == nullptr)
+    {
+        lock_guard<mutex> lock(buffers_mutex);
+        buffers.emplace_back(new ThreadBuffer);
+        buffers.back()->thread_id = static_cast<int>(buffers.size()) - 1;
+        p_buffer = buffers.back().get();
+    }
+
+    return *p_buffer;
+}
+
+void Profiler::addScope(const char *name, int64_t start, int64_t duration, int64_t context)
+{
+    getThreadBuffer().scopes.push_back({name, start, duration, context});
+}
+
+void Profiler::addCount(const char *name, int64_t value)
+{
+    getThreadBuffer().counters[make_pair(name, getContext())] += value;
+}
+
+/// Durations are recorded in nanoseconds and written in milliseconds.
+static void writeMilliseconds(ostream &out, int64_t nanoseconds)
+{
+    out << static_cast<double>(nanoseconds) / 1000000.0;
+}
+
+void Profiler::writeTotals(ostream &out, const Totals &totals, string indent)
+{
+    out << indent << "\"timers\": {";
+    for(auto it = totals.timers.begin(); it != totals.timers.end(); ++it)
+    {
+        const Timer &timer = it->second;
+        out << (it == totals.timers.begin() ? "" : ",") << endl;
+        out << indent << "  \"" << it->first << "\": {\"calls\": " << timer.calls << ", \"total_ms\": ";
+        writeMilliseconds(out, timer.total);
+        out << ", \"min_ms\": ";
+        writeMilliseconds(out, timer.min);
+        out << ", \"max_ms\": ";
+        writeMilliseconds(out, timer.max);
+        out << "}";
+    }
+    out << (totals.timers.empty() ? "" : "\n" + indent) << "}," << endl;
+
+    out << indent << "\"counters\": {";
+    for(auto it = totals.counters.begin(); it != totals.counters.end(); ++it)
+    {
+        out << (it == totals.counters.begin() ? "" : ",") << endl;
+        out << indent << "  \"" << it->first << "\": " << it->second;
+    }
+    out << (totals.counters.empty() ? "" : "\n" + indent) << "}";
+}
+
+void Profiler::writeJSON(ostream &out) const
+{
+    lock_guard<mutex> lock(buffers_mutex);
+
+    Totals overall;
+    map<int64_t, Totals> contexts;
+
+    for(const auto &buffer: buffers)
+    {
+        for(const Scope &scope: buffer->scopes)
+        {
+            for(Totals *p_totals: {&overall, scope.context == NO_CONTEXT ? nullptr : &contexts[scope.context]})
+            {
+                if(p_totals == nullptr) continue;
+
+                Timer &timer = p_totals->timers[scope.name];
+                timer.calls++;
+                timer.total += scope.duration;
+                timer.min = std::min(timer.min, scope.duration);
+                timer.max = std::max(timer.max, scope.duration);
+            }
+        }
+
+        for(const auto &counter: buffer->counters)
+        {
+            overall.counters[counter.first.first] += counter.second;
+            if(counter.first.second != NO_CONTEXT) contexts[counter.first.second].counters[counter.first.first] += counter.second;
+        }
+    }
+
+    out << "{" << endl;
+    writeTotals(out, overall, "  ");
+    out << "," << endl << "  \"contexts\": [";
+
+    for(auto it = contexts.begin(); it != contexts.end(); ++it)
+    {
+        out << (it == contexts.begin() ? "" : ",") << endl;
+        out << "    {" << endl << "      \"context\": " << it->first << "," << endl;
+        writeTotals(out, it->second, "      ");
+        out << endl << "    }";
+    }
+
+    out << (contexts.empty() ? "" : "\n  ") << "]" << endl << "}" << endl;
+}
+
+void Profiler::writeChromeTrace(ostream &out) const
+{
+    lock_guard<mutex> lock(buffers_mutex);
+
+    // Timestamps are in microseconds since the creation of the registry, they need more than the default precision
+    ios::fmtflags flags = out.flags();
+    streamsize precision = out.precision(3);
+    out << fixed;
+
+    out << "{\"traceEvents\": [";
+    bool first = true;
+
+    // Complete events, in microseconds
+    for(const auto &buffer: buffers)
+    {
+        for(const Scope &scope: buffer->scopes)
+        {
+            out << (first ? "" : ",") << endl;
+            out << "  {\"name\": \"" << scope.name << "\", \"ph\": \"X\", \"pid\": 0, \"tid\": " << buffer->thread_id
+                << ", \"ts\": " << static_cast<double>(scope.start) / 1000.0 << ", \"dur\": " << static_cast<double>(scope.duration) / 1000.0;
+
+            if(scope.context != NO_CONTEXT)
+            {
+                out << ", \"args\": {\"context\": " << scope.context << "}";
+            }
+            out << "}";
+            first = false;
+        }
+    }
+
+    // Counters have no timestamps, their totals are given as metadata
+    map<string, int64_t> counters;
+    for(const auto &buffer: buffers)
+    {
+        for(const auto &counter: buffer->counters)
+        {
+            counters[counter.first.first] += counter.second;
+        }
+    }
+
+    out << endl << "], \"displayTimeUnit\": \"ms\", \"otherData\": {";
+    for(auto it = counters.begin(); it != counters.end(); ++it)
+    {
+        out << (it == counters.begin() ? "" : ", ") << "\"" << it->first << "\": " << it->second;
+    }
+    out << "}}" << endl;
+
+    out.flags(flags);
+    out.precision(precision);
+}
+
+bool Profiler::save(string filename, bool chrome_trace) const
+{
+    ofstream out(filename, ios::out | ios::trunc);
+    if(!out.is_open())
+    {
+        LOG(ERROR) << "Could not write profile in " << filename;
+        return false;
+    }
+
+    if(chrome_trace)
+    {
+        writeChromeTrace(out);
+    }
+    else
+    {
+        writeJSON(out);
+    }
+
+    return out.good();
+}
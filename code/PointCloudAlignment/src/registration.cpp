@@ -117,11 +117,13 @@ void Registration::highlightAssociatedPlanes()
     float error = get<2>(selected_planes[curr_highlighted_plane]);
 
     display_update_callable(source[source_id], target[target_id], ivec3(255, 255, 255));
-    cout << "Associated source " << source_id << " : " << source_surfaces[source_id] << " with target " << target_id << " : " << target_surfaces[target_id] << " with error: " << error << endl;
+    LOG(DEBUG) << "Associated source " << source_id << " : " << source_surfaces[source_id] << " with target " << target_id << " : " << target_surfaces[target_id] << " with error: " << error;
 }
 
 mat4 Registration::findAlignment()
 {
+    PROFILE_SCOPE("find_alignment");
+
     if(target.empty() || source.empty()) return mat4::Identity();
 
     selected_planes = planeTuplesWithFPFH();
@@ -132,8 +134,8 @@ mat4 Registration::findAlignment()
 
     T = findAndAddTranslation(R);
 
-    cout << "R: " << endl << R << endl;
-    cout << "Complete transformation: " << endl << T << endl;
+    LOG(DEBUG) << "R: " << endl << R;
+    LOG(DEBUG) << "Complete transformation: " << endl << T;
 
     return T;
 }
@@ -208,7 +210,7 @@ mat4 Registration::findAndAddTranslation(mat4 &R)
     // Compute translation matrix
     mat4 T = Eigen::Affine3f(Eigen::Translation3f(t_vec)).matrix();
 
-    cout << "T:" << endl << T << endl;
+    LOG(DEBUG) << "T:" << endl << T;
 
     return T * R;
 }
@@ -296,6 +298,8 @@ mat3 Registration::computeHwithCentroids(matX aggregation_m, vector<vec3> &l_cS,
 
 mat3 Registration::computeR(mat3 H)
 {
+    PROFILE_SCOPE("svd_rotation");
+
     Eigen::JacobiSVD<mat3> svd(H, Eigen::ComputeFullU | Eigen::ComputeFullV);
     mat3 u = svd.matrixU();
     mat3 v = svd.matrixV();
@@ -304,13 +308,13 @@ mat3 Registration::computeR(mat3 H)
 
     if(R.determinant() < 0.0f)
     {
-        cout << "det of R is less than 0" << endl;
-        cout << "Initial R: " << endl << R << endl;
+        LOG(DEBUG) << "det of R is less than 0";
+        LOG(DEBUG) << "Initial R: " << endl << R;
 
         v.col(2) = -1 * v.col(2);
         R = v * u.transpose();
 
-        cout << "Corrected R: " << endl << R << endl;
+        LOG(DEBUG) << "Corrected R: " << endl << R;
     }
 
     return R;
@@ -399,7 +403,7 @@ vector<float> Registration::computeAngleDifs(vector<vec3> &l_shifted_centroids,
 
     if(l_shifted_centroids.size() != l_planes.size())
     {
-        cout << "Computing Angle Diffs: Not same size of vectors... stopping" << endl;
+        LOG(ERROR) << "Computing Angle Diffs: Not same size of vectors... stopping";
         return angles;
     }
 
@@ -474,6 +478,8 @@ vector<float> Registration::computeDelaunaySurfaces(PointNormalKCloud::Ptr p_clo
 
 float Registration::computeDelaunaySurface(PointNormalKCloud::Ptr p_cloud, SegmentedPointsContainer::SegmentedPlane &plane)
 {
+    PROFILE_SCOPE("delaunay_surface");
+
     // Find Plane base
     vec3 e1, e2;
     computePlaneBase(plane, e1, e2);
@@ -582,8 +588,8 @@ vec2 Registration::compute2dCentroid(vector<vec2> l_points)
 
 Eigen::MatrixXf Registration::planeTuplesWithPFH(int source_nb)
 {
-    PFHCloud source_signs = PFHEvaluation::computePFHSignatures(source);
-    PFHCloud target_signs = PFHEvaluation::computePFHSignatures(target);
+    PFHCloud source_signs = PFHEvaluation::computePFHSignatures(source, config.center_knn);
+    PFHCloud target_signs = PFHEvaluation::computePFHSignatures(target, config.center_knn);
 
     // Construct indice list of planes
     vector<size_t> source_indices;
@@ -635,7 +641,8 @@ vector<PlaneTuples> Registration::planeTuplesWithFPFH()
     for (size_t i = 0; i < source_indices.size()/*std::min((int)source_indices.size(), source_nb)*/; ++i)
     {
         float error;
-        int j = PFHEvaluation::getMinTarget(source_indices[i], source_surfaces[source_indices[i]], target_surfaces, source_signs, target_signs, error);
+        int j = PFHEvaluation::getMinTarget(source_indices[i], source_surfaces[source_indices[i]], target_surfaces, source_signs, target_signs, error,
+                                             config.surface_interval);
 
         if(j > -1)
         {
@@ -733,6 +740,8 @@ float Registration::getAlignmentError()
 
 mat4 Registration::refineAlignment()
 {
+    PROFILE_SCOPE("refine_alignment");
+
     // Recompute distance errors after the transformation
     vector<float> new_distances = computeDistanceErrors();
 
@@ -743,8 +752,8 @@ mat4 Registration::refineAlignment()
     // Copy vector in case all are removed
     auto tmp_selected_planes = this->selected_planes;
     size_t i = 0;
-    auto it = remove_if(tmp_selected_planes.begin(), tmp_selected_planes.end(), [&i, &new_distances, &stdDev](tuple<size_t, size_t, float> t){
-        bool ret = (new_distances[i] > STD_DEV_MULT * stdDev);
+    auto it = remove_if(tmp_selected_planes.begin(), tmp_selected_planes.end(), [&i, &new_distances, &stdDev, this](tuple<size_t, size_t, float> t){
+        bool ret = (new_distances[i] > this->config.std_dev_mult * stdDev);
         i++;
         return ret;
     });
@@ -752,7 +761,7 @@ mat4 Registration::refineAlignment()
     // If tuples have been excluded that means that the alignement can possibly be enhanced
     if(it == tmp_selected_planes.begin())
     {
-        cout << "Error: every plane has been removed from selected tuples list, not realigning" << endl;
+        LOG(WARNING) << "Error: every plane has been removed from selected tuples list, not realigning";
     }
     else if(it != tmp_selected_planes.end())
     {
@@ -809,6 +818,8 @@ vector<float> Registration::computeDistanceErrors()
 
 mat4 Registration::finalICP()
 {
+    PROFILE_SCOPE("icp");
+
     // Build PC for source and target
     pcl::PointCloud<pcl::PointXYZ>::Ptr p_source(new pcl::PointCloud<pcl::PointXYZ>);
     pcl::PointCloud<pcl::PointXYZ>::Ptr p_target(new pcl::PointCloud<pcl::PointXYZ>);
@@ -832,7 +843,7 @@ mat4 Registration::finalICP()
     pcl::PointCloud<pcl::PointXYZ> final;
     icp.align(final);
 
-    cout << "Has converged: " << icp.hasConverged() << " score: " << icp.getFitnessScore() << endl;
+    LOG(INFO) << "Has converged: " << icp.hasConverged() << " score: " << icp.getFitnessScore();
 
     return icp.getFinalTransformation();
 }
@@ -10,13 +10,10 @@ void SegmentedPointsContainer::SegmentedPlane::merge(SegmentedPlane &p)
     vector<int>::iterator it = unique(indices_list.begin(), indices_list.end());
     indices_list.resize(distance(indices_list.begin(), it));
 
-    // Ensure that both normals are orientated in the same direction
-    vec3 n1 = this->plane.getNormal();
-    vec3 n2 = p.plane.getNormal();
-    n2 = n2.normalized().dot(n1.normalized()) < 0.0f ? -n2 : n2;
-
-    // Set the new plane normal
-    this->plane.setNormal(n1 + n2);
+    // Normals of merged planes may be oriented apart, p is flipped toward this plane
+    vec3 n = p.plane.getNormal();
+    if(n.dot(this->plane.getNormal()) < 0) n = -n;
+    this->plane.setNormal(this->plane.getNormal() + n);
 }
 
 void SegmentedPointsContainer::addExcludedPoints(vector<int> point_list)
@@ -0,0 +1,391 @@
+#include "synthetic_city.h"
+
+constexpr float SyntheticCity::BLOCK_SIZE;
+
+void SyntheticCity::generate()
+{
+    size_t side = static_cast<size_t>(std::max(1.0f, std::round(parameters.size / BLOCK_SIZE)));
+    layout(side * side);
+}
+
+void SyntheticCity::generate(size_t nb_points)
+{
+    // The mean number of points of a block is estimated on a small city, whose blocks are the first ones of the larger city
+    const size_t nb_sample_blocks = 64;
+    layout(nb_sample_blocks);
+    double points_per_block = static_cast<double>(getNbPoints()) / nb_sample_blocks;
+
+    layout(std::max<size_t>(1, static_cast<size_t>(std::round(nb_points / points_per_block))));
+}
+
+void SyntheticCity::layout(size_t nb_blocks)
+{
+    mt19937 rng(parameters.seed);
+    uniform_real_distribution<float> unit(0, 1);
+    float trees_per_block = parameters.trees * BLOCK_SIZE * BLOCK_SIZE / 10000.0f;
+    poisson_distribution<int> nb_trees(trees_per_block > 0 ? trees_per_block : 1);
+
+    size_t side = static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(nb_blocks))));
+    parameters.size = side * BLOCK_SIZE;
+
+    blocks.clear();
+    blocks.reserve(nb_blocks);
+
+    for(size_t b = 0; b < nb_blocks; ++b)
+    {
+        Block block;
+        block.corner = vec2((b % side) * BLOCK_SIZE, (b / side) * BLOCK_SIZE);
+
+        // The footprint is rotated at random, it stays at least 1 m away from the streets whatever its orientation
+        block.length = 7 + 5 * unit(rng);
+        block.width = 6 + 3 * unit(rng);
+        float angle = static_cast<float>(M_PI) * unit(rng);
+        block.axis = vec2(std::cos(angle), std::sin(angle));
+
+        float radius = 0.5f * std::sqrt(block.length * block.length + block.width * block.width);
+        float margin = radius + 1;
+        block.center = block.corner + vec2(margin + unit(rng) * (BLOCK_SIZE - 2 * margin), margin + unit(rng) * (BLOCK_SIZE - 2 * margin));
+
+        block.height = parameters.min_height + (parameters.max_height - parameters.min_height) * unit(rng);
+        block.ridge_height = block.height;
+        if(unit(rng) < parameters.gabled_ratio)
+        {
+            // The ridge runs along the length, in the middle of the width
+            float slope = 0.3f + 0.7f * unit(rng);
+            block.ridge_height += slope * block.width / 2;
+        }
+
+        // Trees stand in the block, away from the building. Those which don't fit after a few tries are left out
+        int nb_block_trees = trees_per_block > 0 ? nb_trees(rng) : 0;
+        for(int t = 0; t < nb_block_trees; ++t)
+        {
+            float crown = 1.5f + 2 * unit(rng);
+            float crown_height = crown + 2 + 3 * unit(rng);
+
+            for(int attempt = 0; attempt < 20; ++attempt)
+            {
+                vec2 position = block.corner + vec2(crown + unit(rng) * (BLOCK_SIZE - 2 * crown), crown + unit(rng) * (BLOCK_SIZE - 2 * crown));
+                if((position - block.center).norm() < radius + crown + 1) continue;
+
+                block.trees.push_back(vec4(position.x(), position.y(), crown_height, crown));
+                break;
+            }
+        }
+
+        blocks.push_back(block);
+    }
+}
+
+void SyntheticCity::getBuildingSurfaces(const Block &block, vector<Surface> &surfaces) const
+{
+    const vec3 up(0, 0, 1);
+    vec3 along = vec3(block.axis.x(), block.axis.y(), 0) * block.length;
+    vec3 across = vec3(-block.axis.y(), block.axis.x(), 0) * block.width;
+    vec3 center(block.center.x(), block.center.y(), 0);
+
+    // Corners of the footprint, counterclockwise
+    vec3 corners[4] = {center - along / 2 - across / 2, center + along / 2 - across / 2,
+                       center + along / 2 + across / 2, center - along / 2 + across / 2};
+
+    float wall_density = parameters.density * parameters.wall_ratio;
+    float rise = block.ridge_height - block.height;
+
+    if(rise > 0)
+    {
+        // Both sides of the roof go from the eaves to the ridge
+        surfaces.push_back({corners[0] + up * block.height, along, across / 2 + up * rise, false, parameters.density});
+        surfaces.push_back({corners[3] + up * block.height, along, -across / 2 + up * rise, false, parameters.density});
+
+        // Gables above the short walls
+        surfaces.push_back({corners[0] + up * block.height, across, across / 2 + up * rise, true, wall_density});
+        surfaces.push_back({corners[1] + up * block.height, across, across / 2 + up * rise, true, wall_density});
+    }
+    else
+    {
+        surfaces.push_back({corners[0] + up * block.height, along, across, false, parameters.density});
+    }
+
+    for(int i = 0; i < 4; ++i)
+    {
+        surfaces.push_back({corners[i], corners[(i + 1) % 4] - corners[i], up * block.height, false, wall_density});
+    }
+}
+
+bool SyntheticCity::isInFootprint(const Block &block, float x, float y) const
+{
+    vec2 d = vec2(x, y) - block.center;
+    vec2 normal(-block.axis.y(), block.axis.x());
+
+    return std::abs(d.dot(block.axis)) <= block.length / 2 && std::abs(d.dot(normal)) <= block.width / 2;
+}
+
+size_t SyntheticCity::getNbPoints(const Surface &surface)
+{
+    float area = surface.u.cross(surface.v).norm() * (surface.is_triangle ? 0.5f : 1.0f);
+    return static_cast<size_t>(std::round(area * surface.density));
+}
+
+size_t SyntheticCity::getNbGroundPoints(const Block &block) const
+{
+    float area = BLOCK_SIZE * BLOCK_SIZE - block.length * block.width;
+    return static_cast<size_t>(std::round(area * parameters.density));
+}
+
+size_t SyntheticCity::getNbTreePoints(const vec4 &tree) const
+{
+    // Returns of a crown are as dense as those of the ground it hides
+    return static_cast<size_t>(std::round(static_cast<float>(M_PI) * tree.w() * tree.w() * parameters.density));
+}
+
+size_t SyntheticCity::getNbBlockPoints(const Block &block) const
+{
+    vector<Surface> surfaces;
+    getBuildingSurfaces(block, surfaces);
+
+    size_t nb_points = getNbGroundPoints(block);
+    for(const Surface &surface: surfaces)
+    {
+        nb_points += getNbPoints(surface);
+    }
+    for(const vec4 &tree: block.trees)
+    {
+        nb_points += getNbTreePoints(tree);
+    }
+
+    return nb_points;
+}
+
+size_t SyntheticCity::getNbPoints() const
+{
+    size_t nb_points = 0;
+    for(const Block &block: blocks)
+    {
+        nb_points += getNbBlockPoints(block);
+    }
+    return nb_points;
+}
+
+void SyntheticCity::sampleBlock(size_t block_id, unsigned sampling_seed, vector<vec3> &points) const
+{
+    const Block &block = blocks[block_id];
+
+    // Every block has its own generator, so that blocks can be sampled in any order
+    seed_seq seeds{sampling_seed, static_cast<unsigned>(block_id), static_cast<unsigned>(static_cast<uint64_t>(block_id) >> 32)};
+    mt19937 rng(seeds);
+    uniform_real_distribution<float> unit(0, 1);
+    normal_distribution<float> noise(0, parameters.noise > 0 ? parameters.noise : 1);
+
+    auto addPoint = [&](vec3 p)
+    {
+        if(parameters.noise > 0) p += vec3(noise(rng), noise(rng), noise(rng));
+        points.push_back(p);
+    };
+
+    vector<Surface> surfaces;
+    getBuildingSurfaces(block, surfaces);
+
+    for(const Surface &surface: surfaces)
+    {
+        size_t nb_points = getNbPoints(surface);
+        for(size_t i = 0; i < nb_points; ++i)
+        {
+            float s = unit(rng);
+            float t = unit(rng);
+
+            // Points drawn in the other half of the parallelogram are mirrored in the triangle
+            if(surface.is_triangle && s + t > 1)
+            {
+                s = 1 - s;
+                t = 1 - t;
+            }
+            addPoint(surface.origin + s * surface.u + t * surface.v);
+        }
+    }
+
+    size_t nb_ground_points = getNbGroundPoints(block);
+    for(size_t i = 0; i < nb_ground_points;)
+    {
+        float x = block.corner.x() + unit(rng) * BLOCK_SIZE;
+        float y = block.corner.y() + unit(rng) * BLOCK_SIZE;
+        if(isInFootprint(block, x, y)) continue;
+
+        addPoint(vec3(x, y, 0));
+        ++i;
+    }
+
+    for(const vec4 &tree: block.trees)
+    {
+        size_t nb_tree_points = getNbTreePoints(tree);
+        for(size_t i = 0; i < nb_tree_points;)
+        {
+            vec3 d(2 * unit(rng) - 1, 2 * unit(rng) - 1, 2 * unit(rng) - 1);
+            if(d.squaredNorm() > 1) continue;
+
+            addPoint(tree.head<3>() + d * tree.w());
+            ++i;
+        }
+    }
+}
+
+PointNormalKCloud::Ptr SyntheticCity::sampleCloud(unsigned sampling_seed) const
+{
+    // Blocks are sampled in parallel, each one at its offset in the cloud
+    vector<size_t> offsets(blocks.size() + 1, 0);
+    for(size_t b = 0; b < blocks.size(); ++b)
+    {
+        offsets[b + 1] = offsets[b] + getNbBlockPoints(blocks[b]);
+    }
+
+    PointNormalKCloud::Ptr p_cloud(new PointNormalKCloud);
+    p_cloud->points.resize(offsets.back());
+    p_cloud->width = static_cast<uint32_t>(p_cloud->points.size());
+    p_cloud->height = 1;
+
+    #pragma omp parallel for schedule(dynamic)
+    for(size_t b = 0; b < blocks.size(); ++b)
+    {
+        vector<vec3> points;
+        points.reserve(offsets[b + 1] - offsets[b]);
+        sampleBlock(b, sampling_seed, points);
+
+        for(size_t i = 0; i < points.size(); ++i)
+        {
+            PointNormalK &p = p_cloud->points[offsets[b] + i];
+            p.x = points[i].x();
+            p.y = points[i].y();
+            p.z = points[i].z();
+        }
+    }
+
+    return p_cloud;
+}
+
+bool SyntheticCity::saveCloud(string filename, unsigned sampling_seed) const
+{
+    ofstream out(filename, ios::out | ios::binary | ios::trunc);
+    if(!out.is_open())
+    {
+        LOG(ERROR) << "Could not write synthetic cloud in " << filename;
+        return false;
+    }
+
+    out << "ply" << endl;
+    out << "format binary_little_endian 1.0" << endl;
+    out << "comment SyntheticCity seed " << parameters.seed << " sampling seed " << sampling_seed << endl;
+    out << "element vertex " << getNbPoints() << endl;
+    out << "property float x" << endl;
+    out << "property float y" << endl;
+    out << "property float z" << endl;
+    out << "end_header" << endl;
+
+    vector<vec3> points;
+    vector<float> buffer;
+
+    for(size_t b = 0; b < blocks.size() && out.good(); ++b)
+    {
+        points.clear();
+        sampleBlock(b, sampling_seed, points);
+
+        buffer.resize(3 * points.size());
+        for(size_t i = 0; i < points.size(); ++i)
+        {
+            buffer[3 * i] = points[i].x();
+            buffer[3 * i + 1] = points[i].y();
+            buffer[3 * i + 2] = points[i].z();
+        }
+        out.write(reinterpret_cast<const char*>(buffer.data()), buffer.size() * sizeof(float));
+    }
+
+    if(!out.good())
+    {
+        LOG(ERROR) << "Could not write synthetic cloud in " << filename;
+        return false;
+    }
+
+    return true;
+}
+
+pcl::PolygonMesh::Ptr SyntheticCity::getMesh() const
+{
+    pcl::PointCloud<pcl::PointXYZRGB> vertices;
+    pcl::PolygonMesh::Ptr p_mesh(new pcl::PolygonMesh);
+
+    auto addVertex = [&](vec3 v)
+    {
+        pcl::PointXYZRGB p;
+        p.x = v.x();
+        p.y = v.y();
+        p.z = v.z();
+        p.r = p.g = p.b = 255;
+        vertices.push_back(p);
+        return static_cast<uint32_t>(vertices.size() - 1);
+    };
+
+    auto addTriangle = [&](uint32_t a, uint32_t b, uint32_t c)
+    {
+        pcl::Vertices triangle;
+        triangle.vertices = {a, b, c};
+        p_mesh->polygons.push_back(triangle);
+    };
+
+    // The ground is a grid of one square by block, sharing its vertices so that it is a single connected plane
+    size_t side = static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(blocks.size()))));
+    size_t nb_rows = (blocks.size() + side - 1) / side;
+    for(size_t j = 0; j <= nb_rows; ++j)
+    {
+        for(size_t i = 0; i <= side; ++i)
+        {
+            addVertex(vec3(i * BLOCK_SIZE, j * BLOCK_SIZE, 0));
+        }
+    }
+    for(size_t j = 0; j < nb_rows; ++j)
+    {
+        for(size_t i = 0; i < side; ++i)
+        {
+            uint32_t v = static_cast<uint32_t>(j * (side + 1) + i);
+            uint32_t above = v + static_cast<uint32_t>(side + 1);
+            addTriangle(v, v + 1, above + 1);
+            addTriangle(v, above + 1, above);
+        }
+    }
+
+    vector<Surface> surfaces;
+    for(const Block &block: blocks)
+    {
+        surfaces.clear();
+        getBuildingSurfaces(block, surfaces);
+
+        for(const Surface &surface: surfaces)
+        {
+            uint32_t a = addVertex(surface.origin);
+            uint32_t b = addVertex(surface.origin + surface.u);
+            uint32_t c = addVertex(surface.origin + surface.v);
+
+            if(surface.is_triangle)
+            {
+                addTriangle(a, b, c);
+            }
+            else
+            {
+                uint32_t d = addVertex(surface.origin + surface.u + surface.v);
+                addTriangle(a, b, d);
+                addTriangle(a, d, c);
+            }
+        }
+    }
+
+    pcl::toPCLPointCloud2(vertices, p_mesh->cloud);
+
+    return p_mesh;
+}
+
+bool SyntheticCity::saveMesh(string filename) const
+{
+    if(!pcl::io::savePolygonFilePLY(filename, *getMesh()))
+    {
+        LOG(ERROR) << "Could not write synthetic mesh in " << filename;
+        return false;
+    }
+
+    return true;
+}
@@ -1,5 +1,40 @@
 #include "test_set.h"
 
+// =========================== // AlignmentResults // ============================================== //
+
+double AlignmentResults::getRotationError() const
+{
+    mat3 initR = initialTransform.block(0, 0, 3, 3).matrix();
+    mat3 optR = transform.block(0, 0, 3, 3).matrix();
+    mat3 errR = optR * initR;// - mat3::Identity();
+
+    // 3 euler angles
+    double thetaX = atan2(errR(2, 1), errR(2, 2));
+    double thetaY = atan2(-errR(2,0),sqrt(errR(2, 1)*errR(2, 1) + errR(2, 2)*errR(2, 2)));
+    double thetaZ = atan2(errR(1, 0), errR(0, 0));
+    double m =  max(abs(thetaX), abs(thetaY));
+
+    return max(m, abs(thetaZ));
+}
+
+double AlignmentResults::getTranslationError() const
+{
+    vec3 err3 = target_center - source_center;
+    return err3.norm();
+}
+
+float AlignmentResults::getMeanPairDistance() const
+{
+    // Sum of distances between each points
+    float mean_dist = 0;
+    for(float j: pair_distances)
+    {
+        mean_dist += j;
+    }
+
+    return mean_dist / pair_distances.size();
+}
+
 // =========================== // AlignObjectInterface // ============================================== //
 
 AlignObjectInterface::~AlignObjectInterface() {}
@@ -34,6 +69,16 @@ bool AlignObjectInterface::isSource()
 
 void CloudObject::loadObject()
 {
+    if(PreprocessedCloudFile::isPreprocessedCloudFile(this->getFilename()))
+    {
+        PreprocessedCloudFile file;
+        if(!file.open(this->getFilename())) exit(EXIT_FAILURE);
+
+        p_object = file.getCloud();
+        p_graph = file.getNeighborGraph();
+        return;
+    }
+
     p_object = PointNormalKCloud::Ptr(new PointNormalKCloud);
     int r = pcl::io::loadPCDFile(this->getFilename(), *p_object);
 
@@ -42,6 +87,9 @@ void CloudObject::loadObject()
         PCL_ERROR("Could not read given file\n");
         exit(EXIT_FAILURE);
     }
+
+    p_graph = NeighborGraph::Ptr(new NeighborGraph);
+    if(!p_graph->load(NeighborGraph::getSidecarPath(this->getFilename()))) p_graph.reset();
 }
 
 void CloudObject::displayObjectIn(pcl::visualization::PCLVisualizer::Ptr p_viewer, ivec3 color, int viewport, string id_prefix)
@@ -58,6 +106,7 @@ void CloudObject::displayObjectIn(pcl::visualization::PCLVisualizer::Ptr p_viewe
 void CloudObject::preprocess()
 {
     PlaneSegmentation seg;
+    seg.setConfig(this->config);
 
     if(this->p_object == nullptr)
     {
@@ -71,43 +120,81 @@ void CloudObject::preprocess()
     seg.preprocessCloud();
 
     this->p_object = seg.getPointCloud();
+    this->p_graph = seg.getNeighborGraph();
+}
+
+/// Seconds elapsed since start
+static double secondsSince(const struct timespec &start)
+{
+    struct timespec finish;
+    clock_gettime(CLOCK_MONOTONIC, &finish);
+
+    return (finish.tv_sec - start.tv_sec) + (finish.tv_nsec - start.tv_nsec) / 1000000000.0;
 }
 
 void CloudObject::segment(vector<SegmentedPointsContainer::SegmentedPlane> &out_planes)
 {
-    vector<SegmentedPointsContainer::SegmentedPlane> segmented_planes;
+    SegmentationResult result;
+    this->segmentPlanes(this->config, result);
+    this->mergePlanes(this->config, result);
+    out_planes = result.planes;
+
+    // We also keep the pointer to the cloud for later use
+    this->p_object = result.p_cloud;
+}
+
+void CloudObject::segmentPlanes(const AlignmentConfig &config, SegmentationResult &result)
+{
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
 
     PlaneSegmentation segmentation;
+    segmentation.setConfig(config);
 
-    if(this->p_object == nullptr)
+    if(result.p_cloud != nullptr)
+    {
+        segmentation.init(result.p_cloud, this->isSource());
+        segmentation.setNeighborGraph(this->p_graph);
+    }
+    else if(this->p_object == nullptr)
     {
         segmentation.init(this->getFilename(), this->isSource());
     }
     else
     {
         segmentation.init(this->p_object, this->isSource());
+        segmentation.setNeighborGraph(this->p_graph);
     }
 
     if(segmentation.isReady())
     {
-        segmentation.filterOutCurvature(MAX_CURVATURE);
+        segmentation.filterOutCurvature(config.max_curvature);
         segmentation.start_pause();
         segmentation.runMainLoop();
-        segmented_planes = segmentation.getSegmentedPlanes();
+        result.planes = segmentation.getSegmentedPlanes();
     }
     else
     {
-        cout << "Error: " << this->getFilename() << " is not preprocessed. Exiting..." << endl;
+        LOG(ERROR) << "Error: " << this->getFilename() << " is not preprocessed. Exiting...";
         exit(EXIT_FAILURE);
     }
 
+    result.p_cloud = segmentation.getPointCloud();
+    result.segmentation_time = secondsSince(start);
+}
+
+void CloudObject::mergePlanes(const AlignmentConfig &config, SegmentationResult &result)
+{
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
     PlaneMerging merger;
+    merger.setConfig(config);
     merger.init(nullptr, false);
-    merger.start_merge(segmented_planes, segmentation.getPointCloud());
-    out_planes = merger.getSegmentedPlanes();
+    merger.start_merge(result.planes, result.p_cloud);
+    result.planes = merger.getSegmentedPlanes();
 
-    // We also keep the pointer to the cloud for later use
-    this->p_object = segmentation.getPointCloud();
+    result.merging_time = secondsSince(start);
 }
 
 void CloudObject::transform(mat4 &M)
@@ -128,12 +215,13 @@ void CloudObject::saveObject(string suffix, int set_id)
     string name = p.stem().string();
 
     stringstream ss;
-    ss << set_id << "_" << name << suffix << ".ply";
+    ss << set_id << "_" << name << suffix << PreprocessedCloudFile::EXTENSION;
     auto new_p = p.remove_filename();
     new_p.append(ss.str());
     this->setFilename(new_p.string());
 
-    pcl::io::savePLYFile(this->getFilename(), *this->p_object, true);
+    // Binary file with the neighbor graph, mapped in memory when the test set is run
+    PreprocessedCloudFile::save(this->getFilename(), *this->p_object, p_graph);
 }
 
 PointNormalKCloud::Ptr CloudObject::getObject()
@@ -144,6 +232,7 @@ PointNormalKCloud::Ptr CloudObject::getObject()
 void CloudObject::setObject(PointNormalKCloud::Ptr object_ptr)
 {
     this->p_object = object_ptr;
+    this->p_graph.reset();
 }
 
 bool CloudObject::isCloud()
@@ -158,7 +247,7 @@ void MeshObject::loadObject()
     this->p_object = pcl::PolygonMeshPtr(new pcl::PolygonMesh);
     if(pcl::io::loadPolygonFilePLY(this->getFilename(), *p_object) == -1)
     {
-        cout << "Failed to load given mesh file" << endl;
+        LOG(ERROR) << "Failed to load given mesh file";
         exit(EXIT_FAILURE);
     }
 }
@@ -195,6 +284,7 @@ void MeshObject::preprocess()
 void MeshObject::segment(vector<SegmentedPointsContainer::SegmentedPlane> &out_planes)
 {
     MeshSegmentation seg;
+    seg.setConfig(this->config);
     seg.loadMesh(this->p_object);
     seg.segmentPlanes();
     seg.mergePlanes();
@@ -202,6 +292,28 @@ void MeshObject::segment(vector<SegmentedPointsContainer::SegmentedPlane> &out_p
     this->p_object = seg.getMeshPtr();
 }
 
+void MeshObject::segmentPlanes(const AlignmentConfig &config, SegmentationResult &result)
+{
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    // The segmentation colors the vertices of the mesh it is given
+    MeshSegmentation seg;
+    seg.setConfig(config);
+    seg.loadMesh(pcl::PolygonMesh::Ptr(new pcl::PolygonMesh(*this->p_object)));
+    seg.segmentPlanes();
+    seg.mergePlanes();
+    result.planes = seg.getSegmentedPlanes();
+    result.p_cloud = nullptr;
+
+    result.segmentation_time = secondsSince(start);
+}
+
+void MeshObject::mergePlanes(const AlignmentConfig &, SegmentationResult &)
+{
+    // Planes of meshes are merged along with their segmentation
+}
+
 void MeshObject::transform(mat4 &M)
 {
     if(this->p_object == nullptr) this->loadObject();
@@ -267,6 +379,19 @@ void TestingSet::addSource(string sourcefile, bool isCloud, mat4 m)
     {
         sources.emplace_back(new MeshObject(sourcefile, true, m));
     }
+
+    sources.back()->setConfig(this->config);
+}
+
+void TestingSet::setConfig(const AlignmentConfig &config)
+{
+    this->config = config;
+    if(this->p_target) this->p_target->setConfig(config);
+
+    for(auto &source: this->sources)
+    {
+        source->setConfig(config);
+    }
 }
 
 bool TestingSet::isInitialized()
@@ -333,7 +458,7 @@ void TestingSet::runTests()
         this->results[i].initialTransform = this->sources[i]->getOriginalTransform();
     }
 
-    cout << "Plane segmentation finished, starting alignment..." << endl;
+    LOG(INFO) << "Plane segmentation finished, starting alignment...";
 
     // Then they are registered
     this->sources_aligned.resize(this->sources.size());
@@ -353,40 +478,22 @@ void TestingSet::runTests()
 
 void TestingSet::runAlignment(size_t source_id)
 {
-    auto source_planes = this->results[source_id].source_planes;
-
-    // Registration step
-    Registration registration;
-
     // Need to get the point cloud pointer in case of cloud object
-    PointNormalKCloud::Ptr t_cloud = nullptr;
-    PointNormalKCloud::Ptr s_cloud = nullptr;
+    SegmentationResult source, target;
+    source.planes = this->results[source_id].source_planes;
+    target.planes = this->target_planes;
 
     if(this->p_target->isCloud())
     {
-        t_cloud = (dynamic_cast<CloudObject*>(p_target.get()))->getObject();
+        target.p_cloud = (dynamic_cast<CloudObject*>(p_target.get()))->getObject();
     }
 
     if(this->sources[source_id]->isCloud())
     {
-        s_cloud = (dynamic_cast<CloudObject*>(this->sources[source_id].get()))->getObject();
+        source.p_cloud = (dynamic_cast<CloudObject*>(this->sources[source_id].get()))->getObject();
     }
 
-    registration.setClouds(source_planes, this->target_planes, !this->p_target->isCloud(), !this->sources[source_id]->isCloud(), s_cloud, t_cloud);
-    mat4 M = registration.findAlignment();
-
-    registration.applyTransform(M);
-
-    mat4 realign_M = registration.refineAlignment();
-
-    registration.applyTransform(realign_M);
-
-    mat4 ICP_M = registration.finalICP();
-
-    registration.applyTransform(ICP_M);
-
-    // Saving the final transformation because we need it to compute alignment errors when writing results
-    this->results[source_id].transform = ICP_M * realign_M * M;
+    this->alignPlanes(this->config, source_id, source, target, this->results[source_id]);
 
     // Save aligned object in the sources_aligned vector
     // First deep copy of current source
@@ -406,11 +513,34 @@ void TestingSet::runAlignment(size_t source_id)
 
     // store the transformed object
     this->sources_aligned[source_id] = source_aligned;
+}
+
+void TestingSet::alignPlanes(const AlignmentConfig &config, size_t source_id, SegmentationResult &source, SegmentationResult &target, AlignmentResults &result)
+{
+    // Registration step
+    Registration registration;
+    registration.setConfig(config);
+
+    registration.setClouds(source.planes, target.planes, !this->p_target->isCloud(), !this->sources[source_id]->isCloud(), source.p_cloud, target.p_cloud);
+    mat4 M = registration.findAlignment();
+
+    registration.applyTransform(M);
+
+    mat4 realign_M = registration.refineAlignment();
+
+    registration.applyTransform(realign_M);
+
+    mat4 ICP_M = registration.finalICP();
+
+    registration.applyTransform(ICP_M);
 
-    // save alignment statistics in results[i]
+    // Saving the final transformation because we need it to compute alignment errors when writing results
+    result.transform = ICP_M * realign_M * M;
+
+    // save alignment statistics in result
     auto pair_list = registration.getSelectedPlanes();
     auto distances = registration.computeDistanceErrors();
-    this->results[source_id].pair_distances = distances;
+    result.pair_distances = distances;
 
     vec3 source_centroid(0, 0, 0);
     vec3 target_centroid(0, 0, 0);
@@ -428,8 +558,119 @@ void TestingSet::runAlignment(size_t source_id)
     source_centroid /= pair_list.size();
     target_centroid /= pair_list.size();
 
-    this->results[source_id].source_center = source_centroid;
-    this->results[source_id].target_center = target_centroid;
+    result.source_center = source_centroid;
+    result.target_center = target_centroid;
+}
+
+void TestingSet::runSweep(const vector<AlignmentConfig> &configs, size_t set_id, vector<SweepRun, Eigen::aligned_allocator<SweepRun>> &runs)
+{
+    // Load the objects before going in parallel sections. Workaround for crash when loading polygonfile in parallel
+    this->loadSet();
+
+    // Objects of the set, the target being the last one
+    vector<shared_ptr<AlignObjectInterface>> objects = this->sources;
+    objects.push_back(this->p_target);
+
+    // A segmentation task is an object and the parameters of its segmentation, a merging task also has the ones of the
+    // merging. Each configuration points to the tasks it needs, configurations that only differ by later stages share them.
+    vector<pair<size_t, size_t>> segmentation_tasks, merging_tasks;
+    vector<vector<size_t>> config_merging(configs.size(), vector<size_t>(objects.size()));
+    map<pair<size_t, string>, size_t> segmentation_ids, merging_ids;
+
+    for(size_t c = 0; c < configs.size(); ++c)
+    {
+        for(size_t o = 0; o < objects.size(); ++o)
+        {
+            int segmentation_stages = objects[o]->isCloud() ? AlignmentConfig::CLOUD_SEGMENTATION : AlignmentConfig::MESH_SEGMENTATION;
+            int merging_stages = objects[o]->isCloud() ? segmentation_stages | AlignmentConfig::CLOUD_MERGING : segmentation_stages;
+
+            auto segmentation_key = make_pair(o, configs[c].getKey(segmentation_stages));
+            if(segmentation_ids.find(segmentation_key) == segmentation_ids.end())
+            {
+                segmentation_ids[segmentation_key] = segmentation_tasks.size();
+                segmentation_tasks.push_back(make_pair(o, c));
+            }
+
+            auto merging_key = make_pair(o, configs[c].getKey(merging_stages));
+            if(merging_ids.find(merging_key) == merging_ids.end())
+            {
+                merging_ids[merging_key] = merging_tasks.size();
+                merging_tasks.push_back(make_pair(segmentation_ids[segmentation_key], c));
+            }
+
+            config_merging[c][o] = merging_ids[merging_key];
+        }
+    }
+
+    LOG(INFO) << configs.size() << " configurations: " << segmentation_tasks.size() << " segmentations, " << merging_tasks.size()
+         << " mergings and " << configs.size() * this->sources.size() << " registrations to run.";
+
+    // The segmentation marks the points of the cloud, each task works on its own copy
+    vector<SegmentationResult> segmentations(segmentation_tasks.size());
+
+    #pragma omp parallel for schedule(dynamic)
+    for(size_t i = 0; i < segmentation_tasks.size(); ++i)
+    {
+        auto &object = objects[segmentation_tasks[i].first];
+        if(object->isCloud())
+        {
+            segmentations[i].p_cloud = PointNormalKCloud::Ptr(new PointNormalKCloud);
+            pcl::copyPointCloud(*dynamic_cast<CloudObject*>(object.get())->getObject(), *segmentations[i].p_cloud);
+        }
+
+        object->segmentPlanes(configs[segmentation_tasks[i].second], segmentations[i]);
+    }
+
+    LOG(INFO) << "Plane segmentation finished, starting merging...";
+
+    vector<SegmentationResult> mergings(merging_tasks.size());
+
+    #pragma omp parallel for schedule(dynamic)
+    for(size_t i = 0; i < merging_tasks.size(); ++i)
+    {
+        size_t segmentation_id = merging_tasks[i].first;
+        mergings[i] = segmentations[segmentation_id];
+        objects[segmentation_tasks[segmentation_id].first]->mergePlanes(configs[merging_tasks[i].second], mergings[i]);
+    }
+
+    LOG(INFO) << "Plane merging finished, starting alignment...";
+
+    size_t first_run = runs.size();
+    runs.resize(first_run + configs.size() * this->sources.size());
+    const size_t target_id = this->sources.size();
+
+    #pragma omp parallel for schedule(dynamic)
+    for(size_t i = 0; i < configs.size() * this->sources.size(); ++i)
+    {
+        SweepRun &run = runs[first_run + i];
+        run.set_id = set_id;
+        run.config_id = i / this->sources.size();
+        run.source_id = i % this->sources.size();
+
+        SegmentationResult &source = mergings[config_merging[run.config_id][run.source_id]];
+        SegmentationResult &target = mergings[config_merging[run.config_id][target_id]];
+
+        run.source_segmentation_time = source.segmentation_time;
+        run.target_segmentation_time = target.segmentation_time;
+        run.source_merging_time = source.merging_time;
+        run.target_merging_time = target.merging_time;
+
+        AlignmentResults &r = run.results;
+        r.source_planes = source.planes;
+        r.nb_points_source = this->sources[run.source_id]->getNbPoints();
+        r.nb_points_target = this->p_target->getNbPoints();
+        r.nb_planes_source = source.planes.size();
+        r.nb_planes_target = target.planes.size();
+        r.initialTransform = this->sources[run.source_id]->getOriginalTransform();
+
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        this->alignPlanes(configs[run.config_id], run.source_id, source, target, r);
+        run.registration_time = secondsSince(start);
+
+        r.elapsed_time = run.source_segmentation_time + run.target_segmentation_time + run.source_merging_time
+                + run.target_merging_time + run.registration_time;
+    }
 }
 
 void TestingSet::display(pcl::visualization::PCLVisualizer::Ptr p_viewer, vector<int> &viewports)
@@ -509,7 +750,7 @@ void TestingSet::writeResults(int test_id)
     ss << "results_" << (this->p_target->isCloud()? "tCloud_" : "tMesh_") << (this->sources[0]->isCloud()? "sCloud_" : "sMesh_") << test_id << ".txt";
     string statsFile = ss.str();
 
-    cout << "Printing results in " << statsFile << endl;
+    LOG(INFO) << "Printing results in " << statsFile;
 
     ofstream file(statsFile);
 
@@ -522,31 +763,9 @@ void TestingSet::writeResults(int test_id)
         file << "Target nb points and nb planes: " << r.nb_points_target << ", " << r.nb_planes_target << endl;
         file << "Source nb points nb planes and time_elapsed: " << r.nb_points_source << ", " << r.nb_planes_source << ", " << r.elapsed_time << endl;
 
-        // Rotation error
-        mat3 initR = r.initialTransform.block(0, 0, 3, 3).matrix();
-        mat3 optR = r.transform.block(0, 0, 3, 3).matrix();
-        mat3 errR = optR * initR;// - mat3::Identity();
-
-        // 3 euler angles
-        double thetaX = atan2(errR(2, 1), errR(2, 2));
-        double thetaY = atan2(-errR(2,0),sqrt(errR(2, 1)*errR(2, 1) + errR(2, 2)*errR(2, 2)));
-        double thetaZ = atan2(errR(1, 0), errR(0, 0));
-        double m =  max(abs(thetaX), abs(thetaY));
-        file << "Rotation error: " << max(m, abs(thetaZ)) << endl;
-
-        // Translation error
-        vec3 err3 = r.target_center - r.source_center;
-        file << "Translation error: " << err3.norm() << endl;
-
-        // Sum of distances between each points
-        float mean_dist = 0;
-        for(float j: r.pair_distances)
-        {
-            mean_dist += j;
-        }
-        mean_dist /= r.pair_distances.size();
-
-        file << "Mean distance between pairs: " << mean_dist << endl;
+        file << "Rotation error: " << r.getRotationError() << endl;
+        file << "Translation error: " << r.getTranslationError() << endl;
+        file << "Mean distance between pairs: " << r.getMeanPairDistance() << endl;
 
         // Write every pair distances
         file << "Pair distance list: " << endl;
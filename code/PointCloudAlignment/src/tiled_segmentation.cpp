@@ -0,0 +1,469 @@
+#include "tiled_segmentation.h"
+
+#include <numeric>
+
+int TiledSegmentation::segment(string input_file, string output_file)
+{
+    CloudStreamReader reader;
+    if(!reader.open(input_file)) return EXIT_FAILURE;
+
+    LOG(INFO) << "Streaming " << reader.getNbPoints() << " points from " << input_file;
+
+    if(!computeTiles(reader)) return EXIT_FAILURE;
+
+    work_dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("pca_tiles_%%%%-%%%%-%%%%");
+    boost::filesystem::create_directories(work_dir);
+
+    if(!dispatchPoints(reader))
+    {
+        boost::filesystem::remove_all(work_dir);
+        return EXIT_FAILURE;
+    }
+    reader.close();
+
+    nb_planes = 0;
+    nb_output_points = 0;
+    border_bands.clear();
+    plane_ids.assign(1, 0);
+
+    // Core points of every tile, with the plane ids given before stitching
+    ofstream points_file((work_dir / "points.bin").string(), ios::out | ios::binary);
+
+    for(int tile = 0; tile < nb_tiles_x * nb_tiles_y; ++tile)
+    {
+        segmentTile(tile, points_file);
+        stitchTile(tile);
+        releaseBands(tile);
+    }
+    points_file.close();
+
+    vector<int> stitched_ids = getStitchedIds();
+
+    bool written = writeOutput(output_file, stitched_ids);
+    boost::filesystem::remove_all(work_dir);
+
+    return written ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+bool TiledSegmentation::computeTiles(CloudStreamReader &reader)
+{
+    vec2 max_xy(-numeric_limits<float>::max(), -numeric_limits<float>::max());
+    min_xy = vec2(numeric_limits<float>::max(), numeric_limits<float>::max());
+
+    vector<vec3> points;
+    while(reader.read(points, STREAM_CHUNK_SIZE) > 0)
+    {
+        for(vec3 &p: points)
+        {
+            min_xy = min_xy.cwiseMin(vec2(p.x(), p.y()));
+            max_xy = max_xy.cwiseMax(vec2(p.x(), p.y()));
+        }
+    }
+
+    if(reader.getNbPoints() == 0)
+    {
+        LOG(ERROR) << "The cloud is empty.";
+        return false;
+    }
+
+    nb_tiles_x = std::max(1, static_cast<int>(std::ceil((max_xy.x() - min_xy.x()) / tile_size)));
+    nb_tiles_y = std::max(1, static_cast<int>(std::ceil((max_xy.y() - min_xy.y()) / tile_size)));
+
+    LOG(INFO) << "Cloud split in " << nb_tiles_x << " x " << nb_tiles_y << " tiles of " << tile_size << " with a halo of " << halo;
+
+    return reader.rewind();
+}
+
+bool TiledSegmentation::dispatchPoints(CloudStreamReader &reader)
+{
+    int nb_tiles = nb_tiles_x * nb_tiles_y;
+    vector<vector<float>> buffers(nb_tiles);
+    size_t nb_buffered = 0;
+
+    // Buffers are appended to the tile files once they hold STREAM_CHUNK_SIZE points altogether
+    auto flush = [&buffers, &nb_buffered, this]()
+    {
+        for(size_t tile = 0; tile < buffers.size(); ++tile)
+        {
+            if(buffers[tile].empty()) continue;
+
+            ofstream file(getTilePath(tile).string(), ios::out | ios::binary | ios::app);
+            file.write(reinterpret_cast<const char*>(buffers[tile].data()), buffers[tile].size() * sizeof(float));
+            if(!file) return false;
+
+            vector<float>().swap(buffers[tile]);
+        }
+
+        nb_buffered = 0;
+        return true;
+    };
+
+    vector<vec3> points;
+    while(reader.read(points, STREAM_CHUNK_SIZE) > 0)
+    {
+        for(vec3 &p: points)
+        {
+            // Every tile whose extended box contains the point
+            int x_begin = std::max(0, static_cast<int>(std::floor((p.x() - halo - min_xy.x()) / tile_size)));
+            int x_end = std::min(nb_tiles_x - 1, static_cast<int>(std::floor((p.x() + halo - min_xy.x()) / tile_size)));
+            int y_begin = std::max(0, static_cast<int>(std::floor((p.y() - halo - min_xy.y()) / tile_size)));
+            int y_end = std::min(nb_tiles_y - 1, static_cast<int>(std::floor((p.y() + halo - min_xy.y()) / tile_size)));
+
+            for(int ty = y_begin; ty <= y_end; ++ty)
+            {
+                for(int tx = x_begin; tx <= x_end; ++tx)
+                {
+                    vector<float> &buffer = buffers[ty * nb_tiles_x + tx];
+                    buffer.push_back(p.x());
+                    buffer.push_back(p.y());
+                    buffer.push_back(p.z());
+                    ++nb_buffered;
+                }
+            }
+        }
+
+        if(nb_buffered >= STREAM_CHUNK_SIZE && !flush())
+        {
+            LOG(ERROR) << "Could not write tiles in " << work_dir;
+            return false;
+        }
+    }
+
+    if(!flush())
+    {
+        LOG(ERROR) << "Could not write tiles in " << work_dir;
+        return false;
+    }
+
+    return true;
+}
+
+void TiledSegmentation::segmentTile(int tile, ofstream &out)
+{
+    // Everything recorded while segmenting the tile is also totaled for the tile alone
+    PROFILE_CONTEXT(tile);
+    PROFILE_SCOPE("tile");
+
+    boost::filesystem::path tile_path = getTilePath(tile);
+    if(!boost::filesystem::exists(tile_path)) return;
+
+    // Load the tile with its halo
+    size_t nb_points = boost::filesystem::file_size(tile_path) / (3 * sizeof(float));
+    vector<float> coordinates(3 * nb_points);
+    ifstream file(tile_path.string(), ios::in | ios::binary);
+    file.read(reinterpret_cast<char*>(coordinates.data()), coordinates.size() * sizeof(float));
+    file.close();
+    boost::filesystem::remove(tile_path);
+
+    PointNormalKCloud::Ptr p_tile_cloud(new PointNormalKCloud);
+    p_tile_cloud->points.resize(nb_points);
+    for(size_t i = 0; i < nb_points; ++i)
+    {
+        p_tile_cloud->points[i].x = coordinates[3 * i];
+        p_tile_cloud->points[i].y = coordinates[3 * i + 1];
+        p_tile_cloud->points[i].z = coordinates[3 * i + 2];
+    }
+    p_tile_cloud->width = nb_points;
+    p_tile_cloud->height = 1;
+    vector<float>().swap(coordinates);
+
+    LOG(INFO) << "Segmenting tile " << tile + 1 << "/" << nb_tiles_x * nb_tiles_y << " containing " << nb_points << " points.";
+
+    PlaneSegmentation seg;
+    vector<SegmentedPointsContainer::SegmentedPlane> planes;
+
+    // Too small tiles have no meaningful neighborhoods, their points are excluded
+    if(nb_points > static_cast<size_t>(config.max_k_original))
+    {
+        seg.init(p_tile_cloud, true);
+        seg.setConfig(config);
+        if(resample) seg.resampleCloud();
+        seg.preprocessCloud();
+        seg.filterOutCurvature(config.max_curvature);
+        seg.setNbParallelSeeds(nb_parallel_seeds);
+        seg.start_pause();
+        seg.runMainLoop();
+
+        p_tile_cloud = seg.getPointCloud();
+        planes = seg.getSegmentedPlanes();
+    }
+
+    // Give a global id to the planes having points in the tile core
+    int max_local_id = 0;
+    for(SegmentedPointsContainer::SegmentedPlane &plane: planes)
+    {
+        max_local_id = std::max(max_local_id, plane.id);
+    }
+    vector<int> global_ids(max_local_id + 1, 0);
+
+    for(SegmentedPointsContainer::SegmentedPlane &plane: planes)
+    {
+        vector<int> core_indices;
+        copy_if(plane.indices_list.begin(), plane.indices_list.end(), back_inserter(core_indices), [&p_tile_cloud, tile, this](int index){
+            return this->isInCore(tile, p_tile_cloud->points[index].x, p_tile_cloud->points[index].y);
+        });
+
+        if(core_indices.empty()) continue;
+
+        global_ids[plane.id] = static_cast<int>(++nb_planes);
+        plane_ids.push_back(global_ids[plane.id]);
+
+        // Keep the band points of the planes reaching the tile border for stitching
+        bool is_border_plane = false;
+        for(int index: core_indices)
+        {
+            const PointNormalK &p = p_tile_cloud->points[index];
+            if(isInBorderBand(tile, p.x, p.y))
+            {
+                BorderPoint b = {p.x, p.y, p.z, global_ids[plane.id]};
+                border_bands[tile].points.push_back(b);
+                is_border_plane = true;
+            }
+        }
+
+        if(is_border_plane)
+        {
+            border_bands[tile].normals[global_ids[plane.id]] = plane.plane.getNormal().normalized();
+        }
+    }
+
+    // Write the core points, in the order of the tile even if the segmentation sorted them
+    if(seg.isReordered()) p_tile_cloud = seg.getPointCloudInOriginalOrder();
+
+    vector<OutputPoint> core_points;
+    for(PointNormalK &p: p_tile_cloud->points)
+    {
+        if(!isInCore(tile, p.x, p.y)) continue;
+
+        OutputPoint o;
+        o.x = p.x; o.y = p.y; o.z = p.z;
+        o.normal_x = p.normal_x; o.normal_y = p.normal_y; o.normal_z = p.normal_z;
+        o.rgba = p.rgba;
+        o.curvature = p.curvature;
+        o.k = p.k;
+        o.plane_id = p.plane_id > 0 && p.plane_id <= max_local_id ? global_ids[p.plane_id] : 0;
+        core_points.push_back(o);
+    }
+
+    out.write(reinterpret_cast<const char*>(core_points.data()), core_points.size() * sizeof(OutputPoint));
+    nb_output_points += core_points.size();
+}
+
+void TiledSegmentation::stitchTile(int tile)
+{
+    auto it = border_bands.find(tile);
+    if(it == border_bands.end()) return;
+
+    PROFILE_SCOPE("stitching");
+
+    BorderBand &band = it->second;
+
+    PointNormalKCloud::Ptr p_band_cloud(new PointNormalKCloud);
+    p_band_cloud->points.resize(band.points.size());
+    for(size_t i = 0; i < band.points.size(); ++i)
+    {
+        p_band_cloud->points[i].x = band.points[i].x;
+        p_band_cloud->points[i].y = band.points[i].y;
+        p_band_cloud->points[i].z = band.points[i].z;
+    }
+    p_band_cloud->width = band.points.size();
+    p_band_cloud->height = 1;
+
+    KdTreeFlannK::Ptr p_kdtree(new KdTreeFlannK);
+    p_kdtree->setInputCloud(p_band_cloud);
+
+    vector<int> indices;
+    vector<float> sqrd_distances;
+    const float cos_normal_error = std::cos(config.normal_error);
+    const float sin_normal_error = std::sin(config.normal_error);
+
+    // Tiles are segmented in order, the ones around with a lower index are done
+    int tx = tile % nb_tiles_x;
+    int ty = tile / nb_tiles_x;
+    for(int ny = std::max(0, ty - 1); ny <= std::min(nb_tiles_y - 1, ty + 1); ++ny)
+    {
+        for(int nx = std::max(0, tx - 1); nx <= std::min(nb_tiles_x - 1, tx + 1); ++nx)
+        {
+            int neighbor = ny * nb_tiles_x + nx;
+            auto neighbor_it = border_bands.find(neighbor);
+            if(neighbor >= tile || neighbor_it == border_bands.end()) continue;
+
+            BorderBand &neighbor_band = neighbor_it->second;
+            PointNormalK query;
+
+            for(const BorderPoint &q: neighbor_band.points)
+            {
+                query.x = q.x;
+                query.y = q.y;
+                query.z = q.z;
+                p_kdtree->radiusSearch(query, stitch_band, indices, sqrd_distances);
+
+                vec3 n_q = neighbor_band.normals[q.plane_id];
+
+                for(int j: indices)
+                {
+                    const BorderPoint &p = band.points[j];
+
+                    int root_p = findRoot(p.plane_id);
+                    int root_q = findRoot(q.plane_id);
+                    if(root_p == root_q) continue;
+
+                    // The planes are cut along the border, their overlap is only tested on the points on both sides of it:
+                    // each point must lie on the plane of the other, up to the merging tolerances. Tiles are preprocessed
+                    // independently, the planes on both sides of a border may be oriented differently.
+                    vec3 n_p = band.normals[p.plane_id];
+                    vec3 pq(q.x - p.x, q.y - p.y, q.z - p.z);
+                    float tolerance = config.distance_error + pq.norm() * sin_normal_error;
+
+                    if(std::abs(n_p.dot(n_q)) >= cos_normal_error &&
+                            (std::abs(n_p.dot(pq)) <= tolerance || std::abs(n_q.dot(pq)) <= tolerance))
+                    {
+                        plane_ids[std::max(root_p, root_q)] = std::min(root_p, root_q);
+                    }
+                }
+            }
+        }
+    }
+}
+
+void TiledSegmentation::releaseBands(int tile)
+{
+    for(auto it = border_bands.begin(); it != border_bands.end();)
+    {
+        // The last tile around it to be segmented is the next one on the next row
+        int tx = it->first % nb_tiles_x;
+        int ty = it->first / nb_tiles_x;
+        int last_neighbor = std::min(nb_tiles_y - 1, ty + 1) * nb_tiles_x + std::min(nb_tiles_x - 1, tx + 1);
+
+        if(last_neighbor <= tile)
+        {
+            it = border_bands.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+int TiledSegmentation::findRoot(int id)
+{
+    while(plane_ids[id] != id)
+    {
+        plane_ids[id] = plane_ids[plane_ids[id]];
+        id = plane_ids[id];
+    }
+    return id;
+}
+
+vector<int> TiledSegmentation::getStitchedIds()
+{
+    border_bands.clear();
+
+    vector<int> stitched_ids(plane_ids.size());
+    for(size_t id = 1; id < plane_ids.size(); ++id)
+    {
+        stitched_ids[id] = findRoot(id);
+    }
+
+    // Make the ids contiguous again
+    vector<int> compact_ids(nb_planes + 1, 0);
+    int nb_stitched_planes = 0;
+    for(size_t id = 1; id < stitched_ids.size(); ++id)
+    {
+        int &compact_id = compact_ids[stitched_ids[id]];
+        if(compact_id == 0) compact_id = ++nb_stitched_planes;
+        stitched_ids[id] = compact_id;
+    }
+
+    LOG(INFO) << "Stitched " << nb_planes << " tile planes in " << nb_stitched_planes << " planes.";
+    nb_planes = nb_stitched_planes;
+
+    vector<int>().swap(plane_ids);
+
+    return stitched_ids;
+}
+
+bool TiledSegmentation::writeOutput(string output_file, vector<int> &plane_ids)
+{
+    ofstream out(output_file, ios::out | ios::binary);
+    if(!out.is_open())
+    {
+        LOG(ERROR) << "Could not write " << output_file;
+        return false;
+    }
+
+    out << "# .PCD v0.7 - Point Cloud Data file format" << endl;
+    out << "VERSION 0.7" << endl;
+    out << "FIELDS x y z normal_x normal_y normal_z rgba curvature k plane_id" << endl;
+    out << "SIZE 4 4 4 4 4 4 4 4 4 4" << endl;
+    out << "TYPE F F F F F F U F F I" << endl;
+    out << "COUNT 1 1 1 1 1 1 1 1 1 1" << endl;
+    out << "WIDTH " << nb_output_points << endl;
+    out << "HEIGHT 1" << endl;
+    out << "VIEWPOINT 0 0 0 1 0 0 0" << endl;
+    out << "POINTS " << nb_output_points << endl;
+    out << "DATA binary" << endl;
+
+    // Points are colored by plane, as in the viewer
+    SegmentedPointsContainer colors;
+    vector<uint32_t> plane_colors(nb_planes + 1);
+    ivec3 c = colors.getMiscColor();
+    plane_colors[0] = (255u << 24) | (c.x() << 16) | (c.y() << 8) | c.z();
+    for(size_t id = 1; id <= nb_planes; ++id)
+    {
+        c = colors.getNextPlaneColor();
+        plane_colors[id] = (255u << 24) | (c.x() << 16) | (c.y() << 8) | c.z();
+    }
+
+    ifstream in((work_dir / "points.bin").string(), ios::in | ios::binary);
+    vector<OutputPoint> points(STREAM_CHUNK_SIZE);
+
+    while(in)
+    {
+        in.read(reinterpret_cast<char*>(points.data()), points.size() * sizeof(OutputPoint));
+        size_t nb_read = in.gcount() / sizeof(OutputPoint);
+
+        for(size_t i = 0; i < nb_read; ++i)
+        {
+            points[i].plane_id = plane_ids[points[i].plane_id];
+            points[i].rgba = plane_colors[points[i].plane_id];
+        }
+
+        out.write(reinterpret_cast<const char*>(points.data()), nb_read * sizeof(OutputPoint));
+    }
+
+    LOG(INFO) << "Segmented cloud of " << nb_output_points << " points and " << nb_planes << " planes written in " << output_file;
+
+    return static_cast<bool>(out);
+}
+
+boost::filesystem::path TiledSegmentation::getTilePath(int tile)
+{
+    return work_dir / ("tile_" + to_string(tile) + ".bin");
+}
+
+bool TiledSegmentation::isInCore(int tile, float x, float y)
+{
+    // Points on the boundary between two tiles belong to the one with the highest index
+    int tx = tile % nb_tiles_x;
+    int ty = tile / nb_tiles_x;
+    int px = std::min(nb_tiles_x - 1, static_cast<int>(std::floor((x - min_xy.x()) / tile_size)));
+    int py = std::min(nb_tiles_y - 1, static_cast<int>(std::floor((y - min_xy.y()) / tile_size)));
+
+    return px == tx && py == ty;
+}
+
+bool TiledSegmentation::isInBorderBand(int tile, float x, float y)
+{
+    // Only the borders shared with another tile
+    int tx = tile % nb_tiles_x;
+    int ty = tile / nb_tiles_x;
+    float x0 = min_xy.x() + tx * tile_size;
+    float y0 = min_xy.y() + ty * tile_size;
+
+    return (tx > 0 && x - x0 < stitch_band) ||
+            (tx < nb_tiles_x - 1 && x0 + tile_size - x < stitch_band) ||
+            (ty > 0 && y - y0 < stitch_band) ||
+            (ty < nb_tiles_y - 1 && y0 + tile_size - y < stitch_band);
+}
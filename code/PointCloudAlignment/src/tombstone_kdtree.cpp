@@ -0,0 +1,126 @@
+#include "tombstone_kdtree.h"
+
+void TombstoneKdTree::setInputCloud(PointNormalKCloud::Ptr cloud)
+{
+    p_cloud = cloud;
+    alive.assign(cloud->size(), true);
+    nb_alive = cloud->size();
+    nb_indexed = nb_alive;
+    is_expansion_bounded = false;
+
+    p_search->setInputCloud(p_cloud);
+}
+
+void TombstoneKdTree::setInputCloud(PointNormalKCloud::Ptr cloud, boost::shared_ptr<vector<int>> indices)
+{
+    p_cloud = cloud;
+    alive.assign(cloud->size(), false);
+
+    for(int index: *indices)
+    {
+        alive[index] = true;
+    }
+
+    nb_alive = indices->size();
+    nb_indexed = nb_alive;
+    is_expansion_bounded = false;
+
+    p_search->setInputCloud(p_cloud, indices);
+}
+
+void TombstoneKdTree::setBackend(int backend)
+{
+    if(backend == this->backend) return;
+
+    this->backend = backend;
+    p_search = NeighborSearch::create(backend);
+
+    if(p_cloud) rebuild();
+}
+
+void TombstoneKdTree::remove(const vector<int> &indices)
+{
+    for(int index: indices)
+    {
+        if(alive[index])
+        {
+            alive[index] = false;
+            --nb_alive;
+        }
+    }
+
+    // Searches become slower when too many dead points must be filtered out, overall or around a query.
+    if(nb_alive > 0 && (nb_indexed - nb_alive > rebuild_ratio * nb_indexed || is_expansion_bounded.load(memory_order_relaxed)))
+    {
+        rebuild();
+    }
+}
+
+vector<int> TombstoneKdTree::getAliveIndices() const
+{
+    vector<int> indices;
+    indices.reserve(nb_alive);
+
+    for(size_t i = 0; i < alive.size(); ++i)
+    {
+        if(alive[i]) indices.push_back(static_cast<int>(i));
+    }
+
+    return indices;
+}
+
+int TombstoneKdTree::nearestKSearch(const PointNormalK &p, int k, vector<int> &k_indices, vector<float> &k_sqr_distances) const
+{
+    k_indices.clear();
+    k_sqr_distances.clear();
+
+    if(nb_alive == 0 || k <= 0) return 0;
+
+    // Buffers of the thread, reused by its searches
+    thread_local vector<int> indices;
+    thread_local vector<float> sqr_distances;
+
+    // Search more and more neighbors until k of them are alive, every indexed point was returned or the bound is reached.
+    size_t search_k = static_cast<size_t>(k);
+    const size_t max_search_k = std::min(nb_indexed, static_cast<size_t>(k) * MAX_EXPANSION);
+
+    while(true)
+    {
+        search_k = std::min(search_k, nb_indexed);
+        p_search->nearestKSearch(p, static_cast<int>(search_k), indices, sqr_distances);
+
+        k_indices.clear();
+        k_sqr_distances.clear();
+
+        for(size_t i = 0; i < indices.size() && k_indices.size() < static_cast<size_t>(k); ++i)
+        {
+            if(alive[indices[i]])
+            {
+                k_indices.push_back(indices[i]);
+                k_sqr_distances.push_back(sqr_distances[i]);
+            }
+        }
+
+        if(k_indices.size() == static_cast<size_t>(k) || search_k == nb_indexed) break;
+
+        if(search_k >= max_search_k)
+        {
+            is_expansion_bounded.store(true, memory_order_relaxed);
+            break;
+        }
+
+        search_k = std::min(2 * search_k, max_search_k);
+    }
+
+    return static_cast<int>(k_indices.size());
+}
+
+void TombstoneKdTree::rebuild()
+{
+    PROFILE_SCOPE("kdtree_rebuild");
+
+    boost::shared_ptr<vector<int>> indices(new vector<int>(getAliveIndices()));
+    p_search->setInputCloud(p_cloud, indices);
+    nb_indexed = nb_alive;
+    is_expansion_bounded = false;
+}
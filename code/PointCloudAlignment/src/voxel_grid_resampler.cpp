@@ -0,0 +1,197 @@
+#include "voxel_grid_resampler.h"
+
+#include <algorithm>
+#include <tuple>
+
+VoxelGridResampler::VoxelGridResampler(float leaf_size): leaf_size(leaf_size), shards(NB_SHARDS)
+{
+}
+
+void VoxelGridResampler::setLeafSize(float leaf_size)
+{
+    this->leaf_size = leaf_size;
+    clear();
+}
+
+void VoxelGridResampler::clear()
+{
+    for(auto &shard: shards)
+    {
+        shard.clear();
+    }
+}
+
+size_t VoxelGridResampler::VoxelKeyHash::operator()(const VoxelKey &key) const
+{
+    uint64_t h = static_cast<uint64_t>(static_cast<uint32_t>(key.x)) * 0x9E3779B97F4A7C15ULL;
+    h ^= static_cast<uint64_t>(static_cast<uint32_t>(key.y)) * 0xC2B2AE3D27D4EB4FULL;
+    h ^= static_cast<uint64_t>(static_cast<uint32_t>(key.z)) * 0x165667B19E3779F9ULL;
+
+    return h ^ (h >> 29);
+}
+
+/**
+ * @brief Add the points of a chunk, point_at(i) returning the i-th point as a vec3. Voxel keys and shards are computed in
+ * parallel first, and the points are bucketed by shard with a counting sort. Each thread then only walks the buckets of the
+ * shards it owns, so that the maps need no lock. Both passes are scheduled the same way, each bucket keeps the order of the
+ * points and the sums do not depend on the number of threads.
+ */
+template<typename PointAt>
+void VoxelGridResampler::accumulate(size_t nb_points, PointAt point_at)
+{
+    const float inverse_leaf = 1.0f / leaf_size;
+    const uint8_t SKIPPED = 0xFF;
+
+    vector<VoxelKey> keys(nb_points);
+    vector<uint8_t> shard_of(nb_points);
+    vector<size_t> bucketed_indices;
+    vector<size_t> shard_starts(NB_SHARDS + 1, 0);
+    vector<vector<size_t>> bucket_starts;
+
+    #pragma omp parallel
+    {
+        const size_t thread = omp_get_thread_num();
+        const size_t nb_threads = omp_get_num_threads();
+
+        #pragma omp single
+        bucket_starts.assign(nb_threads, vector<size_t>(NB_SHARDS, 0));
+
+        vector<size_t> &starts = bucket_starts[thread];
+
+        #pragma omp for schedule(static)
+        for(size_t i = 0; i < nb_points; ++i)
+        {
+            vec3 p = point_at(i);
+            vec3 q = (p * inverse_leaf).array().floor();
+
+            // Non finite points are skipped as pcl::VoxelGrid does, as well as the ones whose voxel index would overflow
+            if(!q.allFinite() || q.cwiseAbs().maxCoeff() >= 2147483648.0f)
+            {
+                shard_of[i] = SKIPPED;
+                continue;
+            }
+
+            keys[i] = {static_cast<int32_t>(q.x()), static_cast<int32_t>(q.y()), static_cast<int32_t>(q.z())};
+            shard_of[i] = static_cast<uint8_t>((VoxelKeyHash()(keys[i]) >> 32) % NB_SHARDS);
+            starts[shard_of[i]]++;
+        }
+
+        // Buckets of a shard are laid out by thread, the points of a thread after the ones of the previous threads
+        #pragma omp single
+        {
+            size_t nb_bucketed = 0;
+            for(size_t s = 0; s < NB_SHARDS; ++s)
+            {
+                shard_starts[s] = nb_bucketed;
+                for(vector<size_t> &thread_starts: bucket_starts)
+                {
+                    size_t count = thread_starts[s];
+                    thread_starts[s] = nb_bucketed;
+                    nb_bucketed += count;
+                }
+            }
+            shard_starts[NB_SHARDS] = nb_bucketed;
+            bucketed_indices.resize(nb_bucketed);
+        }
+
+        #pragma omp for schedule(static)
+        for(size_t i = 0; i < nb_points; ++i)
+        {
+            if(shard_of[i] != SKIPPED) bucketed_indices[starts[shard_of[i]]++] = i;
+        }
+
+        for(size_t s = thread; s < NB_SHARDS; s += nb_threads)
+        {
+            auto &shard = shards[s];
+            for(size_t j = shard_starts[s]; j < shard_starts[s + 1]; ++j)
+            {
+                const size_t i = bucketed_indices[j];
+                Voxel &voxel = shard[keys[i]];
+                voxel.sum += point_at(i).template cast<double>();
+                voxel.nb_points++;
+            }
+        }
+    }
+}
+
+void VoxelGridResampler::addPoints(const vector<vec3> &points)
+{
+    accumulate(points.size(), [&points](size_t i){
+        return points[i];
+    });
+}
+
+void VoxelGridResampler::addPoints(const PointNormalKCloud &cloud)
+{
+    accumulate(cloud.size(), [&cloud](size_t i){
+        const PointNormalK &p = cloud.points[i];
+        return vec3(p.x, p.y, p.z);
+    });
+}
+
+bool VoxelGridResampler::addFile(string filename)
+{
+    CloudStreamReader reader;
+    if(!reader.open(filename)) return false;
+
+    vector<vec3> points;
+    size_t nb_read = 0;
+
+    while(reader.read(points, STREAM_CHUNK_SIZE) > 0)
+    {
+        addPoints(points);
+        nb_read += points.size();
+    }
+
+    LOG(INFO) << nb_read << " points of " << filename << " resampled in " << getNbVoxels() << " voxels.";
+
+    return true;
+}
+
+size_t VoxelGridResampler::getNbVoxels() const
+{
+    size_t nb_voxels = 0;
+    for(const auto &shard: shards)
+    {
+        nb_voxels += shard.size();
+    }
+
+    return nb_voxels;
+}
+
+PointNormalKCloud::Ptr VoxelGridResampler::getCloud() const
+{
+    vector<pair<VoxelKey, const Voxel*>> voxels;
+    voxels.reserve(getNbVoxels());
+
+    for(const auto &shard: shards)
+    {
+        for(const auto &entry: shard)
+        {
+            voxels.push_back(make_pair(entry.first, &entry.second));
+        }
+    }
+
+    // Voxels are output in the order of pcl::VoxelGrid rather than in the order of the hash maps
+    sort(voxels.begin(), voxels.end(), [](const pair<VoxelKey, const Voxel*> &a, const pair<VoxelKey, const Voxel*> &b){
+        return tie(a.first.z, a.first.y, a.first.x) < tie(b.first.z, b.first.y, b.first.x);
+    });
+
+    PointNormalKCloud::Ptr p_cloud(new PointNormalKCloud);
+    p_cloud->resize(voxels.size());
+
+    #pragma omp parallel for
+    for(size_t i = 0; i < voxels.size(); ++i)
+    {
+        vec3d centroid = voxels[i].second->sum / static_cast<double>(voxels[i].second->nb_points);
+        PointNormalK &p = p_cloud->points[i];
+        p.x = static_cast<float>(centroid.x());
+        p.y = static_cast<float>(centroid.y());
+        p.z = static_cast<float>(centroid.z());
+    }
+
+    p_cloud->width = voxels.size();
+    p_cloud->height = 1;
+
+    return p_cloud;
+}
@@ -0,0 +1,83 @@
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <omp.h>
+
+#include "common.h"
+#include "plane_segmentation.h"
+#include "synthetic_city.h"
+
+using namespace std;
+
+/// Growing several seeds concurrently must give the same segmentation whatever the number of threads, with the
+/// neighbor graph of the preprocessing as well as with searches in the tree.
+
+static const int NB_SEEDS = 8;
+static const int NB_THREADS = 4;
+
+/// Plane id of every point once the cloud is segmented by nb_threads threads.
+static vector<int> segment(PointNormalKCloud::Ptr p_cloud, NeighborGraph::Ptr p_graph, int nb_threads, size_t &nb_planes)
+{
+    omp_set_num_threads(nb_threads);
+
+    PlaneSegmentation segmentation;
+    segmentation.init(PointNormalKCloud::Ptr(new PointNormalKCloud(*p_cloud)), true);
+    if(p_graph) segmentation.setNeighborGraph(p_graph);
+    segmentation.setNbParallelSeeds(NB_SEEDS);
+    segmentation.filterOutCurvature(segmentation.getConfig().max_curvature);
+    segmentation.start_pause();
+    segmentation.runMainLoop();
+
+    nb_planes = segmentation.getSegmentedPlanes().size();
+
+    vector<int> plane_ids;
+    plane_ids.reserve(p_cloud->size());
+    for(const PointNormalK &p: segmentation.getPointCloud()->points)
+    {
+        plane_ids.push_back(p.plane_id);
+    }
+
+    return plane_ids;
+}
+
+static bool compareThreads(PointNormalKCloud::Ptr p_cloud, NeighborGraph::Ptr p_graph, string name)
+{
+    size_t nb_planes_serial, nb_planes_parallel;
+    vector<int> serial = segment(p_cloud, p_graph, 1, nb_planes_serial);
+    vector<int> parallel = segment(p_cloud, p_graph, NB_THREADS, nb_planes_parallel);
+
+    if(nb_planes_serial == 0)
+    {
+        LOG(ERROR) << name << ": no plane was segmented.";
+        return false;
+    }
+
+    if(nb_planes_serial != nb_planes_parallel || serial != parallel)
+    {
+        LOG(ERROR) << name << ": " << nb_planes_serial << " planes with 1 thread, " << nb_planes_parallel << " planes with "
+                   << NB_THREADS << " threads.";
+        return false;
+    }
+
+    LOG(INFO) << name << ": " << nb_planes_serial << " planes with 1 and " << NB_THREADS << " threads.";
+    return true;
+}
+
+int main()
+{
+    SyntheticCity city;
+    city.generate(6000);
+
+    PlaneSegmentation preprocessing;
+    preprocessing.init(city.sampleCloud(1), true);
+    preprocessing.preprocessCloud();
+
+    PointNormalKCloud::Ptr p_cloud = preprocessing.getPointCloud();
+    NeighborGraph::Ptr p_graph = preprocessing.getNeighborGraph();
+
+    bool success = compareThreads(p_cloud, p_graph, "neighbor graph");
+    success = compareThreads(p_cloud, nullptr, "search tree") && success;
+
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
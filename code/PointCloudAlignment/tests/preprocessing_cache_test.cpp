@@ -0,0 +1,135 @@
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include "common.h"
+#include "plane_segmentation.h"
+#include "preprocessing_cache.h"
+#include "synthetic_city.h"
+
+using namespace std;
+
+/// Keys of the preprocessing cache must change with every parameter of the preprocessing, and an entry must give back
+/// the normals, curvatures, k and neighbor graph that were saved.
+
+static bool check(bool condition, string message)
+{
+    if(!condition) LOG(ERROR) << message;
+    return condition;
+}
+
+static bool testKeys(const PointNormalKCloud &cloud)
+{
+    AlignmentConfig config;
+    string key = PreprocessingCache::getKey(cloud, config, false);
+    bool success = check(key == PreprocessingCache::getKey(cloud, config, false), "The key of the same cloud changed.");
+
+    AlignmentConfig changed = config;
+    changed.leaf_size *= 2;
+    success = check(PreprocessingCache::getKey(cloud, changed, false) != key, "The key does not depend on leaf_size.") && success;
+
+    changed = config;
+    changed.min_k += 1;
+    success = check(PreprocessingCache::getKey(cloud, changed, false) != key, "The key does not depend on min_k.") && success;
+
+    changed = config;
+    changed.max_k_original += 1;
+    success = check(PreprocessingCache::getKey(cloud, changed, false) != key, "The key does not depend on max_k_original.") && success;
+
+    changed = config;
+    changed.max_k_resampled += 1;
+    success = check(PreprocessingCache::getKey(cloud, changed, true) != PreprocessingCache::getKey(cloud, config, true),
+                    "The key does not depend on max_k_resampled.") && success;
+
+    changed = config;
+    changed.neighbor_search = config.neighbor_search == NeighborSearch::KDTREE ? NeighborSearch::GRID : NeighborSearch::KDTREE;
+    success = check(PreprocessingCache::getKey(cloud, changed, false) != key, "The key does not depend on neighbor_search.") && success;
+
+    PointNormalKCloud moved = cloud;
+    moved.points.back().z += 0.01f;
+    success = check(PreprocessingCache::getKey(moved, config, false) != key, "The key does not depend on the points.") && success;
+
+    return success;
+}
+
+static bool testRoundTrip(const PointNormalKCloud &cloud, NeighborGraph::Ptr p_graph, boost::filesystem::path directory)
+{
+    PreprocessingCache &cache = PreprocessingCache::get();
+    if(!check(cache.setDirectory(directory.string()), "Could not create the cache directory.")) return false;
+
+    string key = PreprocessingCache::getKey(cloud, AlignmentConfig(), false);
+    if(!check(cache.save(key, cloud, p_graph), "Could not save the cache entry.")) return false;
+
+    // Only the coordinates are kept, the rest is read from the entry
+    PointNormalKCloud loaded;
+    for(const PointNormalK &p: cloud.points)
+    {
+        PointNormalK q;
+        q.x = p.x;
+        q.y = p.y;
+        q.z = p.z;
+        loaded.push_back(q);
+    }
+
+    NeighborGraph::Ptr p_loaded_graph;
+    if(!check(cache.load(key, loaded, p_loaded_graph), "Could not load the cache entry.")) return false;
+
+    bool success = true;
+    for(size_t i = 0; i < cloud.size() && success; ++i)
+    {
+        const PointNormalK &p = cloud.points[i], &q = loaded.points[i];
+        success = check(p.normal_x == q.normal_x && p.normal_y == q.normal_y && p.normal_z == q.normal_z,
+                        "The normal of point " + to_string(i) + " changed.");
+        success = success && check(p.curvature == q.curvature, "The curvature of point " + to_string(i) + " changed.");
+        success = success && check(p.k == q.k, "The k of point " + to_string(i) + " changed.");
+    }
+
+    if(!check(p_loaded_graph && p_loaded_graph->size() == p_graph->size() && p_loaded_graph->getNbEdges() == p_graph->getNbEdges(),
+              "The neighbor graph does not have the saved size."))
+    {
+        return false;
+    }
+
+    for(size_t i = 0; i < p_graph->size() && success; ++i)
+    {
+        success = check(equal(p_graph->rowBegin(i), p_graph->rowEnd(i), p_loaded_graph->rowBegin(i), p_loaded_graph->rowEnd(i)),
+                        "The neighbors of point " + to_string(i) + " changed.");
+    }
+
+    // An entry is not read for another cloud of the same size
+    PointNormalKCloud other = loaded;
+    other.points.front().x += 1;
+    NeighborGraph::Ptr p_other_graph;
+    success = check(!cache.load(key, other, p_other_graph), "The entry was read for another cloud.") && success;
+
+    cache.setDirectory("");
+
+    return success;
+}
+
+int main()
+{
+    SyntheticCity city;
+    city.generate(3000);
+
+    PlaneSegmentation preprocessing;
+    preprocessing.init(city.sampleCloud(1), true);
+    preprocessing.preprocessCloud();
+
+    PointNormalKCloud::Ptr p_cloud = preprocessing.getPointCloud();
+    NeighborGraph::Ptr p_graph = preprocessing.getNeighborGraph();
+
+    boost::filesystem::path directory = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("pca_cache_test_%%%%%%%%");
+
+    bool success = testKeys(*p_cloud);
+    success = testRoundTrip(*p_cloud, p_graph, directory) && success;
+
+    boost::system::error_code error;
+    boost::filesystem::remove_all(directory, error);
+
+    if(success) LOG(INFO) << "Preprocessing cache keys and entries of " << p_cloud->size() << " points checked.";
+
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
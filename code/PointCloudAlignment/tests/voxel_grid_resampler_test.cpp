@@ -0,0 +1,92 @@
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <pcl/filters/voxel_grid.h>
+
+#include "common.h"
+#include "voxel_grid_resampler.h"
+
+using namespace std;
+
+/// VoxelGridResampler must give the points of pcl::VoxelGrid, in the same order, whether the cloud is added at once
+/// or streamed in chunks.
+
+static const float LEAF = 0.5f;
+static const float TOLERANCE = 1e-4f;
+
+/// Points around a plane and in a box on both sides of the origin, so that voxels of negative indices are filled.
+static PointNormalKCloud::Ptr makeFixture()
+{
+    mt19937 rng(7);
+    uniform_real_distribution<float> coordinate(-5, 5);
+    normal_distribution<float> noise(0, 0.05f);
+
+    PointNormalKCloud::Ptr p_cloud(new PointNormalKCloud);
+    for(int i = 0; i < 20000; ++i)
+    {
+        PointNormalK p;
+        p.x = coordinate(rng);
+        p.y = coordinate(rng);
+        p.z = i % 2 == 0 ? 0.3f * p.x + noise(rng) : coordinate(rng);
+        p_cloud->push_back(p);
+    }
+
+    return p_cloud;
+}
+
+static bool compareClouds(const PointNormalKCloud &expected, const PointNormalKCloud &cloud, string name)
+{
+    if(expected.size() != cloud.size())
+    {
+        LOG(ERROR) << name << ": " << cloud.size() << " points instead of " << expected.size() << ".";
+        return false;
+    }
+
+    for(size_t i = 0; i < expected.size(); ++i)
+    {
+        const PointNormalK &e = expected.points[i], &p = cloud.points[i];
+        if(fabs(e.x - p.x) > TOLERANCE || fabs(e.y - p.y) > TOLERANCE || fabs(e.z - p.z) > TOLERANCE)
+        {
+            LOG(ERROR) << name << ": point " << i << " is (" << p.x << ", " << p.y << ", " << p.z << ") instead of ("
+                       << e.x << ", " << e.y << ", " << e.z << ").";
+            return false;
+        }
+    }
+
+    LOG(INFO) << name << ": " << cloud.size() << " voxels match pcl::VoxelGrid.";
+    return true;
+}
+
+int main()
+{
+    PointNormalKCloud::Ptr p_cloud = makeFixture();
+
+    PointNormalKCloud expected;
+    pcl::VoxelGrid<PointNormalK> grid;
+    grid.setInputCloud(p_cloud);
+    grid.setLeafSize(LEAF, LEAF, LEAF);
+    grid.filter(expected);
+
+    VoxelGridResampler resampler(LEAF);
+    resampler.addPoints(*p_cloud);
+    bool success = compareClouds(expected, *resampler.getCloud(), "whole cloud");
+
+    // Chunks of 1500 points, the last one smaller, most voxels of a chunk being already occupied
+    resampler.clear();
+    vector<vec3> chunk;
+    for(size_t i = 0; i < p_cloud->size(); ++i)
+    {
+        const PointNormalK &p = p_cloud->points[i];
+        chunk.push_back(vec3(p.x, p.y, p.z));
+        if(chunk.size() == 1500 || i + 1 == p_cloud->size())
+        {
+            resampler.addPoints(chunk);
+            chunk.clear();
+        }
+    }
+    success = compareClouds(expected, *resampler.getCloud(), "chunks") && success;
+
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}